@@ -0,0 +1,19 @@
+#ifndef NAN_BENCH_H_
+#define NAN_BENCH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t bench_time_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline double bench_per_second(uint64_t count, uint64_t duration_nsec)
+{
+    return duration_nsec ? (double)count * 1e9 / duration_nsec : 0;
+}
+
+#endif // NAN_BENCH_H_
@@ -0,0 +1,65 @@
+/*
+ * Compares the costs of preparing a beacon for injection: building it from
+ * scratch into a freshly allocated buffer, as the daemon used to do it on
+ * every timer expiry, and patching the prebuilt template in place.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <log.h>
+#include <state.h>
+#include <tx.h>
+#include <utils.h>
+
+#include "bench.h"
+
+static int run(int fcs, int iterations)
+{
+    struct ether_addr address = {{0x02, 0x11, 0x22, 0x33, 0x44, 0x55}};
+    struct nan_state state;
+    init_nan_state(&state, "bench", &address, 6, 0);
+    state.ieee80211.fcs = fcs;
+
+    uint64_t now_usec = 3600000000;
+    uint64_t sum = 0;
+
+    uint64_t start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+    {
+        struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+        nan_build_beacon_frame(buf, &state, NAN_DISCOVERY_BEACON, now_usec + i);
+        sum += buf_position(buf);
+        buf_free(buf);
+    }
+    uint64_t build_nsec = bench_time_nsec() - start;
+
+    start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+    {
+        size_t length;
+        const uint8_t *frame = nan_get_beacon_frame(&state, NAN_DISCOVERY_BEACON, now_usec + i, &length);
+        sum += frame[0] + length;
+    }
+    uint64_t template_nsec = bench_time_nsec() - start;
+
+    const char *variant = fcs ? "with fcs" : "without fcs";
+    printf("%-12s %-16s %14.1f\n", variant, "build", (double)build_nsec / iterations);
+    printf("%-12s %-16s %14.1f\n", variant, "template", (double)template_nsec / iterations);
+
+    return sum == 0 ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    log_set_level(LOG_ERR);
+
+    printf("%d beacons per run\n", iterations);
+    printf("%-12s %-16s %14s\n", "", "", "ns/beacon");
+    if (run(1, iterations) < 0 || run(0, iterations) < 0)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
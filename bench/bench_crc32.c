@@ -0,0 +1,57 @@
+/*
+ * Measures the throughput of every CRC32 implementation supported by the CPU
+ * over frame sizes from a minimal frame up to the largest buffer.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <crc32.h>
+#include <wire.h>
+
+#include "bench.h"
+
+static const size_t sizes[] = {64, 128, 256, 512, 1024, 1500, 2304, 4096, 16384, BUF_MAX_LENGTH};
+
+/* Keeps the checksums from being optimized away */
+static volatile uint32_t sink;
+
+static void run(enum crc32_implementation implementation, const uint8_t *data, uint64_t bytes)
+{
+    printf("%-12s", crc32_implementation_to_string(implementation));
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        uint64_t iterations = bytes / sizes[i] + 1;
+        uint64_t start = bench_time_nsec();
+        for (uint64_t j = 0; j < iterations; j++)
+            sink ^= crc32(data + (j & 7), sizes[i]);
+        uint64_t duration_nsec = bench_time_nsec() - start;
+
+        printf(" %8.2f", bench_per_second(iterations * sizes[i], duration_nsec) / 1e9);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t bytes = (argc > 1 ? atoll(argv[1]) : 256) * 1000000;
+
+    /* Leave room to vary the alignment of the start */
+    uint8_t *data = malloc(BUF_MAX_LENGTH + 8);
+    if (data == NULL)
+        return EXIT_FAILURE;
+    for (size_t i = 0; i < BUF_MAX_LENGTH + 8; i++)
+        data[i] = (uint8_t)rand();
+
+    printf("%llu MB per size, GB/s\n", (unsigned long long)bytes / 1000000);
+    printf("%-12s", "");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        printf(" %8zu", sizes[i]);
+    printf("\n");
+
+    for (int implementation = CRC32_IMPL_TABLE; implementation <= CRC32_IMPL_ARMV8; implementation++)
+        if (crc32_set_implementation(implementation) == 0)
+            run(implementation, data, bytes);
+
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/*
+ * Compares the attribute dispatch through a hard-coded switch, as nan_rx used
+ * to do it, with the registered dispatch table from src/dispatch.c. Both
+ * variants iterate a synthetic attribute stream resembling received beacons
+ * and service discovery frames, including attributes that are not handled.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <attributes.h>
+#include <dispatch.h>
+#include <log.h>
+#include <rx.h>
+
+#include "bench.h"
+
+static const uint8_t attribute_ids[] = {
+    MASTER_INDICATION_ATTRIBUTE,
+    CLUSTER_ATTRIBUTE,
+    SERVICE_ID_LIST_ATTRIBUTE,
+    DEVICE_CAPABILITY_ATTRIBUTE,
+    NAN_AVAILABILITY_ATTRIBUTE,
+    SERVICE_DESCRIPTOR_ATTRIBUTE,
+    SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE,
+    VENDOR_SPECIFIC_ATTRIBUTE,
+};
+
+static int parse_attribute(struct buf *buf, void *data)
+{
+    uint8_t value;
+    read_u8(buf, &value);
+    *(uint64_t *)data += value;
+    return RX_OK;
+}
+
+static int dispatch_switch(struct buf *frame, uint64_t *sum)
+{
+    struct nan_attribute_view attribute;
+    int result = RX_OK;
+
+    while (nan_attribute_next(frame, &attribute) > 0)
+    {
+        switch (attribute.id)
+        {
+        case MASTER_INDICATION_ATTRIBUTE:
+        case CLUSTER_ATTRIBUTE:
+        case SERVICE_DESCRIPTOR_ATTRIBUTE:
+        case SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE:
+            result = parse_attribute(&attribute.data, sum);
+            break;
+        default:
+            log_trace("Unhandled attribute: %s", nan_attribute_type_as_string(attribute.id));
+            result = RX_IGNORE;
+        }
+        if (result < 0)
+            return result;
+    }
+    return RX_OK;
+}
+
+static int dispatch_table(struct buf *frame, const struct nan_attribute_dispatch *dispatch, uint64_t *sum)
+{
+    struct nan_attribute_view attribute;
+
+    while (nan_attribute_next(frame, &attribute) > 0)
+    {
+        int result = nan_dispatch_attribute(dispatch, NAN_FRAME_BEACON, attribute.id,
+                                            &attribute.data, sum);
+        if (result < 0)
+            return result;
+    }
+    return RX_OK;
+}
+
+static size_t build_frame(uint8_t *frame, size_t size)
+{
+    size_t length = 0;
+    for (size_t i = 0; length + 3 + 8 <= size; i++)
+    {
+        frame[length++] = attribute_ids[i % sizeof(attribute_ids)];
+        frame[length++] = 8;
+        frame[length++] = 0;
+        memset(frame + length, (uint8_t)i, 8);
+        length += 8;
+    }
+    return length;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    log_set_level(LOG_ERR);
+
+    uint8_t frame[256];
+    size_t length = build_frame(frame, sizeof(frame));
+    int attributes = length / 11;
+
+    struct nan_attribute_dispatch dispatch;
+    nan_attribute_dispatch_init(&dispatch);
+    for (size_t i = 0; i < sizeof(attribute_ids); i++)
+    {
+        uint8_t id = attribute_ids[i];
+        if (id == MASTER_INDICATION_ATTRIBUTE || id == CLUSTER_ATTRIBUTE ||
+            id == SERVICE_DESCRIPTOR_ATTRIBUTE || id == SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE)
+            nan_register_attribute_handler(&dispatch, NAN_FRAME_BEACON, id, parse_attribute);
+        else
+            nan_skip_attribute(&dispatch, NAN_FRAME_BEACON, id);
+    }
+
+    uint64_t switch_sum = 0, table_sum = 0;
+
+    uint64_t start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+    {
+        struct buf buf = buf_view(frame, length);
+        dispatch_switch(&buf, &switch_sum);
+    }
+    uint64_t switch_nsec = bench_time_nsec() - start;
+
+    start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+    {
+        struct buf buf = buf_view(frame, length);
+        dispatch_table(&buf, &dispatch, &table_sum);
+    }
+    uint64_t table_nsec = bench_time_nsec() - start;
+
+    if (switch_sum != table_sum)
+    {
+        fprintf(stderr, "Dispatch variants disagree: %lu != %lu\n", switch_sum, table_sum);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t total = (uint64_t)attributes * iterations;
+    printf("%d attributes per frame, %d iterations\n", attributes, iterations);
+    printf("%-16s %14s %12s\n", "", "attributes/s", "ns/attr");
+    printf("%-16s %14.0f %12.2f\n", "switch", bench_per_second(total, switch_nsec),
+           (double)switch_nsec / total);
+    printf("%-16s %14.0f %12.2f\n", "table", bench_per_second(total, table_nsec),
+           (double)table_nsec / total);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+ * Compares the costs of the master election counters at the end of a DW:
+ * scanning the linked list of peers, as nan_master_election used to do it,
+ * recounting over the structure of arrays mirror, which happens when the own
+ * master rank changed, and the incremental counters kept by the peer store.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <log.h>
+#include <peer.h>
+#include <sync.h>
+#include <utils.h>
+
+#include "bench.h"
+
+static struct nan_election_counters scan_list(const list_t peers, const uint64_t master_rank,
+                                              const uint64_t now_usec)
+{
+    struct nan_election_counters counters;
+    memset(&counters, 0, sizeof(counters));
+
+    struct nan_peer *peer;
+    LIST_FOR_EACH(peers, peer, {
+        uint64_t peer_master_rank = nan_get_peer_master_rank(peer);
+
+        if (now_usec - peer->last_update > NAN_MASTER_ELECTION_WINDOW_USEC)
+            continue;
+
+        if (peer->rssi_average > RSSI_CLOSE)
+        {
+            counters.count_rssi_close++;
+            if (peer_master_rank > master_rank)
+                counters.count_rssi_close_higher_mr++;
+            if (peer->master_candidate)
+                counters.count_rssi_close_master_candidate++;
+        }
+
+        if (peer->rssi_average > RSSI_MIDDLE)
+        {
+            counters.count_rssi_middle++;
+            if (peer_master_rank > master_rank)
+                counters.count_rssi_middle_higher_mr++;
+            if (peer->master_candidate)
+                counters.count_rssi_middle_master_candidate++;
+        }
+
+        if (peer_master_rank > master_rank)
+            counters.count_higher_mr++;
+    })
+
+    return counters;
+}
+
+static void add_peers(struct nan_peer_state *state, int count, uint64_t now_usec)
+{
+    struct ether_addr cluster_id = {{0x50, 0x6f, 0x9a, 0x01, 0x00, 0x00}};
+
+    for (int i = 0; i < count; i++)
+    {
+        struct ether_addr addr = {{0x02, 0x11, 0x22, 0x00, 0x00, 0x00}};
+        addr.ether_addr_octet[3] = (uint8_t)(i >> 16);
+        addr.ether_addr_octet[4] = (uint8_t)(i >> 8);
+        addr.ether_addr_octet[5] = (uint8_t)i;
+
+        // Most peers were heard in the current DW, some a while ago
+        uint64_t last_update = i < count / 8 ? now_usec - TU_TO_USEC(100) + i
+                                             : now_usec - TU_TO_USEC(16) + i;
+
+        struct nan_peer *peer = NULL;
+        nan_peer_add(state, &addr, &cluster_id, last_update, &peer);
+        nan_peer_set_master_indication(peer, i % 3 == 0 ? 128 : 0, (uint8_t)(i * 7));
+        nan_peer_set_beacon_information(peer, (signed char)(-30 - i % 60), last_update);
+        peer->master_candidate = i % 5 == 0;
+        nan_peer_election_update(state, peer);
+    }
+}
+
+static int run(int peers, int iterations)
+{
+    uint64_t now_usec = 3600000000;
+    uint64_t master_rank = nan_calculate_master_rank(64, 0, &(struct ether_addr){{0x02, 0x11, 0x22, 0, 0x80, 0}});
+
+    struct nan_peer_state state;
+    nan_peer_state_init(&state);
+    nan_peer_set_max_peers(&state, 0);
+    add_peers(&state, peers, now_usec);
+    now_usec += peers;
+
+    struct nan_election_counters list_counters = scan_list(state.peers, master_rank, now_usec);
+    struct nan_election_counters soa_counters = *nan_peer_election_counters(
+        &state, master_rank, now_usec, NAN_MASTER_ELECTION_WINDOW_USEC);
+    if (memcmp(&list_counters, &soa_counters, sizeof(list_counters)) != 0)
+    {
+        fprintf(stderr, "Election counters disagree for %d peers\n", peers);
+        return -1;
+    }
+
+    uint64_t sum = 0;
+    uint64_t start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+        sum += scan_list(state.peers, master_rank + (i & 1), now_usec).count_higher_mr;
+    uint64_t list_nsec = bench_time_nsec() - start;
+
+    // A changed master rank forces a recount over the mirror
+    start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+        sum += nan_peer_election_counters(&state, master_rank + (i & 1) + 1, now_usec,
+                                          NAN_MASTER_ELECTION_WINDOW_USEC)->count_higher_mr;
+    uint64_t soa_nsec = bench_time_nsec() - start;
+
+    start = bench_time_nsec();
+    for (int i = 0; i < iterations; i++)
+        sum += nan_peer_election_counters(&state, master_rank, now_usec,
+                                          NAN_MASTER_ELECTION_WINDOW_USEC)->count_higher_mr;
+    uint64_t incremental_nsec = bench_time_nsec() - start;
+
+    printf("%-8d %-16s %14.1f\n", peers, "list scan", (double)list_nsec / iterations);
+    printf("%-8d %-16s %14.1f\n", peers, "soa recount", (double)soa_nsec / iterations);
+    printf("%-8d %-16s %14.1f\n", peers, "incremental", (double)incremental_nsec / iterations);
+
+    return sum == 0 ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+    log_set_level(LOG_ERR);
+
+    printf("%d elections per run\n", iterations);
+    printf("%-8s %-16s %14s\n", "peers", "", "ns/election");
+    if (run(1000, iterations) < 0 || run(10000, iterations) < 0)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*
+ * Compares the user space frame rate with and without the kernel NAN frame
+ * filter by replaying a radiotap capture. Without the filter, every frame is
+ * passed to nan_rx. With the filter, the program from daemon/filter.c is run
+ * first (in user space via libpcap's interpreter, as the kernel would) and only
+ * accepted frames are passed to nan_rx.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcap.h>
+
+#include <state.h>
+#include <rx.h>
+#include <log.h>
+#include <utils.h>
+
+#include "filter.h"
+#include "bench.h"
+
+struct frame
+{
+    uint8_t *data;
+    uint32_t length;
+};
+
+struct result
+{
+    uint64_t delivered;
+    uint64_t filter_nsec;
+    uint64_t rx_nsec;
+};
+
+static int load_capture(const char *path, struct frame **frames, size_t *count)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(path, errbuf);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Could not open %s: %s\n", path, errbuf);
+        return -1;
+    }
+
+    if (pcap_datalink(handle) != DLT_IEEE802_11_RADIO)
+    {
+        fprintf(stderr, "Capture %s does not contain radiotap headers\n", path);
+        pcap_close(handle);
+        return -1;
+    }
+
+    size_t capacity = 1024;
+    *frames = malloc(capacity * sizeof(struct frame));
+    *count = 0;
+
+    struct pcap_pkthdr *header;
+    const uint8_t *data;
+    while (pcap_next_ex(handle, &header, &data) == 1)
+    {
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            *frames = realloc(*frames, capacity * sizeof(struct frame));
+        }
+        struct frame *frame = &(*frames)[(*count)++];
+        frame->data = malloc(header->caplen);
+        frame->length = header->caplen;
+        memcpy(frame->data, data, header->caplen);
+    }
+
+    pcap_close(handle);
+    return 0;
+}
+
+static void run(const struct frame *frames, size_t count, int iterations,
+                const struct nan_filter *filter, struct result *result)
+{
+    struct nan_state state;
+    struct ether_addr address = {{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}};
+    init_nan_state(&state, "bench", &address, 6, clock_time_usec());
+
+    memset(result, 0, sizeof(*result));
+    for (int i = 0; i < iterations; i++)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            if (filter)
+            {
+                uint64_t start = bench_time_nsec();
+                unsigned int accepted = bpf_filter(filter->program.bf_insns, frames[j].data,
+                                                   frames[j].length, frames[j].length);
+                result->filter_nsec += bench_time_nsec() - start;
+                if (!accepted)
+                    continue;
+            }
+
+            uint64_t start = bench_time_nsec();
+            struct buf buf = buf_view(frames[j].data, frames[j].length);
+            nan_rx(&buf, &state, 0);
+            result->rx_nsec += bench_time_nsec() - start;
+            result->delivered++;
+        }
+    }
+}
+
+static void print_result(const char *name, const struct result *result, uint64_t offered)
+{
+    /* Every offered frame passes the filter, if any, before it is delivered to nan_rx */
+    uint64_t offer_nsec = result->filter_nsec + result->rx_nsec;
+    printf("%-16s %12" PRIu64 " %12" PRIu64 " %14.0f %14.0f %10.1f\n", name, offered, result->delivered,
+           bench_per_second(offered, offer_nsec),
+           bench_per_second(result->delivered, result->rx_nsec),
+           result->filter_nsec ? (double)result->filter_nsec / offered : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <capture.pcap> [iterations=10]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+
+    log_set_level(LOG_ERR);
+
+    struct frame *frames;
+    size_t count;
+    if (load_capture(argv[1], &frames, &count) < 0)
+        return EXIT_FAILURE;
+
+    struct nan_filter filter;
+    nan_filter_init(&filter, NULL);
+
+    struct result unfiltered, filtered;
+    run(frames, count, iterations, NULL, &unfiltered);
+    run(frames, count, iterations, &filter, &filtered);
+
+    uint64_t offered = (uint64_t)count * iterations;
+    printf("%zu frames, %d iterations\n", count, iterations);
+    printf("%-16s %12s %12s %14s %14s %10s\n", "", "offered", "delivered",
+           "offered/s", "delivered/s", "filter ns");
+    print_result("no filter", &unfiltered, offered);
+    print_result("nan filter", &filtered, offered);
+
+    for (size_t i = 0; i < count; i++)
+        free(frames[i].data);
+    free(frames);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/*
+ * Compares decoding the radiotap header with the generic radiotap iterator
+ * against the decoder that caches field offsets per present bitmap. Pass one
+ * or more radiotap captures, e.g. recorded with different drivers. Without
+ * arguments, two built-in headers are used: the one written by
+ * ieee80211_add_radiotap_header and an ath9k style header with an extended
+ * present bitmap.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcap.h>
+
+#include <ieee80211.h>
+#include <log.h>
+
+#include "bench.h"
+
+struct frame
+{
+    uint8_t *data;
+    uint32_t length;
+};
+
+struct capture
+{
+    const char *name;
+    struct frame *frames;
+    size_t count;
+};
+
+static const uint8_t extended_header[] = {
+    0x00, 0x00, 0x24, 0x00, 0x2f, 0x40, 0x00, 0xa0,
+    0x20, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+    0x10, 0x02, 0x6c, 0x09, 0xa0, 0x00, 0xc4, 0x00,
+    0x00, 0x00, 0xbf, 0x00,
+};
+
+static void add_frame(struct capture *capture, const uint8_t *data, uint32_t length)
+{
+    capture->frames = realloc(capture->frames, (capture->count + 1) * sizeof(struct frame));
+    struct frame *frame = &capture->frames[capture->count++];
+    frame->data = malloc(length);
+    frame->length = length;
+    memcpy(frame->data, data, length);
+}
+
+static int load_capture(const char *path, struct capture *capture)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(path, errbuf);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Could not open %s: %s\n", path, errbuf);
+        return -1;
+    }
+
+    if (pcap_datalink(handle) != DLT_IEEE802_11_RADIO)
+    {
+        fprintf(stderr, "Capture %s does not contain radiotap headers\n", path);
+        pcap_close(handle);
+        return -1;
+    }
+
+    struct pcap_pkthdr *header;
+    const uint8_t *data;
+    while (pcap_next_ex(handle, &header, &data) == 1)
+        add_frame(capture, data, header->caplen);
+
+    pcap_close(handle);
+    return 0;
+}
+
+static void load_builtin(struct capture *own, struct capture *extended)
+{
+    struct ieee80211_state state;
+    ieee80211_init_state(&state);
+
+    struct buf *buf = buf_new_owned(64);
+    ieee80211_add_radiotap_header(buf, &state);
+    own->name = "own tx header";
+    add_frame(own, buf_data(buf), buf_position(buf));
+    buf_free(buf);
+
+    extended->name = "ath9k style";
+    add_frame(extended, extended_header, sizeof(extended_header));
+}
+
+static int run(const struct capture *capture, int iterations)
+{
+    struct ieee80211_radiotap_cache cache;
+    ieee80211_radiotap_cache_init(&cache);
+
+    uint64_t iterator_nsec = 0, cached_nsec = 0;
+    uint64_t mismatches = 0;
+
+    for (size_t j = 0; j < capture->count; j++)
+    {
+        const struct frame *frame = &capture->frames[j];
+        signed char rssi[2] = {0};
+        uint8_t flags[2] = {0};
+        uint64_t tsft[2] = {0};
+        int result[2];
+
+        uint64_t start = bench_time_nsec();
+        for (int i = 0; i < iterations; i++)
+        {
+            struct buf buf = buf_view(frame->data, frame->length);
+            result[0] = ieee80211_parse_radiotap_header(&buf, &rssi[0], &flags[0], &tsft[0]);
+        }
+        iterator_nsec += bench_time_nsec() - start;
+
+        start = bench_time_nsec();
+        for (int i = 0; i < iterations; i++)
+        {
+            struct buf buf = buf_view(frame->data, frame->length);
+            result[1] = ieee80211_parse_radiotap_header_cached(&cache, &buf, &rssi[1], &flags[1], &tsft[1]);
+        }
+        cached_nsec += bench_time_nsec() - start;
+
+        if (result[0] != result[1] || rssi[0] != rssi[1] || flags[0] != flags[1] || tsft[0] != tsft[1])
+            mismatches++;
+    }
+
+    uint64_t total = (uint64_t)capture->count * iterations;
+    printf("%-24s %10zu %12.1f %12.1f %8.2fx %10lu %10lu %10lu\n", capture->name, capture->count,
+           (double)iterator_nsec / total, (double)cached_nsec / total,
+           cached_nsec ? (double)iterator_nsec / cached_nsec : 0.0,
+           cache.hits, cache.fallbacks, mismatches);
+
+    return mismatches ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? 1000 : 1000000;
+    int captures_count = argc > 1 ? argc - 1 : 2;
+    struct capture *captures = calloc(captures_count, sizeof(struct capture));
+
+    log_set_level(LOG_ERR);
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            captures[i - 1].name = argv[i];
+            if (load_capture(argv[i], &captures[i - 1]) < 0)
+                return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        load_builtin(&captures[0], &captures[1]);
+    }
+
+    int status = EXIT_SUCCESS;
+    printf("%d iterations per frame\n", iterations);
+    printf("%-24s %10s %12s %12s %9s %10s %10s %10s\n", "", "frames", "iterator ns", "cached ns",
+           "speedup", "hits", "fallbacks", "mismatches");
+    for (int i = 0; i < captures_count; i++)
+    {
+        if (run(&captures[i], iterations) < 0)
+            status = EXIT_FAILURE;
+
+        for (size_t j = 0; j < captures[i].count; j++)
+            free(captures[i].frames[j].data);
+        free(captures[i].frames);
+    }
+    free(captures);
+
+    return status;
+}
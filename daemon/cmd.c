@@ -23,6 +23,7 @@ void nan_cmd_print_help()
     log_info(" * sync                                Prints current sync state");
     log_info(" * peers                               Prints list of added peers");
     log_info(" * services [pub, sub]                 Prints list of PUBlished and/or SUBscribed services");
+    log_info(" * stats                               Prints daemon receive statistics");
     log_info("");
     log_info("Action");
     log_info(" * publish %%service_name%%            Publish a service with the given name");
@@ -52,7 +53,7 @@ void nan_cmd_print_device_info(const struct nan_state *state)
 
 void nan_cmd_print_sync_info(const struct nan_state *state)
 {
-    uint64_t now_usec = clock_time_usec();
+    uint64_t now_usec = nan_clock_now_usec(&state->clock);
 
     uint64_t synced_time_usec = nan_timer_get_synced_time_usec(&state->timer, now_usec);
     uint64_t synced_time_tu = nan_timer_get_synced_time_tu(&state->timer, now_usec);
@@ -95,7 +96,7 @@ void nan_cmd_print_peers_info(const struct nan_state *state)
         return;
     }
 
-    uint64_t now_usec = clock_time_usec();
+    uint64_t now_usec = nan_clock_now_usec(&state->clock);
 
     struct nan_peer *peer = NULL;
     LIST_FOR_EACH(state->peers.peers, peer, {
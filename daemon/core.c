@@ -1,11 +1,13 @@
 #include "core.h"
 
 #include <stdbool.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <pcap.h>
 #include <fcntl.h>
+#include <string.h>
 #include <netinet/ether.h>
 #include <netinet/in.h>
 
@@ -55,6 +57,7 @@ int nan_init(struct daemon_state *state, const char *wlan, const char *host, int
 
     init_nan_state(&state->nan_state, hostname, &state->io_state.if_ether_addr,
                    channel, clock_time_usec());
+    state->nan_state.timestamp.source = state->timestamp_source;
 
     nan_peer_set_callbacks(&state->nan_state.peers,
                            nan_neighbor_add, &state->io_state,
@@ -63,6 +66,14 @@ int nan_init(struct daemon_state *state, const char *wlan, const char *host, int
     state->dump = dump;
     state->last_cmd = NULL;
 
+    if (state->rx_budget <= 0)
+        state->rx_budget = RX_DEFAULT_BUDGET;
+    memset(&state->rx_stats, 0, sizeof(state->rx_stats));
+
+    if (state->rx_threaded &&
+        (err = rx_thread_start(&state->rx_thread, &state->io_state, RX_QUEUE_DEFAULT_SIZE)))
+        return err;
+
     return 0;
 }
 
@@ -70,6 +81,8 @@ void nan_free(struct daemon_state *state)
 {
     if (state->last_cmd)
         free(state->last_cmd);
+    if (state->rx_threaded)
+        rx_thread_stop(&state->rx_thread);
     io_state_free(&state->io_state);
     netutils_cleanup();
 }
@@ -100,32 +113,132 @@ static void dump_frame(const char *dump_file, const struct pcap_pkthdr *header,
     pcap_dump_close(dumper);
 }
 
-void nan_send_beacon(struct daemon_state *state, enum nan_beacon_type type, uint64_t now_usec)
+static void nan_account_beacon(struct daemon_state *state, uint64_t timer_nsec)
+{
+    uint64_t latency_nsec = clock_time_nsec() - timer_nsec;
+
+    state->tx_stats.beacons++;
+    state->tx_stats.beacon_nsec_total += latency_nsec;
+    if (latency_nsec > state->tx_stats.beacon_nsec_max)
+        state->tx_stats.beacon_nsec_max = latency_nsec;
+}
+
+static void nan_account_dw_burst(struct daemon_state *state, uint64_t timer_nsec)
+{
+    uint64_t latency_nsec = clock_time_nsec() - timer_nsec;
+
+    state->tx_stats.dw_bursts++;
+    state->tx_stats.dw_burst_nsec_total += latency_nsec;
+    if (latency_nsec > state->tx_stats.dw_burst_nsec_max)
+        state->tx_stats.dw_burst_nsec_max = latency_nsec;
+}
+
+static enum nan_tx_priority nan_beacon_priority(enum nan_beacon_type type)
+{
+    return type == NAN_SYNC_BEACON ? NAN_TX_SYNC_BEACON : NAN_TX_DISCOVERY_BEACON;
+}
+
+static bool nan_send_built_beacon(struct daemon_state *state, enum nan_beacon_type type,
+                                  uint64_t now_usec, uint64_t timer_nsec)
 {
-    struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+    bool sent = false;
+
+    /* Build directly into the transmit ring if there is one */
+    size_t size;
+    uint8_t *slot = wlan_tx_slot(&state->io_state, &size);
+    if (slot != NULL)
+    {
+        struct buf frame = buf_view(slot, size);
+        nan_build_beacon_frame(&frame, &state->nan_state, type, now_usec);
+        if (buf_error(&frame) == 0)
+        {
+            if (!nan_reserve_airtime(&state->nan_state, nan_beacon_priority(type), slot, buf_position(&frame)))
+                return false;
+
+            log_trace("Send %s beacon of length %zu", nan_beacon_type_to_string(type), buf_position(&frame));
+            nan_account_beacon(state, timer_nsec);
+            wlan_tx_commit(&state->io_state, buf_position(&frame));
+            return true;
+        }
+    }
+
+    struct buf *buf = buf_pool_get(&state->nan_state.tx_pool, NAN_BEACON_TEMPLATE_MAX_LENGTH);
+    if (buf == NULL)
+    {
+        log_error("No buffer for beacon frame: %s", nan_beacon_type_to_string(type));
+        return false;
+    }
+
     nan_build_beacon_frame(buf, &state->nan_state, type, now_usec);
     if (buf_error(buf) < 0)
     {
         log_error("Could not build beacon frame: %s", nan_beacon_type_to_string(type));
-        return;
+        goto cleanup;
     }
 
     int length = buf_position(buf);
+    if (!nan_reserve_airtime(&state->nan_state, nan_beacon_priority(type), buf_data(buf), length))
+        goto cleanup;
+
     log_trace("Send %s beacon of length %d", nan_beacon_type_to_string(type), length);
+    nan_account_beacon(state, timer_nsec);
     int err = wlan_send(&state->io_state, buf_data(buf), length);
     if (err < 0)
         log_error("Could not send frame: %d", err);
+    sent = true;
+
+cleanup:
+    buf_free(buf);
+    return sent;
+}
+
+bool nan_send_beacon(struct daemon_state *state, enum nan_beacon_type type, uint64_t now_usec, uint64_t timer_nsec)
+{
+    if (state->frame_cache_disabled)
+        return nan_send_built_beacon(state, type, now_usec, timer_nsec);
+
+    size_t length;
+    const uint8_t *frame = nan_get_beacon_frame(&state->nan_state, type, now_usec, &length);
+    if (frame == NULL)
+    {
+        log_error("Could not build beacon frame: %s", nan_beacon_type_to_string(type));
+        return false;
+    }
+
+    if (!nan_reserve_airtime(&state->nan_state, nan_beacon_priority(type), frame, length))
+        return false;
+
+    log_trace("Send %s beacon of length %zu", nan_beacon_type_to_string(type), length);
+    nan_account_beacon(state, timer_nsec);
+    int err = wlan_send(&state->io_state, frame, length);
+    if (err < 0)
+        log_error("Could not send frame: %d", err);
+    return true;
 }
 
 void nan_send_discovery_beacon(struct ev_loop *loop, ev_timer *timer, int revents)
 {
     (void)revents;
     struct daemon_state *state = timer->data;
-    uint64_t now_usec = clock_time_usec();
+    uint64_t timer_nsec = clock_time_nsec();
+    uint64_t now_usec = nan_clock_now_usec(&state->nan_state.clock);
 
     if (nan_can_send_discovery_beacon(&state->nan_state, now_usec))
     {
-        nan_send_beacon(state, NAN_DISCOVERY_BEACON, now_usec);
+        nan_open_discovery_beacon_schedule(&state->nan_state, now_usec);
+        if (!nan_send_beacon(state, NAN_DISCOVERY_BEACON, now_usec, timer_nsec))
+        {
+            /* Try again once the upcoming discovery window is over */
+            uint64_t retry_usec;
+            if (nan_timer_in_dw(&state->nan_state.timer, now_usec))
+                retry_usec = nan_timer_dw_end_usec(&state->nan_state.timer, now_usec);
+            else
+                retry_usec = nan_timer_next_dw_usec(&state->nan_state.timer, now_usec) + TU_TO_USEC(NAN_DW_LENGTH_TU);
+            ev_timer_rearm_usec(loop, timer, retry_usec);
+            return;
+        }
+        if (wlan_flush(&state->io_state) < 0)
+            log_error("Could not flush discovery beacon");
         nan_timer_set_last_discovery_beacon_usec(&state->nan_state.timer, now_usec);
     }
 
@@ -133,10 +246,10 @@ void nan_send_discovery_beacon(struct ev_loop *loop, ev_timer *timer, int revent
     ev_timer_rearm_usec(loop, timer, next_beacon_time_usec);
 }
 
-void nan_send_buffered_frames(struct daemon_state *state)
+void nan_send_buffered_frames(struct daemon_state *state, uint64_t now_usec)
 {
     struct buf *buf = NULL;
-    while (circular_buf_get(state->nan_state.buffer, (any_t *)&buf, false) != -1)
+    while ((buf = nan_tx_schedule_next(&state->nan_state.tx_schedule, NAN_TX_FOLLOW_UP, now_usec)) != NULL)
     {
         int length = buf_position(buf);
         log_trace("Send buffered frame of length %d", length);
@@ -148,16 +261,27 @@ void nan_send_buffered_frames(struct daemon_state *state)
     }
 }
 
-void nan_send_service_discovery_frame(struct daemon_state *state)
+static void nan_send_built_service_discovery_frame(struct daemon_state *state)
 {
     list_t announced_services = list_init();
     nan_get_services_to_announce(&state->nan_state.services, announced_services);
     if (list_len(announced_services) > 0)
     {
-        struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+        struct buf *buf = buf_pool_get(&state->nan_state.tx_pool,
+                                       nan_service_discovery_frame_max_length(announced_services));
+        if (buf == NULL)
+        {
+            log_error("No buffer for service discovery frame");
+            goto cleanup;
+        }
         nan_build_service_discovery_frame(buf, &state->nan_state, &NAN_NETWORK_ID, announced_services);
 
         int length = buf_position(buf);
+        if (!nan_reserve_airtime(&state->nan_state, NAN_TX_SERVICE_DISCOVERY, buf_data(buf), length))
+        {
+            buf_free(buf);
+            goto cleanup;
+        }
         int err = wlan_send(&state->io_state, buf_data(buf), length);
 
         log_trace("Send service discovery frame for services:");
@@ -168,16 +292,53 @@ void nan_send_service_discovery_frame(struct daemon_state *state)
         if (err < 0)
             log_error("Could not send service discovery frame: %d", err);
 
-        nan_update_announced_services(announced_services);
+        nan_update_announced_services(&state->nan_state.services, announced_services);
     }
+cleanup:
     list_free(announced_services, false);
 }
 
+void nan_send_service_discovery_frame(struct daemon_state *state)
+{
+    if (state->frame_cache_disabled)
+    {
+        nan_send_built_service_discovery_frame(state);
+        return;
+    }
+
+    list_t announced_services;
+    size_t length;
+    const uint8_t *frame = nan_get_service_discovery_frame(&state->nan_state, &NAN_NETWORK_ID,
+                                                           &announced_services, &length);
+    if (frame == NULL)
+    {
+        if (list_len(announced_services) > 0)
+            log_error("Could not build service discovery frame");
+        return;
+    }
+
+    /* The announcement is repeated in the next window, the services stay unannounced until then */
+    if (!nan_reserve_airtime(&state->nan_state, NAN_TX_SERVICE_DISCOVERY, frame, length))
+        return;
+
+    int err = wlan_send(&state->io_state, frame, length);
+
+    log_trace("Send service discovery frame for services:");
+    struct nan_service *service;
+    LIST_FOR_EACH(announced_services, service, log_trace(" * %s", service->service_name))
+
+    if (err < 0)
+        log_error("Could not send service discovery frame: %d", err);
+
+    nan_update_announced_services(&state->nan_state.services, announced_services);
+}
+
 void nan_handle_discovery_window(struct ev_loop *loop, ev_timer *timer, int revents)
 {
     (void)revents;
     struct daemon_state *state = timer->data;
-    uint64_t now_usec = clock_time_usec();
+    uint64_t timer_nsec = clock_time_nsec();
+    uint64_t now_usec = nan_clock_now_usec(&state->nan_state.clock);
 
     if (!nan_timer_in_dw(&state->nan_state.timer, now_usec) ||
         !nan_timer_initial_scan_done(&state->nan_state.timer, now_usec))
@@ -190,11 +351,18 @@ void nan_handle_discovery_window(struct ev_loop *loop, ev_timer *timer, int reve
 
     log_trace("In discovery window at %lu", nan_timer_get_synced_time_usec(&state->nan_state.timer, now_usec));
 
-    nan_send_beacon(state, NAN_SYNC_BEACON, now_usec);
-    nan_send_buffered_frames(state);
+    /* In order of priority, whatever does not fit into the window waits for the next one */
+    nan_open_discovery_window_schedule(&state->nan_state, now_usec);
+    nan_send_beacon(state, NAN_SYNC_BEACON, now_usec, timer_nsec);
+    nan_send_buffered_frames(state, now_usec);
     nan_send_service_discovery_frame(state);
 
-    now_usec = clock_time_usec();
+    int flushed = wlan_flush(&state->io_state);
+    if (flushed < 0)
+        log_error("Could not flush discovery window frames: %d", flushed);
+    nan_account_dw_burst(state, timer_nsec);
+
+    now_usec = nan_clock_now_usec(&state->nan_state.clock);
     uint64_t dw_end_usec = nan_timer_dw_end_usec(&state->nan_state.timer, now_usec);
     ev_timer_rearm_usec(loop, &state->ev_state.discovery_window_end, dw_end_usec);
 
@@ -207,11 +375,11 @@ void nan_handle_discovery_window_end(struct ev_loop *loop, ev_timer *timer, int
     (void)loop;
     (void)revents;
     struct daemon_state *state = timer->data;
-    uint64_t now_usec = clock_time_usec();
+    uint64_t now_usec = nan_clock_now_usec(&state->nan_state.clock);
 
     log_trace("discovery window end");
 
-    nan_master_election(&state->nan_state.sync, state->nan_state.peers.peers, now_usec);
+    nan_master_election(&state->nan_state.sync, &state->nan_state.peers, now_usec);
     nan_check_anchor_master_expiration(&state->nan_state.sync);
 }
 
@@ -219,7 +387,7 @@ void nan_clean_peers(struct ev_loop *loop, ev_timer *timer, int revents)
 {
     (void)revents;
     struct daemon_state *state = timer->data;
-    uint64_t now_usec = clock_time_usec();
+    uint64_t now_usec = nan_clock_now_usec(&state->nan_state.clock);
 
     nan_peers_clean(&state->nan_state.peers, now_usec);
 
@@ -230,9 +398,9 @@ void nan_receive_frame(uint8_t *user, const struct pcap_pkthdr *header, const ui
 {
     log_trace("Received frame of length %d", header->caplen);
     struct daemon_state *state = (void *)user;
-    struct buf *frame = buf_new_const(buf, header->caplen);
+    struct buf frame = buf_view(buf, header->caplen);
 
-    int result = nan_rx(frame, &state->nan_state);
+    int result = nan_rx(&frame, &state->nan_state, wlan_rx_time_usec(header));
     if (result < RX_OK)
     {
         log_trace("unhandled frame: %s", nan_rx_result_to_string(result));
@@ -240,8 +408,27 @@ void nan_receive_frame(uint8_t *user, const struct pcap_pkthdr *header, const ui
     }
     if (result > RX_OK)
         log_trace("unhandled frame: %s", nan_rx_result_to_string(result));
+}
 
-    buf_free(frame);
+static void rx_stats_add_batch(struct rx_stats *stats, int frames, bool budget_exhausted)
+{
+    stats->wakeups++;
+    if (budget_exhausted)
+        stats->budget_exhausted++;
+
+    if (frames == 0)
+    {
+        stats->empty_wakeups++;
+        return;
+    }
+    stats->frames += frames;
+
+    int bucket = 0;
+    while (frames >>= 1)
+        bucket++;
+    if (bucket >= RX_BATCH_HISTOGRAM_SIZE)
+        bucket = RX_BATCH_HISTOGRAM_SIZE - 1;
+    stats->batch_sizes[bucket]++;
 }
 
 void wlan_device_ready(struct ev_loop *loop, ev_io *handle, int revents)
@@ -249,7 +436,34 @@ void wlan_device_ready(struct ev_loop *loop, ev_io *handle, int revents)
     (void)loop;
     (void)revents;
     struct daemon_state *state = handle->data;
-    pcap_dispatch(state->io_state.wlan_handle, 1, &nan_receive_frame, handle->data);
+
+    /* Drain all pending frames, but at most rx_budget, so that timers still get a chance
+     * to run in busy DWs. As the io watcher is level-triggered, we get called again
+     * in the next loop iteration if frames are left. */
+    int frames = 0;
+    while (frames < state->rx_budget)
+    {
+        int result = wlan_dispatch(&state->io_state, state->rx_budget - frames,
+                                   &nan_receive_frame, handle->data);
+        if (result <= 0)
+            break;
+        frames += result;
+    }
+
+    rx_stats_add_batch(&state->rx_stats, frames, frames >= state->rx_budget);
+}
+
+void rx_queue_ready(struct ev_loop *loop, ev_io *handle, int revents)
+{
+    (void)loop;
+    (void)revents;
+    struct daemon_state *state = handle->data;
+
+    /* The queue renews its notification itself if frames are left after the budget */
+    int frames = rx_thread_dispatch(&state->rx_thread, state->rx_budget,
+                                    &nan_receive_frame, handle->data);
+
+    rx_stats_add_batch(&state->rx_stats, frames, frames >= state->rx_budget);
 }
 
 void host_device_ready(struct ev_loop *loop, ev_io *handle, int revents)
@@ -355,6 +569,116 @@ cleanup:
     buf_free(buf);
 }
 
+static void nan_print_stats(const struct daemon_state *state)
+{
+    const struct rx_stats *stats = &state->rx_stats;
+
+    log_info("Receive Statistics");
+    log_info("---------------------------------------------");
+    log_info("Budget per wakeup        %d", state->rx_budget);
+    log_info("Wakeups                  %" PRIu64, stats->wakeups);
+    log_info("Empty wakeups            %" PRIu64, stats->empty_wakeups);
+    log_info("Budget exhausted         %" PRIu64, stats->budget_exhausted);
+    log_info("Frames                   %" PRIu64, stats->frames);
+    log_info("Duplicates               %" PRIu64, state->nan_state.rx_duplicates);
+    log_info("Peer limit reached       %" PRIu64, state->nan_state.rx_peer_limit);
+    if (stats->wakeups > stats->empty_wakeups)
+        log_info("Average batch size       %.2f",
+                 (double)stats->frames / (stats->wakeups - stats->empty_wakeups));
+    log_info("");
+    log_info("Batch size               Wakeups");
+    for (int i = 0; i < RX_BATCH_HISTOGRAM_SIZE; i++)
+    {
+        char range[32];
+        if (i == RX_BATCH_HISTOGRAM_SIZE - 1)
+            snprintf(range, sizeof(range), ">= %d", 1 << i);
+        else
+            snprintf(range, sizeof(range), "%d - %d", 1 << i, (1 << (i + 1)) - 1);
+        log_info("%-24s %" PRIu64, range, stats->batch_sizes[i]);
+    }
+    log_info("");
+
+    if (state->rx_threaded)
+    {
+        const struct rx_queue_stats *queue = &state->rx_thread.stats;
+        log_info("Capture thread queue");
+        log_info("Size                     %u", state->rx_thread.queue.size);
+        log_info("Depth                    %u", rx_thread_queue_depth(&state->rx_thread));
+        log_info("High water               %u", __atomic_load_n(&queue->high_water, __ATOMIC_RELAXED));
+        log_info("Enqueued                 %" PRIu64, __atomic_load_n(&queue->enqueued, __ATOMIC_RELAXED));
+        log_info("Dropped (queue full)     %" PRIu64, __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED));
+        log_info("Dropped (oversized)      %" PRIu64, __atomic_load_n(&queue->oversized, __ATOMIC_RELAXED));
+        log_info("Notifications            %" PRIu64, __atomic_load_n(&queue->wakeups, __ATOMIC_RELAXED));
+        log_info("");
+    }
+
+    const struct tx_stats *tx = &state->tx_stats;
+    log_info("Beacon transmission");
+    log_info("Prebuilt frames          %s", state->frame_cache_disabled ? "disabled" : "enabled");
+    log_info("Template rebuilds        %" PRIu64, state->nan_state.beacon_templates.rebuilds);
+    log_info("SDF rebuilds             %" PRIu64, state->nan_state.sdf_cache.rebuilds);
+    log_info("Beacons                  %" PRIu64, tx->beacons);
+    if (tx->beacons > 0)
+    {
+        log_info("Timer to inject (ns)     %" PRIu64, tx->beacon_nsec_total / tx->beacons);
+        log_info("Timer to inject max (ns) %" PRIu64, tx->beacon_nsec_max);
+    }
+    log_info("Transmit ring            %s", state->io_state.use_tx_ring ? "enabled" : "disabled");
+    log_info("DW bursts                %" PRIu64, tx->dw_bursts);
+    if (tx->dw_bursts > 0)
+    {
+        log_info("DW to sent (ns)          %" PRIu64, tx->dw_burst_nsec_total / tx->dw_bursts);
+        log_info("DW to sent max (ns)      %" PRIu64, tx->dw_burst_nsec_max);
+    }
+    log_info("");
+
+    const struct nan_tx_schedule *tx_schedule = &state->nan_state.tx_schedule;
+    log_info("TX schedule");
+    log_info("Sent in window           %" PRIu64, tx_schedule->sent);
+    log_info("Deferred                 %" PRIu64, tx_schedule->deferred);
+    log_info("Expired                  %" PRIu64, tx_schedule->expired);
+    log_info("Dropped                  %" PRIu64, tx_schedule->dropped);
+    log_info("Oversize                 %" PRIu64, tx_schedule->oversize);
+    log_info("Coalesced follow ups     %" PRIu64, tx_schedule->coalesced);
+    log_info("Queued follow ups        %zu", nan_tx_schedule_length(tx_schedule, NAN_TX_FOLLOW_UP));
+    log_info("");
+
+    const struct buf_pool *tx_pool = &state->nan_state.tx_pool;
+    log_info("TX buffer pool");
+    log_info("Size         In use    High water    Capacity");
+    for (int i = 0; i < BUF_POOL_CLASSES; i++)
+    {
+        const struct buf_pool_class *class = &tx_pool->classes[i];
+        log_info("%-12zu %-9zu %-13zu %zu", class->size, class->slab.used,
+                 class->slab.high_water, class->slab.capacity);
+    }
+    log_info("Oversized                %" PRIu64, tx_pool->oversized);
+    log_info("");
+
+    const struct slab *peers = &state->nan_state.peers.pool;
+    log_info("Peer pool");
+    log_info("Peers                    %zu", peers->used);
+    log_info("High water               %zu", peers->high_water);
+    log_info("Capacity                 %zu", peers->capacity);
+    if (peers->max_objects > 0)
+        log_info("Maximum                  %zu", peers->max_objects);
+    log_info("Refused                  %" PRIu64, peers->failed);
+    log_info("");
+
+    const struct nan_timestamp_state *timestamp = &state->nan_state.timestamp;
+    log_info("Arrival timestamp source %s", nan_timestamp_source_to_string(timestamp->source));
+    log_info("Source     Frames    Delay (us)    Stddev    Beacons  Jitter (us)");
+    for (int source = 0; source < TIMESTAMP_SOURCE_COUNT; source++)
+    {
+        const struct nan_timestamp_stats *delay = &timestamp->delay[source];
+        const struct nan_timestamp_stats *jitter = &timestamp->jitter[source];
+        log_info("%-8s %8" PRIu64 " %13.1f %9.1f %10" PRIu64 " %12.1f", nan_timestamp_source_to_string(source),
+                 delay->count, nan_timestamp_stats_mean(delay), nan_timestamp_stats_stddev(delay),
+                 jitter->count, nan_timestamp_stats_stddev(jitter));
+    }
+    log_info("");
+}
+
 void stdin_ready(struct ev_loop *loop, ev_io *handler, int revents)
 {
     (void)revents;
@@ -372,7 +696,10 @@ void stdin_ready(struct ev_loop *loop, ev_io *handler, int revents)
     cmd[len] = '\0';
 
     struct daemon_state *state = handler->data;
-    nan_handle_cmd(&state->nan_state, cmd, &state->last_cmd);
+    if (strcmp(cmd, "stats") == 0)
+        nan_print_stats(state);
+    else
+        nan_handle_cmd(&state->nan_state, cmd, &state->last_cmd);
     free(cmd);
 }
 
@@ -400,10 +727,20 @@ void nan_schedule(struct ev_loop *loop, struct daemon_state *state)
                   0, (double)USEC_TO_SEC(state->nan_state.peers.clean_interval_usec));
     ev_timer_start(loop, &state->ev_state.clean_peers);
 
-    /* Trigger frame reception from WLAN device */
-    state->ev_state.read_wlan.data = (void *)state;
-    ev_io_init(&state->ev_state.read_wlan, wlan_device_ready, state->io_state.wlan_fd, EV_READ);
-    ev_io_start(loop, &state->ev_state.read_wlan);
+    if (state->rx_threaded)
+    {
+        /* Trigger frame reception from the capture thread's queue */
+        state->ev_state.read_rx_queue.data = (void *)state;
+        ev_io_init(&state->ev_state.read_rx_queue, rx_queue_ready, state->rx_thread.event_fd, EV_READ);
+        ev_io_start(loop, &state->ev_state.read_rx_queue);
+    }
+    else
+    {
+        /* Trigger frame reception from WLAN device */
+        state->ev_state.read_wlan.data = (void *)state;
+        ev_io_init(&state->ev_state.read_wlan, wlan_device_ready, state->io_state.wlan_fd, EV_READ);
+        ev_io_start(loop, &state->ev_state.read_wlan);
+    }
 
     /* Trigger frame reception from host device */
     state->ev_state.read_host.data = (void *)state;
@@ -8,6 +8,33 @@
 #include <wire.h>
 
 #include "io.h"
+#include "rx_thread.h"
+
+/* Maximum number of frames handled per WLAN device wakeup */
+#define RX_DEFAULT_BUDGET 64
+
+#define RX_BATCH_HISTOGRAM_SIZE 8
+
+struct rx_stats
+{
+    uint64_t wakeups;          /* number of times the WLAN device was ready */
+    uint64_t empty_wakeups;    /* wakeups without any frame pending */
+    uint64_t frames;           /* number of handled frames */
+    uint64_t budget_exhausted; /* wakeups that stopped because the budget was used up */
+    /* Frames handled per wakeup, bucket i counts batches of 2^i to 2^(i+1)-1 frames,
+     * the last bucket also counts all larger batches */
+    uint64_t batch_sizes[RX_BATCH_HISTOGRAM_SIZE];
+};
+
+struct tx_stats
+{
+    uint64_t beacons;             /* number of beacons handed to the WLAN device */
+    uint64_t beacon_nsec_total;   /* time from timer expiry to injection, summed over all beacons */
+    uint64_t beacon_nsec_max;     /* longest time from timer expiry to injection */
+    uint64_t dw_bursts;           /* discovery windows in which frames were sent back-to-back */
+    uint64_t dw_burst_nsec_total; /* time from DW start until the last frame was sent, summed */
+    uint64_t dw_burst_nsec_max;   /* longest time from DW start until the last frame was sent */
+};
 
 struct ev_state
 {
@@ -18,6 +45,7 @@ struct ev_state
     ev_timer clean_peers;
     ev_io read_stdin;
     ev_io read_wlan;
+    ev_io read_rx_queue;
     ev_io read_host;
 };
 
@@ -29,6 +57,16 @@ struct daemon_state
 
     uint64_t start_time_usec;
 
+    int rx_budget;
+    struct rx_stats rx_stats;
+    enum nan_timestamp_source timestamp_source;
+
+    bool frame_cache_disabled; /* build every beacon and service discovery frame from scratch */
+    struct tx_stats tx_stats;
+
+    bool rx_threaded; /* capture frames in a separate thread */
+    struct rx_thread rx_thread;
+
     const char *dump;
     char *last_cmd;
 };
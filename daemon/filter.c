@@ -0,0 +1,110 @@
+#include "filter.h"
+
+#include <stddef.h>
+
+#include <ieee80211.h>
+#include <frame.h>
+
+/* Jump targets that are resolved once the program is complete */
+#define JUMP_ACCEPT 0xff
+#define JUMP_REJECT 0xfe
+
+/* Offsets relative to the start of the 802.11 header, i.e., the radiotap length */
+#define OFFSET_FRAME_CONTROL 0
+#define OFFSET_SOURCE_ADDRESS offsetof(struct ieee80211_hdr, addr2)
+#define OFFSET_BODY sizeof(struct ieee80211_hdr)
+/* Timestamp, beacon interval and capability precede the NAN information element */
+#define OFFSET_BEACON_ELEMENT (OFFSET_BODY + offsetof(struct nan_beacon_frame, element_id))
+#define OFFSET_BEACON_OUI (OFFSET_BODY + offsetof(struct nan_beacon_frame, oui))
+#define OFFSET_ACTION_OUI (OFFSET_BODY + offsetof(struct nan_action_frame, oui))
+
+#define FRAME_CONTROL_TYPE_MASK (IEEE80211_FCTL_FTYPE | IEEE80211_FCTL_STYPE)
+#define VENDOR_SPECIFIC_ELEMENT_ID 0xdd
+
+static void emit(struct nan_filter *filter, unsigned int *length,
+                 uint16_t code, uint32_t k, uint8_t jt, uint8_t jf)
+{
+    struct bpf_insn *instruction = &filter->instructions[(*length)++];
+    instruction->code = code;
+    instruction->jt = jt;
+    instruction->jf = jf;
+    instruction->k = k;
+}
+
+static uint8_t resolve(uint8_t target, unsigned int position, unsigned int accept, unsigned int reject)
+{
+    if (target == JUMP_ACCEPT)
+        return accept - position - 1;
+    if (target == JUMP_REJECT)
+        return reject - position - 1;
+    return target;
+}
+
+void nan_filter_init(struct nan_filter *filter, const struct ether_addr *own_address)
+{
+    unsigned int n = 0;
+    const struct oui oui = NAN_OUI;
+    const uint32_t oui_high = (oui.byte[0] << 8) | oui.byte[1];
+
+    /* X = radiotap header length (little endian) */
+    emit(filter, &n, BPF_LD | BPF_B | BPF_ABS, 3, 0, 0);
+    emit(filter, &n, BPF_ALU | BPF_LSH | BPF_K, 8, 0, 0);
+    emit(filter, &n, BPF_MISC | BPF_TAX, 0, 0, 0);
+    emit(filter, &n, BPF_LD | BPF_B | BPF_ABS, 2, 0, 0);
+    emit(filter, &n, BPF_ALU | BPF_OR | BPF_X, 0, 0, 0);
+    emit(filter, &n, BPF_MISC | BPF_TAX, 0, 0, 0);
+
+    if (own_address)
+    {
+        const uint8_t *a = own_address->ether_addr_octet;
+        emit(filter, &n, BPF_LD | BPF_W | BPF_IND, OFFSET_SOURCE_ADDRESS, 0, 0);
+        emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K,
+             ((uint32_t)a[0] << 24) | (a[1] << 16) | (a[2] << 8) | a[3], 0, 2);
+        emit(filter, &n, BPF_LD | BPF_H | BPF_IND, OFFSET_SOURCE_ADDRESS + 4, 0, 0);
+        emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, (a[4] << 8) | a[5], JUMP_REJECT, 0);
+    }
+
+    /* Frame control is little endian, the first byte holds type and subtype */
+    emit(filter, &n, BPF_LD | BPF_B | BPF_IND, OFFSET_FRAME_CONTROL, 0, 0);
+    emit(filter, &n, BPF_ALU | BPF_AND | BPF_K, FRAME_CONTROL_TYPE_MASK, 0, 0);
+
+    /* Beacon: NAN information element directly after the fixed fields */
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON, 0, 6);
+    emit(filter, &n, BPF_LD | BPF_B | BPF_IND, OFFSET_BEACON_ELEMENT, 0, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, VENDOR_SPECIFIC_ELEMENT_ID, 0, JUMP_REJECT);
+    emit(filter, &n, BPF_LD | BPF_H | BPF_IND, OFFSET_BEACON_OUI, 0, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, oui_high, 0, JUMP_REJECT);
+    emit(filter, &n, BPF_LD | BPF_H | BPF_IND, OFFSET_BEACON_OUI + 2, 0, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, (oui.byte[2] << 8) | NAN_OUI_TYPE_BEACON,
+         JUMP_ACCEPT, JUMP_REJECT);
+
+    /* Action: public vendor specific action frame with NAN OUI, either SDF or NAF */
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_ACTION, 0, JUMP_REJECT);
+    emit(filter, &n, BPF_LD | BPF_W | BPF_IND, OFFSET_BODY, 0, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K,
+         ((uint32_t)IEEE80211_PUBLIC_ACTION_FRAME << 24) |
+             (IEEE80211_PUBLIC_ACTION_FRAME_VENDOR_SPECIFIC << 16) | oui_high,
+         0, JUMP_REJECT);
+    emit(filter, &n, BPF_LD | BPF_H | BPF_IND, OFFSET_ACTION_OUI + 2, 0, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, (oui.byte[2] << 8) | NAN_OUT_TYPE_SERVICE_DISCOVERY,
+         JUMP_ACCEPT, 0);
+    emit(filter, &n, BPF_JMP | BPF_JEQ | BPF_K, (oui.byte[2] << 8) | NAN_OUI_TYPE_ACTION,
+         JUMP_ACCEPT, JUMP_REJECT);
+
+    unsigned int accept = n;
+    emit(filter, &n, BPF_RET | BPF_K, NAN_FILTER_SNAPLEN, 0, 0);
+    unsigned int reject = n;
+    emit(filter, &n, BPF_RET | BPF_K, 0, 0, 0);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        struct bpf_insn *instruction = &filter->instructions[i];
+        if (BPF_CLASS(instruction->code) != BPF_JMP)
+            continue;
+        instruction->jt = resolve(instruction->jt, i, accept, reject);
+        instruction->jf = resolve(instruction->jf, i, accept, reject);
+    }
+
+    filter->program.bf_len = n;
+    filter->program.bf_insns = filter->instructions;
+}
@@ -0,0 +1,35 @@
+#ifndef NAN_FILTER_H_
+#define NAN_FILTER_H_
+
+#include <stdint.h>
+#include <pcap/bpf.h>
+
+#ifdef __APPLE__
+#include <net/ethernet.h>
+#else
+#include <netinet/ether.h>
+#endif
+
+#define NAN_FILTER_MAX_LENGTH 32
+
+/* Snapshot length returned for accepted frames */
+#define NAN_FILTER_SNAPLEN 65535
+
+struct nan_filter
+{
+    struct bpf_insn instructions[NAN_FILTER_MAX_LENGTH];
+    struct bpf_program program;
+};
+
+/**
+ * Build a classic BPF program for radiotap frames that only accepts NAN beacons
+ * and NAN service discovery and action frames, i.e., beacons starting with the
+ * NAN information element and public vendor specific action frames with the
+ * NAN OUI. Everything else, like data and control frames, is dropped in the kernel.
+ *
+ * @param filter - The filter to initialize, filter->program is ready to be attached afterwards
+ * @param own_address - If not NULL, additionally drop frames sent by this address
+ */
+void nan_filter_init(struct nan_filter *filter, const struct ether_addr *own_address);
+
+#endif // NAN_FILTER_H_
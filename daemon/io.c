@@ -5,11 +5,17 @@
 #include <string.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <time.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
 
 #ifndef __APPLE__
 #include <linux/if_tun.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
 #else
 #include <sys/sys_domain.h>
 #include <sys/kern_control.h>
@@ -21,8 +27,9 @@
 #include <wire.h>
 
 #include "netutils.h"
+#include "filter.h"
 
-static int open_nonblocking_device(const char *dev, pcap_t **pcap_handle, const struct ether_addr *bssid_filter)
+static int open_nonblocking_device(const char *dev, pcap_t **pcap_handle)
 {
     char errbuf[PCAP_ERRBUF_SIZE];
     pcap_t *handle = pcap_create(dev, errbuf);
@@ -67,33 +74,380 @@ static int open_nonblocking_device(const char *dev, pcap_t **pcap_handle, const
         return -1;
     }
 
+    int fd = pcap_get_selectable_fd(handle);
+    if (fd < 0)
+    {
+        log_error("pcap: unable to get fd");
+        return -1;
+    }
+
+    *pcap_handle = handle;
+    return fd;
+}
+
+#ifndef __APPLE__
+#define RX_RING_BLOCK_SIZE (1 << 20)
+#define RX_RING_BLOCK_COUNT 8
+#define RX_RING_FRAME_SIZE 2048
+/* Hand a block to user space after 1 ms even if not full, same as the pcap timeout */
+#define RX_RING_BLOCK_TIMEOUT_MSEC 1
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+#define TX_RING_FRAME_SIZE 4096
+#define TX_RING_FRAME_COUNT 64
+/* Blocks must be a multiple of the page size */
+#define TX_RING_BLOCK_SIZE (TX_RING_FRAME_SIZE * 16)
+/* Frame data starts after the frame header, same as for received frames */
+#define TX_RING_DATA_OFFSET (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+static int open_rx_ring(struct rx_ring *ring, int ifindex)
+{
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0)
+    {
+        log_error("rx ring: unable to open packet socket (%s)", strerror(errno));
+        return -errno;
+    }
+
+    int err;
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        err = -errno;
+        log_error("rx ring: TPACKET_V3 not supported (%s)", strerror(errno));
+        goto error;
+    }
+
+    /* Do not receive our own injected frames (available since Linux 4.20),
+     * otherwise they are dropped while dispatching */
+    int one = 1;
+    if (setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) < 0)
+        log_debug("rx ring: cannot ignore outgoing frames (%s)", strerror(errno));
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = RX_RING_BLOCK_SIZE;
+    req.tp_block_nr = RX_RING_BLOCK_COUNT;
+    req.tp_frame_size = RX_RING_FRAME_SIZE;
+    req.tp_frame_nr = (RX_RING_BLOCK_SIZE / RX_RING_FRAME_SIZE) * RX_RING_BLOCK_COUNT;
+    req.tp_retire_blk_tov = RX_RING_BLOCK_TIMEOUT_MSEC;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        err = -errno;
+        log_error("rx ring: unable to set up ring (%s)", strerror(errno));
+        goto error;
+    }
+
+    ring->size = (size_t)req.tp_block_size * req.tp_block_nr;
+    ring->map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (ring->map == MAP_FAILED)
+    {
+        err = -errno;
+        log_error("rx ring: unable to map ring (%s)", strerror(errno));
+        ring->map = NULL;
+        goto error;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifindex;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        err = -errno;
+        log_error("rx ring: unable to bind to interface %d (%s)", ifindex, strerror(errno));
+        goto error;
+    }
+
+    ring->fd = fd;
+    ring->block_size = req.tp_block_size;
+    ring->block_count = req.tp_block_nr;
+    ring->block = 0;
+    ring->remaining = 0;
+    ring->next = NULL;
+
+    return fd;
+
+error:
+    if (ring->map)
+        munmap(ring->map, ring->size);
+    ring->map = NULL;
+    close(fd);
+    return err;
+}
+
+static void close_rx_ring(struct rx_ring *ring)
+{
+    if (ring->map)
+        munmap(ring->map, ring->size);
+    ring->map = NULL;
+    close(ring->fd);
+}
+
+static int open_tx_ring(struct tx_ring *ring, int ifindex)
+{
+    /* Protocol 0 as the socket is only used for transmission */
+    int fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd < 0)
+    {
+        log_error("tx ring: unable to open packet socket (%s)", strerror(errno));
+        return -errno;
+    }
+
+    int err;
+    int version = TPACKET_V2;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        err = -errno;
+        log_error("tx ring: TPACKET_V2 not supported (%s)", strerror(errno));
+        goto error;
+    }
+
+    /* Hand frames directly to the driver (available since Linux 3.14) */
+    int one = 1;
+    if (setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)) < 0)
+        log_debug("tx ring: cannot bypass queueing discipline (%s)", strerror(errno));
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = TX_RING_BLOCK_SIZE;
+    req.tp_frame_size = TX_RING_FRAME_SIZE;
+    req.tp_frame_nr = TX_RING_FRAME_COUNT;
+    req.tp_block_nr = TX_RING_FRAME_COUNT * TX_RING_FRAME_SIZE / TX_RING_BLOCK_SIZE;
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+    {
+        err = -errno;
+        log_error("tx ring: unable to set up ring (%s)", strerror(errno));
+        goto error;
+    }
+
+    ring->size = (size_t)req.tp_block_size * req.tp_block_nr;
+    ring->map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (ring->map == MAP_FAILED)
+    {
+        err = -errno;
+        log_error("tx ring: unable to map ring (%s)", strerror(errno));
+        ring->map = NULL;
+        goto error;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = ifindex;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        err = -errno;
+        log_error("tx ring: unable to bind to interface %d (%s)", ifindex, strerror(errno));
+        goto error;
+    }
+
+    ring->fd = fd;
+    ring->frame_size = req.tp_frame_size;
+    ring->frame_count = req.tp_frame_nr;
+    ring->head = 0;
+    ring->pending = 0;
+
+    return fd;
+
+error:
+    if (ring->map)
+        munmap(ring->map, ring->size);
+    ring->map = NULL;
+    close(fd);
+    return err;
+}
+
+static void close_tx_ring(struct tx_ring *ring)
+{
+    if (ring->map)
+        munmap(ring->map, ring->size);
+    ring->map = NULL;
+    close(ring->fd);
+}
+
+static struct tpacket2_hdr *tx_ring_frame(struct tx_ring *ring, unsigned int index)
+{
+    return (struct tpacket2_hdr *)(ring->map + (size_t)index * ring->frame_size);
+}
+
+static uint8_t *tx_ring_slot(struct tx_ring *ring, size_t *size)
+{
+    struct tpacket2_hdr *frame = tx_ring_frame(ring, ring->head);
+    uint32_t status = __atomic_load_n(&frame->tp_status, __ATOMIC_ACQUIRE);
+
+    /* Slots return to the ring once the kernel sent their frame */
+    if (status == TP_STATUS_WRONG_FORMAT)
+        log_error("tx ring: kernel rejected frame of %u bytes", frame->tp_len);
+    else if (status != TP_STATUS_AVAILABLE)
+        return NULL;
+
+    *size = ring->frame_size - TX_RING_DATA_OFFSET;
+    return (uint8_t *)frame + TX_RING_DATA_OFFSET;
+}
+
+static void tx_ring_commit(struct tx_ring *ring, size_t length)
+{
+    struct tpacket2_hdr *frame = tx_ring_frame(ring, ring->head);
+    frame->tp_len = length;
+    __atomic_store_n(&frame->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    ring->head = (ring->head + 1) % ring->frame_count;
+    ring->pending++;
+}
+
+static int tx_ring_flush(struct tx_ring *ring)
+{
+    if (ring->pending == 0)
+        return 0;
+
+    /* Blocks until the kernel sent all frames marked for sending */
+    if (send(ring->fd, NULL, 0, 0) < 0)
+    {
+        log_error("tx ring: unable to send frames (%s)", strerror(errno));
+        return -errno;
+    }
+
+    int flushed = ring->pending;
+    ring->pending = 0;
+    return flushed;
+}
+
+static int rx_ring_dispatch(struct rx_ring *ring, int count, pcap_handler handler, u_char *user)
+{
+    int handled = 0;
+    while (handled < count)
+    {
+        struct tpacket_block_desc *block =
+            (struct tpacket_block_desc *)(ring->map + (size_t)ring->block * ring->block_size);
+
+        /* Open the next block if the current one is used up */
+        if (ring->next == NULL)
+        {
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+                break;
+
+            ring->remaining = block->hdr.bh1.num_pkts;
+            ring->next = (uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+        }
+
+        while (ring->remaining > 0 && handled < count)
+        {
+            struct tpacket3_hdr *frame = (struct tpacket3_hdr *)ring->next;
+            const struct sockaddr_ll *addr =
+                (const struct sockaddr_ll *)((uint8_t *)frame + TPACKET_ALIGN(sizeof(*frame)));
+
+            ring->next += frame->tp_next_offset;
+            ring->remaining--;
+
+            if (addr->sll_pkttype == PACKET_OUTGOING)
+                continue;
+
+            struct pcap_pkthdr header;
+            header.ts.tv_sec = frame->tp_sec;
+            header.ts.tv_usec = frame->tp_nsec / 1000;
+            header.caplen = frame->tp_snaplen;
+            header.len = frame->tp_len;
+
+            /* Frames are handled in place, the block is returned after the last one */
+            handler(user, &header, (uint8_t *)frame + frame->tp_mac);
+            handled++;
+        }
+
+        if (ring->remaining == 0)
+        {
+            __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            ring->block = (ring->block + 1) % ring->block_count;
+            ring->next = NULL;
+        }
+    }
+
+    return handled;
+}
+
+static int rx_ring_set_filter(struct rx_ring *ring, const struct bpf_program *program)
+{
+    /* struct bpf_insn has the same layout as the kernel's struct sock_filter */
+    struct sock_fprog fprog = {
+        .len = program->bf_len,
+        .filter = (struct sock_filter *)program->bf_insns,
+    };
+
+    if (setsockopt(ring->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0)
+    {
+        log_error("rx ring: could not set filter (%s)", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* __APPLE__ */
+
+/* Make libpcap drop all frames, only used for handles that inject */
+static int pcap_reject_all(pcap_t *handle)
+{
+    struct bpf_insn reject[] = {
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct bpf_program program = {
+        .bf_len = sizeof(reject) / sizeof(reject[0]),
+        .bf_insns = reject,
+    };
+
+    if (pcap_setfilter(handle, &program) < 0)
+    {
+        log_error("pcap: could not set filter (%s)", pcap_geterr(handle));
+        return -1;
+    }
+    return 0;
+}
+static int wlan_set_filter(struct io_state *state, struct bpf_program *program)
+{
+#ifndef __APPLE__
+    if (state->use_rx_ring)
+        return rx_ring_set_filter(&state->rx_ring, program);
+#endif /* __APPLE__ */
+
+    if (pcap_setfilter(state->wlan_handle, program) < 0)
+    {
+        log_error("pcap: could not set filter (%s)", pcap_geterr(state->wlan_handle));
+        return -1;
+    }
+    return 0;
+}
+
+static int wlan_install_filter(struct io_state *state, const struct ether_addr *bssid_filter)
+{
     if (bssid_filter)
     {
         struct bpf_program filter;
         char filter_str[128];
         snprintf(filter_str, sizeof(filter_str), "wlan addr3 %s", ether_ntoa(bssid_filter));
-        if (pcap_compile(handle, &filter, filter_str, 1, PCAP_NETMASK_UNKNOWN) < 0)
+        if (pcap_compile(state->wlan_handle, &filter, filter_str, 1, PCAP_NETMASK_UNKNOWN) < 0)
         {
-            log_error("pcap: could not create filter (%s)", pcap_geterr(handle));
+            log_error("pcap: could not create filter (%s)", pcap_geterr(state->wlan_handle));
             return -1;
         }
 
-        if (pcap_setfilter(handle, &filter) < 0)
-        {
-            log_error("pcap: could not set filter (%s)", pcap_geterr(handle));
-            return -1;
-        }
+        int err = wlan_set_filter(state, &filter);
+        pcap_freecode(&filter);
+        return err;
     }
 
-    int fd = pcap_get_selectable_fd(handle);
-    if (fd < 0)
-    {
-        log_error("pcap: unable to get fd");
+    if (state->no_filter)
+        return 0;
+
+    struct nan_filter filter;
+    nan_filter_init(&filter, state->filter_self ? &state->if_ether_addr : NULL);
+    if (wlan_set_filter(state, &filter.program) < 0)
         return -1;
-    }
 
-    *pcap_handle = handle;
-    return fd;
+    log_debug("Installed NAN frame filter (%u instructions)", filter.program.bf_len);
+    return 0;
 }
 
 static int open_tun(char *dev, const struct ether_addr *self)
@@ -292,16 +646,69 @@ int io_state_init_wlan(struct io_state *state, const char *wlan, const int chann
         }
     }
 
-    state->wlan_fd = open_nonblocking_device(state->wlan_ifname, &state->wlan_handle, bssid_filter);
+    if (link_ether_addr_get(state->wlan_ifname, &state->if_ether_addr) < 0)
+    {
+        log_error("Could not get LLC address from %s", state->wlan_ifname);
+        return -1;
+    }
+
+    state->wlan_fd = open_nonblocking_device(state->wlan_ifname, &state->wlan_handle);
     if (state->wlan_fd < 0)
     {
         log_error("Could not open device %s: %d", state->wlan_ifname, state->wlan_fd);
         return -1;
     }
 
-    if (link_ether_addr_get(state->wlan_ifname, &state->if_ether_addr) < 0)
+    if (state->use_rx_ring)
     {
-        log_error("Could not get LLC address from %s", state->wlan_ifname);
+#ifndef __APPLE__
+        /* Frames are received via the ring, the pcap handle only injects */
+        if (pcap_reject_all(state->wlan_handle) < 0)
+            return -1;
+        state->wlan_inject_handle = state->wlan_handle;
+
+        state->wlan_fd = open_rx_ring(&state->rx_ring, state->wlan_ifindex);
+        if (state->wlan_fd < 0)
+        {
+            log_error("Could not open receive ring on %s", state->wlan_ifname);
+            return -1;
+        }
+        log_debug("Receive via TPACKET_V3 ring on %s", state->wlan_ifname);
+#else
+        log_error("Receive ring is only supported on Linux");
+        return -ENOTSUP;
+#endif /* __APPLE__ */
+    }
+    else
+    {
+        /* pcap handles are not thread-safe and wlan_handle might be read by the capture thread */
+        if (open_nonblocking_device(state->wlan_ifname, &state->wlan_inject_handle) < 0)
+        {
+            log_error("Could not open device %s for injection", state->wlan_ifname);
+            return -1;
+        }
+        if (pcap_reject_all(state->wlan_inject_handle) < 0)
+            return -1;
+    }
+
+    if (state->use_tx_ring)
+    {
+#ifndef __APPLE__
+        if (open_tx_ring(&state->tx_ring, state->wlan_ifindex) < 0)
+        {
+            log_error("Could not open transmit ring on %s", state->wlan_ifname);
+            return -1;
+        }
+        log_debug("Transmit via TPACKET_V2 ring on %s", state->wlan_ifname);
+#else
+        log_error("Transmit ring is only supported on Linux");
+        return -ENOTSUP;
+#endif /* __APPLE__ */
+    }
+
+    if (wlan_install_filter(state, bssid_filter) < 0)
+    {
+        log_error("Could not install frame filter on %s", state->wlan_ifname);
         return -1;
     }
 
@@ -354,23 +761,123 @@ int io_state_init(struct io_state *state, const char *wlan, const char *host, co
 void io_state_free(struct io_state *state)
 {
     close(state->host_fd);
+#ifndef __APPLE__
+    if (state->use_rx_ring)
+        close_rx_ring(&state->rx_ring);
+    if (state->use_tx_ring)
+        close_tx_ring(&state->tx_ring);
+#endif /* __APPLE__ */
+    if (state->wlan_inject_handle && state->wlan_inject_handle != state->wlan_handle)
+        pcap_close(state->wlan_inject_handle);
     pcap_close(state->wlan_handle);
 }
 
-int wlan_send(const struct io_state *state, const uint8_t *buffer, int length)
+int wlan_dispatch(struct io_state *state, int count, pcap_handler handler, u_char *user)
 {
     if (!state || !state->wlan_handle)
         return -EINVAL;
 
-    int result = pcap_inject(state->wlan_handle, buffer, length);
+#ifndef __APPLE__
+    if (state->use_rx_ring)
+        return rx_ring_dispatch(&state->rx_ring, count, handler, user);
+#endif /* __APPLE__ */
+
+    int result = pcap_dispatch(state->wlan_handle, count, handler, user);
     if (result < 0)
-        log_error("unable to inject packet (%s)", pcap_geterr(state->wlan_handle));
+        log_error("pcap: unable to dispatch frames (%s)", pcap_geterr(state->wlan_handle));
+
+    return result;
+}
+
+uint64_t wlan_rx_time_usec(const struct pcap_pkthdr *header)
+{
+    struct timespec realtime, monotonic;
+
+    if (header->ts.tv_sec == 0 && header->ts.tv_usec == 0)
+        return 0;
+
+    /* Capture timestamps are taken from the realtime clock */
+    if (clock_gettime(CLOCK_MONOTONIC, &monotonic) || clock_gettime(CLOCK_REALTIME, &realtime))
+        return 0;
+
+    int64_t realtime_usec = (int64_t)realtime.tv_sec * 1000000 + realtime.tv_nsec / 1000;
+    int64_t age_usec = realtime_usec - ((int64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec);
+    if (age_usec < 0)
+        return 0;
+
+    return (uint64_t)monotonic.tv_sec * 1000000 + monotonic.tv_nsec / 1000 - age_usec;
+}
+
+int wlan_send(struct io_state *state, const uint8_t *buffer, int length)
+{
+    if (!state || !state->wlan_inject_handle)
+        return -EINVAL;
+
+#ifndef __APPLE__
+    if (state->use_tx_ring)
+    {
+        size_t size;
+        uint8_t *slot = tx_ring_slot(&state->tx_ring, &size);
+        if (slot != NULL && (size_t)length <= size)
+        {
+            memcpy(slot, buffer, length);
+            tx_ring_commit(&state->tx_ring, length);
+            log_trace("queued %d bytes", length);
+            return length;
+        }
+
+        /* Keep the order of frames if this one has to be injected on its own */
+        if (tx_ring_flush(&state->tx_ring) < 0)
+            return -EIO;
+    }
+#endif /* __APPLE__ */
+
+    int result = pcap_inject(state->wlan_inject_handle, buffer, length);
+    if (result < 0)
+        log_error("unable to inject packet (%s)", pcap_geterr(state->wlan_inject_handle));
     else
         log_trace("injected %d bytes", result);
 
     return result;
 }
 
+uint8_t *wlan_tx_slot(struct io_state *state, size_t *size)
+{
+#ifndef __APPLE__
+    if (state && state->use_tx_ring)
+        return tx_ring_slot(&state->tx_ring, size);
+#endif /* __APPLE__ */
+    (void)state;
+    (void)size;
+    return NULL;
+}
+
+int wlan_tx_commit(struct io_state *state, size_t length)
+{
+#ifndef __APPLE__
+    if (state && state->use_tx_ring)
+    {
+        tx_ring_commit(&state->tx_ring, length);
+        return 0;
+    }
+#endif /* __APPLE__ */
+    (void)length;
+    return -EINVAL;
+}
+
+int wlan_flush(struct io_state *state)
+{
+    if (!state)
+        return -EINVAL;
+
+#ifndef __APPLE__
+    if (state->use_tx_ring)
+        return tx_ring_flush(&state->tx_ring);
+#endif /* __APPLE__ */
+
+    return 0;
+}
+
 int host_send(const struct io_state *state, const uint8_t *buffer, int length)
 {
     if (!state || !state->host_fd)
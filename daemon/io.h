@@ -12,9 +12,39 @@
 #include <netinet/ether.h>
 #endif
 
+/* Memory-mapped AF_PACKET receive ring (TPACKET_V3), only supported on Linux */
+struct rx_ring
+{
+    int fd;
+    uint8_t *map;
+    size_t size;
+    unsigned int block_size;
+    unsigned int block_count;
+    unsigned int block;     /* index of the block currently handed to user space */
+    unsigned int remaining; /* frames left in the current block */
+    uint8_t *next;          /* next frame in the current block */
+};
+
+/* Memory-mapped AF_PACKET transmit ring (TPACKET_V2), only supported on Linux */
+struct tx_ring
+{
+    int fd;
+    uint8_t *map;
+    size_t size;
+    unsigned int frame_size;
+    unsigned int frame_count;
+    unsigned int head;    /* next slot to fill */
+    unsigned int pending; /* filled slots not yet handed to the kernel */
+};
+
+/*
+ * With a capture thread, wlan_handle and rx_ring are only used by that thread after initialization,
+ * everything else, including wlan_inject_handle and tx_ring, only by the event loop thread.
+ */
 struct io_state
 {
-    pcap_t *wlan_handle;
+    pcap_t *wlan_handle;        /* receives frames, unless use_rx_ring */
+    pcap_t *wlan_inject_handle; /* injects frames, the same as wlan_handle if use_rx_ring */
     char wlan_ifname[IFNAMSIZ]; /* name of WLAN iface */
     int wlan_ifindex;           /* index of WLAN iface */
     int wlan_fd;
@@ -26,6 +56,12 @@ struct io_state
     bool no_monitor;
     bool no_channel;
     bool no_updown;
+    bool no_filter;   /* do not drop non-NAN frames in the kernel */
+    bool filter_self; /* also drop frames from if_ether_addr in the kernel */
+    bool use_rx_ring; /* receive from rx_ring instead of wlan_handle */
+    struct rx_ring rx_ring;
+    bool use_tx_ring; /* queue frames in tx_ring until wlan_flush instead of injecting each */
+    struct tx_ring tx_ring;
 };
 
 int io_state_init(struct io_state *state, const char *wlan, const char *host, const int channel,
@@ -33,7 +69,65 @@ int io_state_init(struct io_state *state, const char *wlan, const char *host, co
 
 void io_state_free(struct io_state *state);
 
-int wlan_send(const struct io_state *state, const uint8_t *buffer, int length);
+/**
+ * Pass up to count pending frames of the WLAN device to the handler. Depending on the
+ * configuration, frames are either read through libpcap or directly from the receive ring.
+ * Does not block if no frame is pending.
+ *
+ * @param state - The IO state
+ * @param count - The maximum number of frames to handle
+ * @param handler - The handler called for each frame
+ * @param user - Passed as first argument to the handler
+ * @returns The number of handled frames or a negative value on error
+ */
+int wlan_dispatch(struct io_state *state, int count, pcap_handler handler, u_char *user);
+
+/**
+ * Convert the kernel receive timestamp of a captured frame to the host clock used by clock_time_usec.
+ *
+ * @param header - The capture header of the frame
+ * @returns The receive time in microseconds or 0 if the frame has no usable timestamp
+ */
+uint64_t wlan_rx_time_usec(const struct pcap_pkthdr *header);
+
+/**
+ * Send a frame on the WLAN device. With the transmit ring, the frame is only queued
+ * and leaves with the next call to wlan_flush.
+ *
+ * @param state - The IO state
+ * @param buffer - The frame including its radiotap header
+ * @param length - The length of the frame in bytes
+ * @returns The number of sent or queued bytes or a negative value on error
+ */
+int wlan_send(struct io_state *state, const uint8_t *buffer, int length);
+
+/**
+ * Get the next free slot of the transmit ring to build a frame in place.
+ * The frame is queued by wlan_tx_commit.
+ *
+ * @param state - The IO state
+ * @param size - Set to the capacity of the slot in bytes
+ * @returns The slot or NULL if the transmit ring is not used or full
+ */
+uint8_t *wlan_tx_slot(struct io_state *state, size_t *size);
+
+/**
+ * Queue the frame built in the slot returned by the last call to wlan_tx_slot.
+ *
+ * @param state - The IO state
+ * @param length - The length of the frame in bytes
+ * @returns Zero on success or a negative value on error
+ */
+int wlan_tx_commit(struct io_state *state, size_t length);
+
+/**
+ * Hand all queued frames to the kernel with a single system call.
+ * Returns once the frames left the transmit ring. Does nothing without the transmit ring.
+ *
+ * @param state - The IO state
+ * @returns The number of flushed frames or a negative value on error
+ */
+int wlan_flush(struct io_state *state);
 
 int host_send(const struct io_state *state, const uint8_t *buffer, int length);
 
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 #include <stdbool.h>
 #include <ev.h>
@@ -31,6 +32,20 @@ void print_usage(char *arg0)
 	printf(" -M                       Do not enable monitor mode on interface\n");
 	printf(" -C                       Do not set channel on interface\n");
 	printf(" -U                       Do not set interface up/down\n");
+	printf(" -F                       Do not filter non-NAN frames in the kernel\n");
+	printf(" -S                       Filter frames sent from own address in the kernel\n");
+	printf(" -R                       Receive via a memory-mapped TPACKET_V3 ring instead of\n");
+	printf("                          libpcap (Linux only)\n");
+	printf(" -T                       Capture frames in a separate thread (Linux only)\n");
+	printf(" -W                       Send via a memory-mapped PACKET_TX_RING, flushed once per\n");
+	printf("                          discovery window, instead of libpcap (Linux only)\n");
+	printf(" -b number                Maximum number of frames handled per wakeup. Default is %d\n", RX_DEFAULT_BUDGET);
+	printf(" -t source                Arrival time of received frames: clock, kernel or tsft.\n");
+	printf("                          Default is clock\n");
+	printf(" -P number                Maximum number of tracked peers, 0 for no limit.\n");
+	printf("                          Default is %d\n", PEER_DEFAULT_MAX_PEERS);
+	printf(" -B                       Build every beacon and service discovery frame from scratch\n");
+	printf("                          instead of patching a prebuilt one\n");
 }
 
 int main(int argc, char *argv[])
@@ -43,12 +58,15 @@ int main(int argc, char *argv[])
 	char wlan[IFNAMSIZ] = "";
 	char host[IFNAMSIZ] = DEFAULT_NAN_DEVICE;
 	int channel = 6;
+	int max_peers = PEER_DEFAULT_MAX_PEERS;
 
 	struct daemon_state state;
+	memset(&state, 0, sizeof(state));
 	state.start_time_usec = clock_time_usec();
+	state.rx_budget = RX_DEFAULT_BUDGET;
 
 	int c;
-	while ((c = getopt(argc, argv, "vd::n:c:hMCU")) != -1)
+	while ((c = getopt(argc, argv, "vd::n:c:b:t:P:hMCUFSRTBW")) != -1)
 	{
 		switch (c)
 		{
@@ -78,11 +96,59 @@ int main(int argc, char *argv[])
 		case 'U':
 			state.io_state.no_updown = true;
 			break;
+		case 'F':
+			state.io_state.no_filter = true;
+			break;
+		case 'S':
+			state.io_state.filter_self = true;
+			break;
+		case 'R':
+			state.io_state.use_rx_ring = true;
+			break;
+		case 'T':
+			state.rx_threaded = true;
+			break;
+		case 'W':
+			state.io_state.use_tx_ring = true;
+			break;
+		case 'B':
+			state.frame_cache_disabled = true;
+			break;
+		case 'b':
+			state.rx_budget = atoi(optarg);
+			if (state.rx_budget <= 0)
+			{
+				log_error("Invalid frame budget: %s", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 't':
+		{
+			int source = nan_timestamp_source_from_string(optarg);
+			if (source < 0)
+			{
+				log_error("Unknown timestamp source: %s", optarg);
+				return EXIT_FAILURE;
+			}
+			state.timestamp_source = source;
+			break;
+		}
+		case 'P':
+			max_peers = atoi(optarg);
+			if (max_peers < 0)
+			{
+				log_error("Invalid maximum number of peers: %s", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		case '?':
 			switch (optopt)
 			{
 			case 'n':
 			case 'c':
+			case 'b':
+			case 't':
+			case 'P':
 			case 's':
 			case 'p':
 				log_error("Option -%c requires an argument.", optopt);
@@ -120,6 +186,7 @@ int main(int argc, char *argv[])
 		log_error("could not initialize core");
 		return EXIT_FAILURE;
 	}
+	nan_peer_set_max_peers(&state.nan_state.peers, max_peers);
 
 	printf("88b 88    db    88b 88\n"
 		   "88Yb88   dPYb   88Yb88\n"
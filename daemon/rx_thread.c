@@ -0,0 +1,219 @@
+#include "rx_thread.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef __APPLE__
+#include <sys/eventfd.h>
+#endif
+
+#include <log.h>
+
+#ifndef __APPLE__
+
+static unsigned int rx_queue_depth(const struct rx_queue *queue)
+{
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+static void rx_queue_push(u_char *user, const struct pcap_pkthdr *header, const u_char *data)
+{
+    struct rx_thread *thread = (struct rx_thread *)user;
+    struct rx_queue *queue = &thread->queue;
+
+    if (header->caplen > RX_QUEUE_SLOT_SIZE)
+    {
+        __atomic_add_fetch(&thread->stats.oversized, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    unsigned int head = queue->head;
+    unsigned int depth = head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (depth == queue->size)
+    {
+        __atomic_add_fetch(&thread->stats.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    struct rx_queue_slot *slot = &queue->slots[head & (queue->size - 1)];
+    slot->header = *header;
+    memcpy(slot->data, data, header->caplen);
+
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&thread->stats.enqueued, 1, __ATOMIC_RELAXED);
+    if (depth + 1 > __atomic_load_n(&thread->stats.high_water, __ATOMIC_RELAXED))
+        __atomic_store_n(&thread->stats.high_water, depth + 1, __ATOMIC_RELAXED);
+}
+
+static void rx_thread_notify(int fd)
+{
+    uint64_t value = 1;
+    if (write(fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        log_error("rx thread: could not notify event loop (%s)", strerror(errno));
+}
+
+static void *rx_thread_run(void *data)
+{
+    struct rx_thread *thread = data;
+    struct pollfd fds[2] = {
+        {.fd = thread->io_state->wlan_fd, .events = POLLIN},
+        {.fd = thread->stop_fd, .events = POLLIN},
+    };
+
+    while (__atomic_load_n(&thread->running, __ATOMIC_ACQUIRE))
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            log_error("rx thread: poll failed (%s)", strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (!fds[0].revents)
+            continue;
+
+        uint64_t enqueued = __atomic_load_n(&thread->stats.enqueued, __ATOMIC_RELAXED);
+        if (wlan_dispatch(thread->io_state, RX_THREAD_BATCH, rx_queue_push, (u_char *)thread) < 0)
+            break;
+
+        /* One notification per batch instead of one per frame */
+        if (__atomic_load_n(&thread->stats.enqueued, __ATOMIC_RELAXED) != enqueued)
+        {
+            __atomic_add_fetch(&thread->stats.wakeups, 1, __ATOMIC_RELAXED);
+            rx_thread_notify(thread->event_fd);
+        }
+    }
+
+    return NULL;
+}
+
+int rx_thread_start(struct rx_thread *thread, struct io_state *io_state, unsigned int size)
+{
+    int err;
+
+    if (size == 0 || (size & (size - 1)) != 0)
+        return -EINVAL;
+
+    memset(thread, 0, sizeof(struct rx_thread));
+    thread->io_state = io_state;
+    thread->queue.size = size;
+    thread->queue.slots = calloc(size, sizeof(struct rx_queue_slot));
+    if (thread->queue.slots == NULL)
+        return -ENOMEM;
+
+    thread->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    thread->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (thread->event_fd < 0 || thread->stop_fd < 0)
+    {
+        err = -errno;
+        log_error("rx thread: could not create eventfd (%s)", strerror(errno));
+        goto error;
+    }
+
+    thread->running = true;
+    if ((err = pthread_create(&thread->thread, NULL, rx_thread_run, thread)))
+    {
+        log_error("rx thread: could not create thread (%s)", strerror(err));
+        thread->running = false;
+        err = -err;
+        goto error;
+    }
+
+    return 0;
+
+error:
+    if (thread->event_fd >= 0)
+        close(thread->event_fd);
+    if (thread->stop_fd >= 0)
+        close(thread->stop_fd);
+    free(thread->queue.slots);
+    thread->queue.slots = NULL;
+    return err;
+}
+
+void rx_thread_stop(struct rx_thread *thread)
+{
+    if (!thread->running)
+        return;
+
+    __atomic_store_n(&thread->running, false, __ATOMIC_RELEASE);
+    rx_thread_notify(thread->stop_fd);
+    pthread_join(thread->thread, NULL);
+
+    close(thread->event_fd);
+    close(thread->stop_fd);
+    free(thread->queue.slots);
+    thread->queue.slots = NULL;
+}
+
+int rx_thread_dispatch(struct rx_thread *thread, int count, pcap_handler handler, u_char *user)
+{
+    struct rx_queue *queue = &thread->queue;
+    uint64_t value;
+    int frames = 0;
+
+    /* Clear the notification first, so that frames queued from now on notify again */
+    if (read(thread->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        log_error("rx thread: could not read eventfd (%s)", strerror(errno));
+
+    unsigned int tail = queue->tail;
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    while (frames < count && tail != head)
+    {
+        struct rx_queue_slot *slot = &queue->slots[tail & (queue->size - 1)];
+        handler(user, &slot->header, slot->data);
+        __atomic_store_n(&queue->tail, ++tail, __ATOMIC_RELEASE);
+        frames++;
+    }
+
+    /* Budget exhausted, make sure the event loop comes back for the rest */
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+        rx_thread_notify(thread->event_fd);
+
+    return frames;
+}
+
+unsigned int rx_thread_queue_depth(const struct rx_thread *thread)
+{
+    return rx_queue_depth(&thread->queue);
+}
+
+#else
+
+int rx_thread_start(struct rx_thread *thread, struct io_state *io_state, unsigned int size)
+{
+    (void)io_state;
+    (void)size;
+    memset(thread, 0, sizeof(struct rx_thread));
+    log_error("rx thread: not supported on this platform");
+    return -ENOTSUP;
+}
+
+void rx_thread_stop(struct rx_thread *thread)
+{
+    (void)thread;
+}
+
+int rx_thread_dispatch(struct rx_thread *thread, int count, pcap_handler handler, u_char *user)
+{
+    (void)thread;
+    (void)count;
+    (void)handler;
+    (void)user;
+    return 0;
+}
+
+unsigned int rx_thread_queue_depth(const struct rx_thread *thread)
+{
+    (void)thread;
+    return 0;
+}
+
+#endif /* __APPLE__ */
@@ -0,0 +1,94 @@
+#ifndef NAN_RX_THREAD_H_
+#define NAN_RX_THREAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <pcap/pcap.h>
+
+#include "io.h"
+
+/* Number of slots in the queue between capture and event loop thread, must be a power of two */
+#define RX_QUEUE_DEFAULT_SIZE 256
+/* Maximum length of a queued frame, longer frames are dropped */
+#define RX_QUEUE_SLOT_SIZE 4096
+/* Maximum number of frames captured before the event loop is woken up */
+#define RX_THREAD_BATCH 32
+
+struct rx_queue_slot
+{
+    struct pcap_pkthdr header;
+    uint8_t data[RX_QUEUE_SLOT_SIZE];
+};
+
+/*
+ * Bounded lock-free single-producer/single-consumer ring.
+ * head is only written by the capture thread, tail only by the event loop thread.
+ */
+struct rx_queue
+{
+    struct rx_queue_slot *slots;
+    unsigned int size;
+    unsigned int head; /* next slot to be written by the producer */
+    unsigned int tail; /* next slot to be read by the consumer */
+};
+
+struct rx_queue_stats
+{
+    uint64_t enqueued;   /* frames put into the queue */
+    uint64_t dropped;    /* frames dropped because the queue was full */
+    uint64_t oversized;  /* frames dropped because they did not fit into a slot */
+    uint64_t wakeups;    /* eventfd notifications sent to the event loop */
+    unsigned int high_water; /* maximum observed queue depth */
+};
+
+struct rx_thread
+{
+    pthread_t thread;
+    struct io_state *io_state;
+    struct rx_queue queue;
+    struct rx_queue_stats stats;
+    int event_fd; /* signals queued frames to the event loop */
+    int stop_fd;  /* signals the capture thread to stop */
+    bool running;
+};
+
+/**
+ * Start a thread that captures frames from the WLAN device into a queue.
+ * The event loop is notified about queued frames via the event_fd.
+ *
+ * @param thread - The thread state to initialize
+ * @param io_state - The IO state, the thread owns its receiving handle, either wlan_handle or rx_ring
+ * @param size - The number of queue slots, a power of two
+ * @returns 0 on success, a negative value otherwise
+ */
+int rx_thread_start(struct rx_thread *thread, struct io_state *io_state, unsigned int size);
+
+/**
+ * Stop the capture thread and release the queue.
+ *
+ * @param thread - The thread state
+ */
+void rx_thread_stop(struct rx_thread *thread);
+
+/**
+ * Pass up to count queued frames to the handler. Must only be called from the event loop thread.
+ * Clears the pending notification and renews it if frames are left afterwards.
+ *
+ * @param thread - The thread state
+ * @param count - The maximum number of frames to handle
+ * @param handler - The handler called for each frame
+ * @param user - Passed as first argument to the handler
+ * @returns The number of handled frames
+ */
+int rx_thread_dispatch(struct rx_thread *thread, int count, pcap_handler handler, u_char *user);
+
+/**
+ * Get the number of frames currently waiting in the queue.
+ *
+ * @param thread - The thread state
+ * @returns The queue depth
+ */
+unsigned int rx_thread_queue_depth(const struct rx_thread *thread);
+
+#endif // NAN_RX_THREAD_H_
@@ -0,0 +1,411 @@
+/*
+ * Replays a radiotap capture (pcap or pcapng) through nan_rx as fast as possible.
+ *
+ * The stack runs on a virtual clock driven by the capture timestamps. Before a
+ * frame is handled, the discovery beacon, discovery window, discovery window end
+ * and peer clean timers of daemon/core.c that are due are fired in order. Frames
+ * the stack would send are built but not transmitted.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pcap.h>
+
+#include <state.h>
+#include <rx.h>
+#include <tx.h>
+#include <frame.h>
+#include <ieee80211.h>
+#include <log.h>
+#include <utils.h>
+
+#include "../bench/bench.h"
+
+enum replay_frame_type
+{
+    REPLAY_SYNC_BEACON,
+    REPLAY_DISCOVERY_BEACON,
+    REPLAY_SERVICE_DISCOVERY,
+    REPLAY_ACTION,
+    REPLAY_OTHER,
+    REPLAY_FRAME_TYPE_COUNT,
+};
+
+static const char *replay_frame_type_names[REPLAY_FRAME_TYPE_COUNT] = {
+    "sync beacon",
+    "discovery beacon",
+    "service discovery",
+    "action",
+    "other",
+};
+
+struct frame
+{
+    uint8_t *data;
+    uint32_t length;
+    uint64_t time_usec;
+};
+
+struct replay_stats
+{
+    uint64_t frames[REPLAY_FRAME_TYPE_COUNT];
+    uint64_t rx_nsec[REPLAY_FRAME_TYPE_COUNT];
+    uint64_t errors;
+    uint64_t timer_nsec;
+    uint64_t discovery_windows;
+    uint64_t tx_frames;
+    uint64_t tx_bytes;
+};
+
+/* Virtual deadlines of the timers scheduled by daemon/core.c */
+struct replay_timers
+{
+    uint64_t send_discovery_beacon;
+    uint64_t discovery_window;
+    uint64_t discovery_window_end;
+    uint64_t clean_peers;
+};
+
+static int load_capture(const char *path, struct frame **frames, size_t *count)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(path, errbuf);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Could not open %s: %s\n", path, errbuf);
+        return -1;
+    }
+
+    if (pcap_datalink(handle) != DLT_IEEE802_11_RADIO)
+    {
+        fprintf(stderr, "Capture %s does not contain radiotap headers\n", path);
+        pcap_close(handle);
+        return -1;
+    }
+
+    size_t capacity = 1024;
+    *frames = malloc(capacity * sizeof(struct frame));
+    *count = 0;
+
+    struct pcap_pkthdr *header;
+    const uint8_t *data;
+    while (pcap_next_ex(handle, &header, &data) == 1)
+    {
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            *frames = realloc(*frames, capacity * sizeof(struct frame));
+        }
+        struct frame *frame = &(*frames)[(*count)++];
+        frame->data = malloc(header->caplen);
+        frame->length = header->caplen;
+        frame->time_usec = (uint64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec;
+        memcpy(frame->data, data, header->caplen);
+    }
+
+    pcap_close(handle);
+    return 0;
+}
+
+static enum replay_frame_type replay_classify(const struct frame *frame)
+{
+    if (frame->length < 4)
+        return REPLAY_OTHER;
+
+    uint16_t radiotap_length = frame->data[2] | frame->data[3] << 8;
+    if (frame->length < radiotap_length + sizeof(struct ieee80211_hdr))
+        return REPLAY_OTHER;
+
+    const struct ieee80211_hdr *header = (const struct ieee80211_hdr *)(frame->data + radiotap_length);
+    const uint8_t *body = frame->data + radiotap_length + sizeof(struct ieee80211_hdr);
+    size_t body_length = frame->length - radiotap_length - sizeof(struct ieee80211_hdr);
+
+    switch (le16toh(header->frame_control) & (IEEE80211_FCTL_FTYPE | IEEE80211_FCTL_STYPE))
+    {
+    case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON:
+        if (body_length < sizeof(struct nan_beacon_frame))
+            return REPLAY_OTHER;
+        if (le16toh(((const struct nan_beacon_frame *)body)->beacon_interval) == NAN_SYNC_BEACON_INTERVAL_TU)
+            return REPLAY_SYNC_BEACON;
+        return REPLAY_DISCOVERY_BEACON;
+    case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_ACTION:
+        if (body_length < sizeof(struct nan_action_frame))
+            return REPLAY_OTHER;
+        if (((const struct nan_action_frame *)body)->oui_type == NAN_OUT_TYPE_SERVICE_DISCOVERY)
+            return REPLAY_SERVICE_DISCOVERY;
+        return REPLAY_ACTION;
+    default:
+        return REPLAY_OTHER;
+    }
+}
+
+static void replay_tx(struct replay_stats *stats, size_t length)
+{
+    stats->tx_frames++;
+    stats->tx_bytes += length;
+}
+
+static bool replay_tx_beacon(struct nan_state *state, struct replay_stats *stats,
+                             enum nan_beacon_type type, uint64_t now_usec)
+{
+    size_t length;
+    const uint8_t *frame = nan_get_beacon_frame(state, type, now_usec, &length);
+    enum nan_tx_priority priority = type == NAN_SYNC_BEACON ? NAN_TX_SYNC_BEACON : NAN_TX_DISCOVERY_BEACON;
+    if (frame == NULL || !nan_reserve_airtime(state, priority, frame, length))
+        return false;
+
+    replay_tx(stats, length);
+    return true;
+}
+
+static void replay_discovery_window(struct nan_state *state, struct replay_timers *timers,
+                                    struct replay_stats *stats, uint64_t now_usec)
+{
+    if (!nan_timer_in_dw(&state->timer, now_usec) ||
+        !nan_timer_initial_scan_done(&state->timer, now_usec))
+    {
+        timers->discovery_window = now_usec + nan_timer_next_dw_usec(&state->timer, now_usec);
+        return;
+    }
+
+    stats->discovery_windows++;
+
+    nan_open_discovery_window_schedule(state, now_usec);
+    replay_tx_beacon(state, stats, NAN_SYNC_BEACON, now_usec);
+
+    struct buf *buffered = NULL;
+    while ((buffered = nan_tx_schedule_next(&state->tx_schedule, NAN_TX_FOLLOW_UP, now_usec)) != NULL)
+    {
+        replay_tx(stats, buf_position(buffered));
+        buf_free(buffered);
+    }
+
+    list_t announced_services;
+    size_t length;
+    const uint8_t *frame = nan_get_service_discovery_frame(state, &NAN_NETWORK_ID, &announced_services, &length);
+    if (frame != NULL && nan_reserve_airtime(state, NAN_TX_SERVICE_DISCOVERY, frame, length))
+    {
+        replay_tx(stats, length);
+        nan_update_announced_services(&state->services, announced_services);
+    }
+
+    timers->discovery_window_end = now_usec + nan_timer_dw_end_usec(&state->timer, now_usec);
+    timers->discovery_window = now_usec + nan_timer_next_dw_usec(&state->timer, now_usec);
+}
+
+static void replay_timers_init(struct replay_timers *timers, uint64_t now_usec)
+{
+    timers->send_discovery_beacon = now_usec;
+    timers->discovery_window = now_usec;
+    timers->discovery_window_end = UINT64_MAX;
+    timers->clean_peers = now_usec;
+}
+
+/* Fire all timers due until the given time in the order of their deadlines */
+static void replay_timers_run(struct nan_state *state, struct nan_virtual_clock *clock,
+                              struct replay_timers *timers, struct replay_stats *stats,
+                              uint64_t until_usec)
+{
+    while (true)
+    {
+        uint64_t *next = &timers->send_discovery_beacon;
+        if (timers->discovery_window < *next)
+            next = &timers->discovery_window;
+        if (timers->discovery_window_end < *next)
+            next = &timers->discovery_window_end;
+        if (timers->clean_peers < *next)
+            next = &timers->clean_peers;
+
+        uint64_t now_usec = *next;
+        if (now_usec > until_usec)
+            return;
+        nan_virtual_clock_set(clock, now_usec);
+
+        if (next == &timers->send_discovery_beacon)
+        {
+            if (nan_can_send_discovery_beacon(state, now_usec))
+            {
+                nan_open_discovery_beacon_schedule(state, now_usec);
+                if (replay_tx_beacon(state, stats, NAN_DISCOVERY_BEACON, now_usec))
+                    nan_timer_set_last_discovery_beacon_usec(&state->timer, now_usec);
+            }
+            /* The daemon polls again immediately if the beacon was not sent, e.g. as non-master,
+             * check once per beacon interval instead */
+            uint64_t in_usec = nan_timer_next_discovery_beacon_usec(&state->timer, now_usec);
+            *next = now_usec + (in_usec > 0 ? in_usec : TU_TO_USEC(NAN_DISCOVERY_BEACON_INTERVAL_TU));
+        }
+        else if (next == &timers->discovery_window)
+        {
+            replay_discovery_window(state, timers, stats, now_usec);
+        }
+        else if (next == &timers->discovery_window_end)
+        {
+            nan_master_election(&state->sync, &state->peers, now_usec);
+            nan_check_anchor_master_expiration(&state->sync);
+            *next = UINT64_MAX;
+        }
+        else
+        {
+            nan_peers_clean(&state->peers, now_usec);
+            *next = now_usec + state->peers.clean_interval_usec;
+        }
+    }
+}
+
+static void replay_print_state(const struct nan_state *state, uint64_t now_usec)
+{
+    printf("\n");
+    printf("Final state\n");
+    printf("---------------------------------------------\n");
+    printf("Cluster ID               %s\n", ether_addr_to_string(&state->cluster.cluster_id));
+    printf("Role                     %s\n", nan_role_to_string(state->sync.role));
+    printf("Master rank              %lu\n", state->sync.master_rank);
+    printf("Anchor master rank       %lu\n", state->sync.anchor_master_rank);
+    printf("Anchor master            %s\n", ether_addr_to_string(nan_get_anchor_master_address(&state->sync)));
+    printf("Hop count                %u\n", state->sync.hop_count);
+    printf("AMBTT                    %u\n", state->sync.ambtt);
+    printf("Synced time (tu)         %lu\n", nan_timer_get_synced_time_tu(&state->timer, now_usec));
+    printf("Peers                    %d\n", list_len(state->peers.peers));
+    printf("Duplicates               %lu\n", state->rx_duplicates);
+    printf("Peer limit reached       %lu\n", state->rx_peer_limit);
+}
+
+static void print_usage(const char *arg0)
+{
+    printf("Usage: %s [options] <capture>\n", arg0);
+    printf("\n");
+    printf("Arguments:\n");
+    printf(" capture                  A pcap or pcapng capture with radiotap headers\n");
+    printf("\n");
+    printf("Options:\n");
+    printf(" -v                       Increase log level\n");
+    printf(" -a address               Own ethernet address. Default is 02:00:00:00:00:01\n");
+    printf(" -c number                Channel of the capture. Default is 6\n");
+    printf(" -t source                Arrival time of replayed frames: clock, kernel or tsft.\n");
+    printf("                          The clock and kernel timestamps are the capture timestamps.\n");
+    printf("                          Default is clock\n");
+}
+
+int main(int argc, char *argv[])
+{
+    log_set_level(LOG_ERR);
+
+    struct ether_addr address = {{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}};
+    int channel = 6;
+    int timestamp_source = TIMESTAMP_SOURCE_CLOCK;
+
+    int c;
+    while ((c = getopt(argc, argv, "va:c:t:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'v':
+            log_increase_level();
+            break;
+        case 'a':
+            if (ether_aton_r(optarg, &address) == NULL)
+            {
+                fprintf(stderr, "Invalid address: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            channel = atoi(optarg);
+            break;
+        case 't':
+            timestamp_source = nan_timestamp_source_from_string(optarg);
+            if (timestamp_source < 0)
+            {
+                fprintf(stderr, "Unknown timestamp source: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct frame *frames;
+    size_t count;
+    if (load_capture(argv[optind], &frames, &count) < 0)
+        return EXIT_FAILURE;
+    if (count == 0)
+    {
+        fprintf(stderr, "Capture %s is empty\n", argv[optind]);
+        free(frames);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start_usec = frames[0].time_usec;
+    struct nan_virtual_clock clock;
+    nan_virtual_clock_init(&clock, start_usec);
+
+    struct nan_state state;
+    init_nan_state(&state, "replay", &address, channel, start_usec);
+    nan_clock_init_virtual(&state.clock, &clock);
+    state.timestamp.source = timestamp_source;
+
+    struct replay_timers timers;
+    struct replay_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    replay_timers_init(&timers, start_usec);
+
+    uint64_t start_nsec = bench_time_nsec();
+    for (size_t i = 0; i < count; i++)
+    {
+        /* Captures may contain frames slightly out of order, the virtual clock never goes back */
+        uint64_t until_usec = frames[i].time_usec > clock.now_usec ? frames[i].time_usec : clock.now_usec;
+
+        uint64_t timer_start_nsec = bench_time_nsec();
+        replay_timers_run(&state, &clock, &timers, &stats, until_usec);
+        nan_virtual_clock_set(&clock, until_usec);
+        uint64_t rx_start_nsec = bench_time_nsec();
+        stats.timer_nsec += rx_start_nsec - timer_start_nsec;
+
+        enum replay_frame_type type = replay_classify(&frames[i]);
+        struct buf buf = buf_view(frames[i].data, frames[i].length);
+        if (nan_rx(&buf, &state, frames[i].time_usec) < RX_OK)
+            stats.errors++;
+
+        stats.rx_nsec[type] += bench_time_nsec() - rx_start_nsec;
+        stats.frames[type]++;
+    }
+    uint64_t total_nsec = bench_time_nsec() - start_nsec;
+
+    uint64_t rx_nsec = 0;
+    for (int type = 0; type < REPLAY_FRAME_TYPE_COUNT; type++)
+        rx_nsec += stats.rx_nsec[type];
+
+    printf("%zu frames, %.3f s of capture replayed in %.3f s\n", count,
+           (clock.now_usec - start_usec) / 1e6, total_nsec / 1e9);
+    printf("Frames/s (nan_rx only)   %.0f\n", bench_per_second(count, rx_nsec));
+    printf("Frames/s (with timers)   %.0f\n", bench_per_second(count, total_nsec));
+    printf("Unhandled frames         %lu\n", stats.errors);
+    printf("Discovery windows        %lu\n", stats.discovery_windows);
+    printf("Built frames             %lu (%lu bytes)\n", stats.tx_frames, stats.tx_bytes);
+    printf("Timer ns                 %lu\n", stats.timer_nsec);
+    printf("\n");
+    printf("%-20s %12s %12s\n", "Frame type", "frames", "ns/frame");
+    for (int type = 0; type < REPLAY_FRAME_TYPE_COUNT; type++)
+        printf("%-20s %12lu %12.0f\n", replay_frame_type_names[type], stats.frames[type],
+               stats.frames[type] ? (double)stats.rx_nsec[type] / stats.frames[type] : 0.0);
+
+    replay_print_state(&state, clock.now_usec);
+
+    for (size_t i = 0; i < count; i++)
+        free(frames[i].data);
+    free(frames);
+
+    return EXIT_SUCCESS;
+}
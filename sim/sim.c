@@ -0,0 +1,727 @@
+/*
+ * Simulates many NAN devices in one process on a virtual radio medium.
+ *
+ * Every node owns a complete nan_state with its own drifting clock derived from
+ * a global virtual clock. The timers of daemon/core.c are emulated per node on
+ * the node's clock. Beacons and service discovery frames a node builds are
+ * delivered to the nan_rx of all nodes in range after a propagation delay, with
+ * a per link RSSI derived from the node positions and a configurable loss rate.
+ * Frame collisions are not modelled.
+ *
+ * At the end the time until all nodes agreed on one cluster and anchor master,
+ * the number of clusters and the CPU time spent per node and DW are reported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <radiotap.h>
+
+#include <state.h>
+#include <rx.h>
+#include <tx.h>
+#include <frame.h>
+#include <clock.h>
+#include <ieee80211.h>
+#include <log.h>
+#include <utils.h>
+
+#include "../bench/bench.h"
+
+#define SIM_DEFAULT_NODES 50
+#define SIM_DEFAULT_DURATION_SEC 60
+#define SIM_DEFAULT_AREA_METERS 30
+#define SIM_DEFAULT_DRIFT_PPM 20
+#define SIM_DEFAULT_DELAY_USEC 1
+#define SIM_DEFAULT_BOOT_SPREAD_SEC 1
+
+/* Log-distance path loss at 2.4 GHz */
+#define SIM_RSSI_AT_1M -40
+#define SIM_PATH_LOSS_EXPONENT 3.0
+#define SIM_RSSI_SENSITIVITY -92
+
+#define SIM_DW_INTERVAL_USEC (TU_TO_USEC(NAN_DW_INTERVAL_TU))
+#define SIM_SERVICE_NAME "_sim._tcp"
+
+enum sim_timer
+{
+    SIM_TIMER_BOOT,
+    SIM_TIMER_DISCOVERY_BEACON,
+    SIM_TIMER_DISCOVERY_WINDOW,
+    SIM_TIMER_DISCOVERY_WINDOW_END,
+    SIM_TIMER_CLEAN_PEERS,
+};
+
+enum sim_event_type
+{
+    SIM_EVENT_TIMER,
+    SIM_EVENT_RECEIVE,
+    SIM_EVENT_SAMPLE,
+};
+
+/* An 802.11 frame without radiotap header, shared by all its receivers */
+struct sim_frame
+{
+    int references;
+    bool fcs;
+    uint16_t length;
+    uint8_t data[];
+};
+
+struct sim_event
+{
+    uint64_t time_usec;
+    /* Orders events at the same time by their creation */
+    uint64_t sequence;
+    enum sim_event_type type;
+    unsigned int node;
+    enum sim_timer timer;
+    struct sim_frame *frame;
+    signed char rssi;
+};
+
+struct sim_queue
+{
+    struct sim_event *events;
+    size_t length;
+    size_t capacity;
+    uint64_t sequence;
+};
+
+struct sim_node
+{
+    struct nan_state state;
+    struct nan_drift_clock clock;
+    double x, y;
+    /* Frames are only delivered after the device powered up */
+    bool booted;
+    /* Pending DW end in node time, to avoid scheduling it twice */
+    bool discovery_window_end_pending;
+    uint64_t cpu_nsec;
+};
+
+struct sim_config
+{
+    unsigned int nodes;
+    double duration_sec;
+    double area_meters;
+    double loss;
+    double drift_ppm;
+    uint64_t delay_usec;
+    double boot_spread_sec;
+    bool services;
+    unsigned int seed;
+};
+
+struct sim_stats
+{
+    uint64_t sent;
+    uint64_t delivered;
+    uint64_t lost;
+    uint64_t out_of_range;
+    uint64_t rx_errors;
+
+    uint64_t converged_usec;
+    bool converged;
+    unsigned int splits;
+    unsigned int clusters;
+    unsigned int anchor_masters;
+};
+
+struct sim
+{
+    struct sim_config config;
+    struct nan_virtual_clock medium_clock;
+    struct nan_clock medium;
+    struct sim_node *nodes;
+    signed char *rssi;
+    struct sim_queue queue;
+    struct sim_stats stats;
+    uint64_t random;
+    uint8_t rx_buffer[BUF_MAX_LENGTH + 16];
+};
+
+/* Random numbers of the medium, independent from the rand() used by the library */
+static uint64_t sim_random(struct sim *sim)
+{
+    sim->random ^= sim->random << 13;
+    sim->random ^= sim->random >> 7;
+    sim->random ^= sim->random << 17;
+    return sim->random;
+}
+
+static double sim_random_uniform(struct sim *sim)
+{
+    return (double)(sim_random(sim) >> 11) / (double)(1ULL << 53);
+}
+
+static bool sim_event_before(const struct sim_event *a, const struct sim_event *b)
+{
+    if (a->time_usec != b->time_usec)
+        return a->time_usec < b->time_usec;
+    return a->sequence < b->sequence;
+}
+
+static void sim_queue_push(struct sim_queue *queue, struct sim_event event)
+{
+    if (queue->length == queue->capacity)
+    {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : 1024;
+        queue->events = realloc(queue->events, queue->capacity * sizeof(struct sim_event));
+    }
+
+    event.sequence = queue->sequence++;
+    size_t i = queue->length++;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!sim_event_before(&event, &queue->events[parent]))
+            break;
+        queue->events[i] = queue->events[parent];
+        i = parent;
+    }
+    queue->events[i] = event;
+}
+
+static struct sim_event sim_queue_pop(struct sim_queue *queue)
+{
+    struct sim_event top = queue->events[0];
+    struct sim_event last = queue->events[--queue->length];
+
+    size_t i = 0;
+    while (true)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= queue->length)
+            break;
+        if (child + 1 < queue->length && sim_event_before(&queue->events[child + 1], &queue->events[child]))
+            child++;
+        if (!sim_event_before(&queue->events[child], &last))
+            break;
+        queue->events[i] = queue->events[child];
+        i = child;
+    }
+    if (queue->length > 0)
+        queue->events[i] = last;
+
+    return top;
+}
+
+static uint64_t sim_node_now_usec(const struct sim_node *node)
+{
+    return nan_clock_now_usec(&node->state.clock);
+}
+
+/* Schedule a node timer that expires after the given time of the node's clock */
+static void sim_schedule_timer(struct sim *sim, unsigned int node, enum sim_timer timer, uint64_t in_usec)
+{
+    /* Round up, so that the node's clock has reached the deadline when the timer fires */
+    double rate = 1 + sim->nodes[node].clock.drift_ppm / 1e6;
+    uint64_t medium_usec = (uint64_t)ceil(in_usec / rate);
+
+    struct sim_event event = {
+        .time_usec = sim->medium_clock.now_usec + medium_usec,
+        .type = SIM_EVENT_TIMER,
+        .node = node,
+        .timer = timer,
+    };
+    sim_queue_push(&sim->queue, event);
+}
+
+static void sim_transmit(struct sim *sim, unsigned int sender, const uint8_t *data, size_t size)
+{
+    sim->stats.sent++;
+
+    /* Strip the transmit radiotap header, receivers get their own */
+    uint16_t radiotap_length = data[2] | data[3] << 8;
+    size_t length = size - radiotap_length;
+
+    struct sim_frame *frame = malloc(sizeof(struct sim_frame) + length);
+    frame->references = 0;
+    frame->fcs = sim->nodes[sender].state.ieee80211.fcs;
+    frame->length = length;
+    memcpy(frame->data, data + radiotap_length, length);
+
+    for (unsigned int receiver = 0; receiver < sim->config.nodes; receiver++)
+    {
+        if (receiver == sender || !sim->nodes[receiver].booted)
+            continue;
+
+        signed char rssi = sim->rssi[sender * sim->config.nodes + receiver];
+        if (rssi < SIM_RSSI_SENSITIVITY)
+        {
+            sim->stats.out_of_range++;
+            continue;
+        }
+        if (sim->config.loss > 0 && sim_random_uniform(sim) < sim->config.loss)
+        {
+            sim->stats.lost++;
+            continue;
+        }
+
+        struct sim_event event = {
+            .time_usec = sim->medium_clock.now_usec + sim->config.delay_usec,
+            .type = SIM_EVENT_RECEIVE,
+            .node = receiver,
+            .frame = frame,
+            .rssi = rssi,
+        };
+        frame->references++;
+        sim_queue_push(&sim->queue, event);
+    }
+
+    if (frame->references == 0)
+        free(frame);
+}
+
+static void sim_transmit_buf(struct sim *sim, unsigned int sender, struct buf *buf)
+{
+    sim_transmit(sim, sender, buf_data(buf), buf_position(buf));
+}
+
+static bool sim_transmit_beacon(struct sim *sim, unsigned int node,
+                                enum nan_beacon_type type, uint64_t now_usec)
+{
+    struct nan_state *state = &sim->nodes[node].state;
+    size_t length;
+    const uint8_t *frame = nan_get_beacon_frame(state, type, now_usec, &length);
+    enum nan_tx_priority priority = type == NAN_SYNC_BEACON ? NAN_TX_SYNC_BEACON : NAN_TX_DISCOVERY_BEACON;
+    if (frame == NULL || !nan_reserve_airtime(state, priority, frame, length))
+        return false;
+
+    sim_transmit(sim, node, frame, length);
+    return true;
+}
+
+static void sim_discovery_window(struct sim *sim, unsigned int index, uint64_t now_usec)
+{
+    struct sim_node *node = &sim->nodes[index];
+    struct nan_state *state = &node->state;
+
+    if (!nan_timer_in_dw(&state->timer, now_usec) ||
+        !nan_timer_initial_scan_done(&state->timer, now_usec))
+    {
+        sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_WINDOW, nan_timer_next_dw_usec(&state->timer, now_usec));
+        return;
+    }
+
+    nan_open_discovery_window_schedule(state, now_usec);
+    sim_transmit_beacon(sim, index, NAN_SYNC_BEACON, now_usec);
+
+    struct buf *buf = NULL;
+    while ((buf = nan_tx_schedule_next(&state->tx_schedule, NAN_TX_FOLLOW_UP, now_usec)) != NULL)
+    {
+        sim_transmit_buf(sim, index, buf);
+        buf_free(buf);
+    }
+
+    list_t announced_services;
+    size_t length;
+    const uint8_t *frame = nan_get_service_discovery_frame(state, &NAN_NETWORK_ID, &announced_services, &length);
+    if (frame != NULL && nan_reserve_airtime(state, NAN_TX_SERVICE_DISCOVERY, frame, length))
+    {
+        sim_transmit(sim, index, frame, length);
+        nan_update_announced_services(&state->services, announced_services);
+    }
+
+    if (!node->discovery_window_end_pending)
+    {
+        node->discovery_window_end_pending = true;
+        sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_WINDOW_END, nan_timer_dw_end_usec(&state->timer, now_usec));
+    }
+    sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_WINDOW, nan_timer_next_dw_usec(&state->timer, now_usec));
+}
+
+static void sim_boot(struct sim *sim, unsigned int index)
+{
+    struct sim_node *node = &sim->nodes[index];
+
+    struct ether_addr address = {{0x02, 0x00, 0x00, 0x00, (index >> 8) & 0xff, index & 0xff}};
+    char hostname[HOST_NAME_LENGTH_MAX + 1];
+    snprintf(hostname, sizeof(hostname), "node%u", index);
+    init_nan_state(&node->state, hostname, &address, 6, nan_drift_clock_now_usec(&node->clock));
+    nan_clock_init_drift(&node->state.clock, &node->clock);
+
+    if (sim->config.services)
+    {
+        nan_publish(&node->state.services, SIM_SERVICE_NAME, PUBLISH_UNSOLICITED, -1, NULL, 0);
+        nan_subscribe(&node->state.services, SIM_SERVICE_NAME, SUBSCRIBE_PASSIVE, -1, NULL, 0);
+    }
+
+    node->booted = true;
+    sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_BEACON, 0);
+    sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_WINDOW, 0);
+    sim_schedule_timer(sim, index, SIM_TIMER_CLEAN_PEERS, node->state.peers.clean_interval_usec);
+}
+
+static void sim_handle_timer(struct sim *sim, unsigned int index, enum sim_timer timer)
+{
+    if (timer == SIM_TIMER_BOOT)
+    {
+        sim_boot(sim, index);
+        return;
+    }
+
+    struct sim_node *node = &sim->nodes[index];
+    struct nan_state *state = &node->state;
+    uint64_t now_usec = sim_node_now_usec(node);
+
+    switch (timer)
+    {
+    case SIM_TIMER_BOOT:
+        break;
+    case SIM_TIMER_DISCOVERY_BEACON:
+    {
+        if (nan_can_send_discovery_beacon(state, now_usec))
+        {
+            nan_open_discovery_beacon_schedule(state, now_usec);
+            if (sim_transmit_beacon(sim, index, NAN_DISCOVERY_BEACON, now_usec))
+                nan_timer_set_last_discovery_beacon_usec(&state->timer, now_usec);
+        }
+        /* The daemon polls again immediately if the beacon was not sent, check once per interval instead */
+        uint64_t in_usec = nan_timer_next_discovery_beacon_usec(&state->timer, now_usec);
+        sim_schedule_timer(sim, index, SIM_TIMER_DISCOVERY_BEACON,
+                           in_usec > 0 ? in_usec : TU_TO_USEC(NAN_DISCOVERY_BEACON_INTERVAL_TU));
+        break;
+    }
+    case SIM_TIMER_DISCOVERY_WINDOW:
+        sim_discovery_window(sim, index, now_usec);
+        break;
+    case SIM_TIMER_DISCOVERY_WINDOW_END:
+        node->discovery_window_end_pending = false;
+        nan_master_election(&state->sync, &state->peers, now_usec);
+        nan_check_anchor_master_expiration(&state->sync);
+        break;
+    case SIM_TIMER_CLEAN_PEERS:
+        nan_peers_clean(&state->peers, now_usec);
+        sim_schedule_timer(sim, index, SIM_TIMER_CLEAN_PEERS, state->peers.clean_interval_usec);
+        break;
+    }
+}
+
+static void sim_handle_receive(struct sim *sim, unsigned int index, struct sim_frame *frame, signed char rssi)
+{
+    /* Radiotap header as a receiving interface would add it */
+    uint8_t *data = sim->rx_buffer;
+    uint32_t present = (1 << IEEE80211_RADIOTAP_FLAGS) | (1 << IEEE80211_RADIOTAP_DBM_ANTSIGNAL);
+    data[0] = 0;
+    data[1] = 0;
+    data[2] = 10;
+    data[3] = 0;
+    data[4] = present & 0xff;
+    data[5] = (present >> 8) & 0xff;
+    data[6] = (present >> 16) & 0xff;
+    data[7] = present >> 24;
+    data[8] = frame->fcs ? IEEE80211_RADIOTAP_F_FCS : 0;
+    data[9] = (uint8_t)rssi;
+    memcpy(data + 10, frame->data, frame->length);
+
+    struct buf buf = buf_view(data, 10 + frame->length);
+    if (nan_rx(&buf, &sim->nodes[index].state, 0) < RX_OK)
+        sim->stats.rx_errors++;
+    sim->stats.delivered++;
+
+    if (--frame->references == 0)
+        free(frame);
+}
+
+static int sim_count_distinct(const uint64_t *values, unsigned int count)
+{
+    int distinct = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        bool seen = false;
+        for (unsigned int j = 0; j < i && !seen; j++)
+            seen = values[j] == values[i];
+        if (!seen)
+            distinct++;
+    }
+    return distinct;
+}
+
+static uint64_t sim_cluster_id_value(const struct ether_addr *cluster_id)
+{
+    uint64_t value = 0;
+    memcpy(&value, cluster_id, sizeof(struct ether_addr));
+    return value;
+}
+
+/* Check once per DW whether all nodes agree on one cluster and anchor master */
+static void sim_sample(struct sim *sim, uint64_t *clusters, uint64_t *anchor_masters)
+{
+    unsigned int booted = 0;
+    for (unsigned int i = 0; i < sim->config.nodes; i++)
+    {
+        if (!sim->nodes[i].booted)
+            continue;
+        clusters[booted] = sim_cluster_id_value(&sim->nodes[i].state.cluster.cluster_id);
+        anchor_masters[booted] = sim->nodes[i].state.sync.anchor_master_rank;
+        booted++;
+    }
+
+    struct sim_stats *stats = &sim->stats;
+    stats->clusters = sim_count_distinct(clusters, booted);
+    stats->anchor_masters = sim_count_distinct(anchor_masters, booted);
+
+    bool converged = booted == sim->config.nodes && stats->clusters == 1 && stats->anchor_masters == 1;
+    if (converged && !stats->converged)
+        stats->converged_usec = sim->medium_clock.now_usec;
+    else if (!converged && stats->converged)
+        stats->splits++;
+    stats->converged = converged;
+
+    struct sim_event event = {
+        .time_usec = sim->medium_clock.now_usec + SIM_DW_INTERVAL_USEC,
+        .type = SIM_EVENT_SAMPLE,
+    };
+    sim_queue_push(&sim->queue, event);
+}
+
+static void sim_init(struct sim *sim, const struct sim_config *config)
+{
+    memset(sim, 0, sizeof(struct sim));
+    sim->config = *config;
+    sim->random = 0x9e3779b97f4a7c15ULL ^ config->seed;
+    srand(config->seed);
+
+    /* Start late enough that drifting clocks never underflow */
+    nan_virtual_clock_init(&sim->medium_clock, 3600 * 1000000ULL);
+    nan_clock_init_virtual(&sim->medium, &sim->medium_clock);
+
+    sim->nodes = calloc(config->nodes, sizeof(struct sim_node));
+    sim->rssi = malloc(config->nodes * config->nodes);
+
+    for (unsigned int i = 0; i < config->nodes; i++)
+    {
+        struct sim_node *node = &sim->nodes[i];
+        node->x = sim_random_uniform(sim) * config->area_meters;
+        node->y = sim_random_uniform(sim) * config->area_meters;
+
+        /* The monotonic clocks of the devices are not aligned */
+        int64_t offset_usec = (int64_t)(sim_random_uniform(sim) * 1000000);
+        double drift_ppm = (2 * sim_random_uniform(sim) - 1) * config->drift_ppm;
+        nan_drift_clock_init(&node->clock, &sim->medium, offset_usec, drift_ppm);
+
+        /* Devices power up at arbitrary times, their NAN time starts at zero when they do */
+        sim_schedule_timer(sim, i, SIM_TIMER_BOOT, (uint64_t)(sim_random_uniform(sim) * config->boot_spread_sec * 1e6));
+    }
+
+    for (unsigned int i = 0; i < config->nodes; i++)
+    {
+        for (unsigned int j = 0; j < config->nodes; j++)
+        {
+            double distance = hypot(sim->nodes[i].x - sim->nodes[j].x, sim->nodes[i].y - sim->nodes[j].y);
+            double rssi = SIM_RSSI_AT_1M - 10 * SIM_PATH_LOSS_EXPONENT * log10(distance > 1 ? distance : 1);
+            sim->rssi[i * config->nodes + j] = rssi < -127 ? -127 : (signed char)rssi;
+        }
+    }
+
+    struct sim_event sample = {
+        .time_usec = sim->medium_clock.now_usec + SIM_DW_INTERVAL_USEC,
+        .type = SIM_EVENT_SAMPLE,
+    };
+    sim_queue_push(&sim->queue, sample);
+}
+
+static void sim_free(struct sim *sim)
+{
+    while (sim->queue.length > 0)
+    {
+        struct sim_event event = sim_queue_pop(&sim->queue);
+        if (event.type == SIM_EVENT_RECEIVE && --event.frame->references == 0)
+            free(event.frame);
+    }
+    free(sim->queue.events);
+    for (unsigned int i = 0; i < sim->config.nodes; i++)
+        free_nan_state(&sim->nodes[i].state);
+    free(sim->nodes);
+    free(sim->rssi);
+}
+
+static void sim_run(struct sim *sim)
+{
+    uint64_t end_usec = sim->medium_clock.now_usec + (uint64_t)(sim->config.duration_sec * 1e6);
+    uint64_t *clusters = malloc(sim->config.nodes * sizeof(uint64_t));
+    uint64_t *anchor_masters = malloc(sim->config.nodes * sizeof(uint64_t));
+
+    while (sim->queue.length > 0 && sim->queue.events[0].time_usec <= end_usec)
+    {
+        struct sim_event event = sim_queue_pop(&sim->queue);
+        nan_virtual_clock_set(&sim->medium_clock, event.time_usec);
+
+        uint64_t start_nsec = bench_time_nsec();
+        switch (event.type)
+        {
+        case SIM_EVENT_TIMER:
+            sim_handle_timer(sim, event.node, event.timer);
+            break;
+        case SIM_EVENT_RECEIVE:
+            sim_handle_receive(sim, event.node, event.frame, event.rssi);
+            break;
+        case SIM_EVENT_SAMPLE:
+            sim_sample(sim, clusters, anchor_masters);
+            continue;
+        }
+        sim->nodes[event.node].cpu_nsec += bench_time_nsec() - start_nsec;
+    }
+
+    nan_virtual_clock_set(&sim->medium_clock, end_usec);
+    free(clusters);
+    free(anchor_masters);
+}
+
+static void sim_print_results(const struct sim *sim, uint64_t start_usec, uint64_t wall_nsec)
+{
+    const struct sim_config *config = &sim->config;
+    const struct sim_stats *stats = &sim->stats;
+    double dws = config->duration_sec * 1e6 / SIM_DW_INTERVAL_USEC;
+
+    uint64_t total_cpu_nsec = 0, max_cpu_nsec = 0;
+    int roles[3] = {0};
+    const struct nan_state *reference = NULL;
+    for (unsigned int i = 0; i < config->nodes; i++)
+    {
+        total_cpu_nsec += sim->nodes[i].cpu_nsec;
+        if (sim->nodes[i].cpu_nsec > max_cpu_nsec)
+            max_cpu_nsec = sim->nodes[i].cpu_nsec;
+        if (!sim->nodes[i].booted)
+            continue;
+        roles[sim->nodes[i].state.sync.role]++;
+        if (reference == NULL)
+            reference = &sim->nodes[i].state;
+    }
+
+    /* Spread of the synchronized time over all nodes in the same cluster as the first node */
+    uint64_t min_synced_usec = 0, max_synced_usec = 0;
+    for (unsigned int i = 0; i < config->nodes; i++)
+    {
+        const struct nan_state *state = &sim->nodes[i].state;
+        if (!sim->nodes[i].booted || !ether_addr_equal(&state->cluster.cluster_id, &reference->cluster.cluster_id))
+            continue;
+        uint64_t synced_usec = nan_timer_get_synced_time_usec(&state->timer, sim_node_now_usec(&sim->nodes[i]));
+        if (state == reference || synced_usec < min_synced_usec)
+            min_synced_usec = synced_usec;
+        if (state == reference || synced_usec > max_synced_usec)
+            max_synced_usec = synced_usec;
+    }
+
+    printf("%u nodes, %.1f s (%.0f DWs) simulated in %.3f s\n", config->nodes, config->duration_sec, dws,
+           wall_nsec / 1e9);
+    printf("Frames sent              %lu\n", stats->sent);
+    printf("Frames delivered         %lu\n", stats->delivered);
+    printf("Frames lost              %lu\n", stats->lost);
+    printf("Links out of range       %lu\n", stats->out_of_range);
+    printf("Unhandled frames         %lu\n", stats->rx_errors);
+    if (stats->converged)
+        printf("Convergence time         %.3f s\n", (stats->converged_usec - start_usec) / 1e6);
+    else
+        printf("Convergence time         not converged (see nan_cluster_compare_grade in README.md)\n");
+    printf("Cluster splits           %u\n", stats->splits);
+    printf("Clusters at end          %u\n", stats->clusters);
+    printf("Anchor masters at end    %u\n", stats->anchor_masters);
+    printf("Roles at end             %d master, %d sync, %d non-sync\n",
+           roles[MASTER], roles[SYNC], roles[NON_SYNC]);
+    printf("Synced time spread       %lu us\n", max_synced_usec - min_synced_usec);
+    printf("CPU per node and DW      %.1f us mean, %.1f us max\n",
+           total_cpu_nsec / 1e3 / config->nodes / dws, max_cpu_nsec / 1e3 / dws);
+}
+
+static void print_usage(const char *arg0)
+{
+    printf("Usage: %s [options]\n", arg0);
+    printf("\n");
+    printf("Options:\n");
+    printf(" -v                       Increase log level\n");
+    printf(" -n number                Number of nodes. Default is %d\n", SIM_DEFAULT_NODES);
+    printf(" -t seconds               Simulated time. Default is %d\n", SIM_DEFAULT_DURATION_SEC);
+    printf(" -a meters                Side length of the square the nodes are placed in. Default is %d\n",
+           SIM_DEFAULT_AREA_METERS);
+    printf(" -l probability           Probability that a frame is lost on a link. Default is 0\n");
+    printf(" -p usec                  Propagation delay. Default is %d\n", SIM_DEFAULT_DELAY_USEC);
+    printf(" -D ppm                   Maximum clock drift of a node. Default is %d\n", SIM_DEFAULT_DRIFT_PPM);
+    printf(" -b seconds               Nodes power up at random times within this period. Default is %d\n",
+           SIM_DEFAULT_BOOT_SPREAD_SEC);
+    printf(" -S                       Publish and subscribe a service on every node\n");
+    printf(" -s number                Random seed. Default is 1\n");
+}
+
+int main(int argc, char *argv[])
+{
+    log_set_level(LOG_ERR);
+
+    struct sim_config config = {
+        .nodes = SIM_DEFAULT_NODES,
+        .duration_sec = SIM_DEFAULT_DURATION_SEC,
+        .area_meters = SIM_DEFAULT_AREA_METERS,
+        .loss = 0,
+        .drift_ppm = SIM_DEFAULT_DRIFT_PPM,
+        .delay_usec = SIM_DEFAULT_DELAY_USEC,
+        .boot_spread_sec = SIM_DEFAULT_BOOT_SPREAD_SEC,
+        .services = false,
+        .seed = 1,
+    };
+
+    int c;
+    while ((c = getopt(argc, argv, "vn:t:a:l:p:D:b:Ss:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'v':
+            log_increase_level();
+            break;
+        case 'n':
+            config.nodes = atoi(optarg);
+            break;
+        case 't':
+            config.duration_sec = atof(optarg);
+            break;
+        case 'a':
+            config.area_meters = atof(optarg);
+            break;
+        case 'l':
+            config.loss = atof(optarg);
+            break;
+        case 'p':
+            config.delay_usec = atoi(optarg);
+            break;
+        case 'D':
+            config.drift_ppm = atof(optarg);
+            break;
+        case 'b':
+            config.boot_spread_sec = atof(optarg);
+            break;
+        case 'S':
+            config.services = true;
+            break;
+        case 's':
+            config.seed = atoi(optarg);
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (config.nodes < 2 || config.nodes > 0xffff)
+    {
+        fprintf(stderr, "Number of nodes must be between 2 and %d\n", 0xffff);
+        return EXIT_FAILURE;
+    }
+
+    struct sim sim;
+    sim_init(&sim, &config);
+    uint64_t start_usec = sim.medium_clock.now_usec;
+
+    uint64_t start_nsec = bench_time_nsec();
+    sim_run(&sim);
+    uint64_t wall_nsec = bench_time_nsec() - start_nsec;
+
+    sim_print_results(&sim, start_usec, wall_nsec);
+    sim_free(&sim);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct arena_chunk
+{
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+static size_t arena_align(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static struct arena_chunk *arena_chunk_new(size_t size)
+{
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + size);
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void arena_free_chunks(struct arena_chunk *chunk)
+{
+    while (chunk != NULL)
+    {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void arena_init(struct arena *arena, size_t chunk_size)
+{
+    arena->chunks = NULL;
+    arena->chunk_size = chunk_size > 0 ? arena_align(chunk_size) : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->used = 0;
+    arena->high_water = 0;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    size = arena_align(size > 0 ? size : 1);
+
+    struct arena_chunk *chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size)
+    {
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = arena_chunk_new(chunk_size);
+        if (chunk == NULL)
+            return NULL;
+
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *data = chunk->data + chunk->used;
+    chunk->used += size;
+
+    arena->used += size;
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+
+    return data;
+}
+
+void arena_reset(struct arena *arena)
+{
+    struct arena_chunk *chunk = arena->chunks;
+    arena->used = 0;
+
+    if (chunk == NULL)
+        return;
+
+    if (chunk->next == NULL)
+    {
+        chunk->used = 0;
+        return;
+    }
+
+    size_t size = 0;
+    for (struct arena_chunk *current = chunk; current != NULL; current = current->next)
+        size += current->size;
+
+    arena_free_chunks(chunk);
+    arena->chunks = arena_chunk_new(size);
+}
+
+void arena_free(struct arena *arena)
+{
+    arena_free_chunks(arena->chunks);
+    arena->chunks = NULL;
+    arena->used = 0;
+}
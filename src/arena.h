@@ -0,0 +1,68 @@
+#ifndef NAN_ARENA_H_
+#define NAN_ARENA_H_
+
+#include <stddef.h>
+
+/**
+ * Default size of a single arena chunk in bytes
+ */
+#define ARENA_DEFAULT_CHUNK_SIZE 4096
+
+/**
+ * Alignment of all allocations returned by the arena
+ */
+#define ARENA_ALIGNMENT (2 * sizeof(void *))
+
+struct arena_chunk;
+
+/**
+ * Bump allocator for short-lived allocations that are all released at once.
+ * Memory is taken from a list of chunks and only handed back to the system
+ * when the arena itself is freed.
+ */
+struct arena
+{
+    // Chunk that is currently allocated from
+    struct arena_chunk *chunks;
+    // Minimal size of newly allocated chunks
+    size_t chunk_size;
+    // Number of bytes handed out since the last reset
+    size_t used;
+    // Highest number of bytes handed out between two resets
+    size_t high_water;
+};
+
+/**
+ * Initialize an arena. Does not allocate until the first call to arena_alloc.
+ *
+ * @param arena - The arena to initialize
+ * @param chunk_size - Minimal size of a chunk in bytes, or 0 for the default size
+ */
+void arena_init(struct arena *arena, size_t chunk_size);
+
+/**
+ * Allocate memory from the arena. The memory stays valid until the next reset.
+ *
+ * @param arena - The arena to allocate from
+ * @param size - Number of bytes to allocate
+ * @returns Pointer to the allocated memory or NULL if a new chunk could not be allocated
+ */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/**
+ * Release all allocations at once. If the arena had to grow since the last reset,
+ * its chunks are merged into a single chunk, so that subsequent rounds of the same
+ * size are served without touching the heap.
+ *
+ * @param arena - The arena to reset
+ */
+void arena_reset(struct arena *arena);
+
+/**
+ * Free all memory held by the arena.
+ *
+ * @param arena - The arena to free
+ */
+void arena_free(struct arena *arena);
+
+#endif // NAN_ARENA_H_
@@ -0,0 +1,53 @@
+#ifndef NAN_BEACON_TEMPLATE_H_
+#define NAN_BEACON_TEMPLATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/ether.h>
+
+// Room for the radiotap header, the beacon and its attributes
+#define NAN_BEACON_TEMPLATE_MAX_LENGTH 256
+
+/**
+ * State a beacon template was built from. The template is rebuilt once any of it changes.
+ */
+struct nan_beacon_template_key
+{
+    struct ether_addr interface_address;
+    struct ether_addr cluster_id;
+    uint8_t master_preference;
+    uint8_t random_factor;
+    uint8_t hop_count;
+    bool fcs;
+    uint64_t anchor_master_rank;
+    uint32_t ambtt;
+};
+
+/**
+ * Complete beacon frame of which only the sequence number,
+ * the timestamp and the FCS change from one transmission to the next.
+ */
+struct nan_beacon_template
+{
+    uint8_t data[NAN_BEACON_TEMPLATE_MAX_LENGTH];
+    // Length of the frame including the FCS if present
+    size_t length;
+    // Offsets of the fields patched before each transmission
+    size_t seq_ctrl_offset;
+    size_t time_stamp_offset;
+    // Checksum of the bytes before the sequence control field
+    uint32_t prefix_crc;
+    bool valid;
+    struct nan_beacon_template_key key;
+};
+
+struct nan_beacon_templates
+{
+    struct nan_beacon_template sync;
+    struct nan_beacon_template discovery;
+    // Number of times a template had to be rebuilt
+    uint64_t rebuilds;
+};
+
+#endif // NAN_BEACON_TEMPLATE_H_
@@ -0,0 +1,69 @@
+#include "buf_pool.h"
+
+// Size and number of buffers allocated at once per class
+static const size_t buf_pool_class_sizes[BUF_POOL_CLASSES] = {256, 1024, 4096, BUF_MAX_LENGTH};
+static const size_t buf_pool_class_chunks[BUF_POOL_CLASSES] = {16, 16, 4, 1};
+
+// Buffer data follows its header within the same slab object
+static size_t buf_pool_header_size()
+{
+    return (sizeof(struct buf) + SLAB_ALIGNMENT - 1) & ~(SLAB_ALIGNMENT - 1);
+}
+
+void buf_pool_init(struct buf_pool *pool)
+{
+    for (int i = 0; i < BUF_POOL_CLASSES; i++)
+    {
+        struct buf_pool_class *class = &pool->classes[i];
+        class->size = buf_pool_class_sizes[i];
+        slab_init(&class->slab, buf_pool_header_size() + class->size, buf_pool_class_chunks[i], 0);
+    }
+    pool->oversized = 0;
+}
+
+struct buf *buf_pool_get(struct buf_pool *pool, size_t size)
+{
+    struct buf_pool_class *class = NULL;
+    for (int i = 0; i < BUF_POOL_CLASSES; i++)
+    {
+        if (size <= pool->classes[i].size)
+        {
+            class = &pool->classes[i];
+            break;
+        }
+    }
+
+    if (class == NULL)
+    {
+        pool->oversized++;
+        return NULL;
+    }
+
+    struct buf *buf = slab_alloc(&class->slab);
+    if (buf == NULL)
+        return NULL;
+
+    *buf = buf_view((uint8_t *)buf + buf_pool_header_size(), size);
+    buf->pool = class;
+    return buf;
+}
+
+void buf_pool_put(struct buf *buf)
+{
+    struct buf_pool_class *class = buf->pool;
+    slab_release(&class->slab, buf);
+}
+
+size_t buf_pool_in_use(const struct buf_pool *pool)
+{
+    size_t used = 0;
+    for (int i = 0; i < BUF_POOL_CLASSES; i++)
+        used += pool->classes[i].slab.used;
+    return used;
+}
+
+void buf_pool_free(struct buf_pool *pool)
+{
+    for (int i = 0; i < BUF_POOL_CLASSES; i++)
+        slab_free(&pool->classes[i].slab);
+}
@@ -0,0 +1,73 @@
+#ifndef NAN_BUF_POOL_H_
+#define NAN_BUF_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wire.h"
+#include "slab.h"
+
+#define BUF_POOL_CLASSES 4
+
+/**
+ * Buffers of a single size, each allocated together with its data
+ */
+struct buf_pool_class
+{
+    // Size of the data of each buffer in bytes
+    size_t size;
+    struct slab slab;
+};
+
+/**
+ * Pool of buffers for outgoing frames in a few size classes.
+ * Buffers are recycled when passed to buf_free, so that the allocator
+ * is only called until the pool has grown to the usual number of frames in flight.
+ */
+struct buf_pool
+{
+    // Ordered by ascending size, the last class holds buffers of BUF_MAX_LENGTH
+    struct buf_pool_class classes[BUF_POOL_CLASSES];
+    // Number of requests larger than the largest class
+    uint64_t oversized;
+};
+
+/**
+ * Initialize a buffer pool. Does not allocate until the first call to buf_pool_get.
+ *
+ * @param pool - The pool to initialize
+ */
+void buf_pool_init(struct buf_pool *pool);
+
+/**
+ * Take a buffer of the smallest class that fits the requested size.
+ * The buffer returns to the pool when passed to buf_free.
+ *
+ * @param pool - The pool to take the buffer from
+ * @param size - Minimum size of the buffer in bytes
+ * @returns The buffer of exactly the requested size or NULL if the size is too large
+ *          or the pool could not grow
+ */
+struct buf *buf_pool_get(struct buf_pool *pool, size_t size);
+
+/**
+ * Return a buffer taken from a pool. Called by buf_free for pooled buffers.
+ *
+ * @param buf - The buffer to return
+ */
+void buf_pool_put(struct buf *buf);
+
+/**
+ * @param pool - The pool
+ * @returns The number of buffers of all classes currently in use
+ */
+size_t buf_pool_in_use(const struct buf_pool *pool);
+
+/**
+ * Free all memory held by the pool, including buffers still in use.
+ *
+ * @param pool - The pool to free
+ */
+void buf_pool_free(struct buf_pool *pool);
+
+#endif // NAN_BUF_POOL_H_
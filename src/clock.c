@@ -0,0 +1,83 @@
+#include "clock.h"
+
+#include "utils.h"
+
+static uint64_t nan_clock_read_real(const void *data)
+{
+    (void)data;
+    return clock_time_usec();
+}
+
+static uint64_t nan_clock_read_virtual(const void *data)
+{
+    return ((const struct nan_virtual_clock *)data)->now_usec;
+}
+
+static uint64_t nan_clock_read_drift(const void *data)
+{
+    return nan_drift_clock_now_usec((const struct nan_drift_clock *)data);
+}
+
+void nan_clock_init_real(struct nan_clock *clock)
+{
+    clock->now = nan_clock_read_real;
+    clock->now_data = NULL;
+    clock->tsf = NULL;
+    clock->tsf_data = NULL;
+}
+
+void nan_clock_init_virtual(struct nan_clock *clock, const struct nan_virtual_clock *virtual_clock)
+{
+    clock->now = nan_clock_read_virtual;
+    clock->now_data = virtual_clock;
+    clock->tsf = NULL;
+    clock->tsf_data = NULL;
+}
+
+void nan_clock_init_drift(struct nan_clock *clock, const struct nan_drift_clock *drift_clock)
+{
+    clock->now = nan_clock_read_drift;
+    clock->now_data = drift_clock;
+    clock->tsf = NULL;
+    clock->tsf_data = NULL;
+}
+
+void nan_clock_set_tsf(struct nan_clock *clock, nan_clock_read tsf, const void *data)
+{
+    clock->tsf = tsf;
+    clock->tsf_data = tsf ? data : NULL;
+}
+
+void nan_virtual_clock_init(struct nan_virtual_clock *clock, uint64_t now_usec)
+{
+    clock->now_usec = now_usec;
+}
+
+void nan_virtual_clock_set(struct nan_virtual_clock *clock, uint64_t now_usec)
+{
+    if (now_usec > clock->now_usec)
+        clock->now_usec = now_usec;
+}
+
+void nan_virtual_clock_advance(struct nan_virtual_clock *clock, uint64_t delta_usec)
+{
+    clock->now_usec += delta_usec;
+}
+
+void nan_drift_clock_init(struct nan_drift_clock *clock, const struct nan_clock *base,
+                          int64_t offset_usec, double drift_ppm)
+{
+    clock->base = base;
+    clock->reference_usec = nan_clock_now_usec(base);
+    clock->offset_usec = offset_usec;
+    clock->drift_ppm = drift_ppm;
+}
+
+uint64_t nan_drift_clock_now_usec(const struct nan_drift_clock *clock)
+{
+    uint64_t base_usec = nan_clock_now_usec(clock->base);
+    int64_t elapsed_usec = (int64_t)(base_usec - clock->reference_usec);
+    int64_t drift_usec = (int64_t)((double)elapsed_usec * clock->drift_ppm / 1e6);
+
+    return base_usec + clock->offset_usec + drift_usec;
+}
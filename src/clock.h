@@ -0,0 +1,149 @@
+#ifndef NAN_CLOCK_H_
+#define NAN_CLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Returns the current time of a clock in microseconds
+ */
+typedef uint64_t (*nan_clock_read)(const void *data);
+
+/**
+ * Source of the current time used by the NAN state.
+ * The host clock is used by default, harnesses may inject a virtual clock
+ * to run faster than real time or a drifting clock to emulate imperfect oscillators.
+ */
+struct nan_clock
+{
+    // Monotonic time in microseconds
+    nan_clock_read now;
+    const void *now_data;
+    // Optional TSF of the wireless interface in microseconds, NULL if not available
+    nan_clock_read tsf;
+    const void *tsf_data;
+};
+
+/**
+ * Clock that only advances when told to
+ */
+struct nan_virtual_clock
+{
+    uint64_t now_usec;
+};
+
+/**
+ * Clock running with a constant offset and drift relative to a base clock
+ */
+struct nan_drift_clock
+{
+    const struct nan_clock *base;
+    // Time of the base clock at which the drift starts to accumulate
+    uint64_t reference_usec;
+    int64_t offset_usec;
+    // Drift in parts per million, positive values run fast
+    double drift_ppm;
+};
+
+/**
+ * Initialize a clock that reads the monotonic host clock, without TSF.
+ *
+ * @param clock - The clock to initialize
+ */
+void nan_clock_init_real(struct nan_clock *clock);
+
+/**
+ * Initialize a clock that reads a virtual clock, without TSF.
+ *
+ * @param clock - The clock to initialize
+ * @param virtual_clock - The virtual clock to read, must outlive the clock
+ */
+void nan_clock_init_virtual(struct nan_clock *clock, const struct nan_virtual_clock *virtual_clock);
+
+/**
+ * Initialize a clock that reads a drifting clock, without TSF.
+ *
+ * @param clock - The clock to initialize
+ * @param drift_clock - The drifting clock to read, must outlive the clock
+ */
+void nan_clock_init_drift(struct nan_clock *clock, const struct nan_drift_clock *drift_clock);
+
+/**
+ * Attach a TSF source to a clock.
+ *
+ * @param clock - The clock
+ * @param tsf - Returns the current TSF in microseconds, NULL to remove the source
+ * @param data - Passed to tsf
+ */
+void nan_clock_set_tsf(struct nan_clock *clock, nan_clock_read tsf, const void *data);
+
+/**
+ * @param clock - The clock
+ * @returns The current time of the clock in microseconds
+ */
+static inline uint64_t nan_clock_now_usec(const struct nan_clock *clock)
+{
+    return clock->now(clock->now_data);
+}
+
+/**
+ * @param clock - The clock
+ * @returns Whether the clock provides a TSF
+ */
+static inline bool nan_clock_has_tsf(const struct nan_clock *clock)
+{
+    return clock->tsf != NULL;
+}
+
+/**
+ * @param clock - The clock
+ * @returns The current TSF in microseconds or 0 if the clock provides no TSF
+ */
+static inline uint64_t nan_clock_tsf_usec(const struct nan_clock *clock)
+{
+    return clock->tsf ? clock->tsf(clock->tsf_data) : 0;
+}
+
+/**
+ * Initialize a virtual clock.
+ *
+ * @param clock - The virtual clock to initialize
+ * @param now_usec - The initial time in microseconds
+ */
+void nan_virtual_clock_init(struct nan_virtual_clock *clock, uint64_t now_usec);
+
+/**
+ * Set the time of a virtual clock. The clock never goes backwards.
+ *
+ * @param clock - The virtual clock
+ * @param now_usec - The new time in microseconds
+ */
+void nan_virtual_clock_set(struct nan_virtual_clock *clock, uint64_t now_usec);
+
+/**
+ * Advance a virtual clock.
+ *
+ * @param clock - The virtual clock
+ * @param delta_usec - The time to advance in microseconds
+ */
+void nan_virtual_clock_advance(struct nan_virtual_clock *clock, uint64_t delta_usec);
+
+/**
+ * Initialize a drifting clock. It starts at the current time of the base clock plus the offset.
+ *
+ * @param clock - The drifting clock to initialize
+ * @param base - The clock to drift from, must outlive the drifting clock
+ * @param offset_usec - Constant offset to the base clock in microseconds
+ * @param drift_ppm - Drift in parts per million
+ */
+void nan_drift_clock_init(struct nan_drift_clock *clock, const struct nan_clock *base,
+                          int64_t offset_usec, double drift_ppm);
+
+/**
+ * @param clock - The drifting clock
+ * @returns The current time of the drifting clock in microseconds
+ */
+uint64_t nan_drift_clock_now_usec(const struct nan_drift_clock *clock);
+
+#endif // NAN_CLOCK_H_
@@ -2,6 +2,19 @@
 #define CRC32_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+enum crc32_implementation
+{
+    // Byte at a time with a single table
+    CRC32_IMPL_TABLE,
+    // Eight bytes at a time with eight tables
+    CRC32_IMPL_SLICE_BY_8,
+    // Folding with carry-less multiplication, x86 only
+    CRC32_IMPL_PCLMUL,
+    // CRC32 instructions, ARMv8 on Linux only
+    CRC32_IMPL_ARMV8,
+};
 
 /**
  * @brief Calculates a crc32 checksum for the given buffer
@@ -13,4 +26,45 @@
  * */
 uint32_t crc32(const void *buf, unsigned long size);
 
+/**
+ * @brief Continues a crc32 checksum with the given buffer,
+ * so that crc32_update(crc32(a), b) equals the checksum of a followed by b
+ *
+ * @param crc: the checksum of the preceding data, 0 for none
+ * @param buf: the buffer to add to the checksum
+ * @param size: the size of the given buffer
+ *
+ * @return the checksum of the preceding data followed by the given buffer
+ * */
+uint32_t crc32_update(uint32_t crc, const void *buf, unsigned long size);
+
+/**
+ * @brief Checks whether an implementation can be used on this build and CPU
+ *
+ * @param implementation: the implementation to check
+ *
+ * @return whether the implementation is supported
+ * */
+bool crc32_implementation_supported(enum crc32_implementation implementation);
+
+/**
+ * @brief Selects the implementation used by crc32 and crc32_update.
+ * By default, the fastest implementation supported by the CPU is selected on first use.
+ *
+ * @param implementation: the implementation to use
+ *
+ * @return 0 on success, -1 if the implementation is not supported
+ * */
+int crc32_set_implementation(enum crc32_implementation implementation);
+
+/**
+ * @return the implementation used by crc32 and crc32_update
+ * */
+enum crc32_implementation crc32_get_implementation();
+
+/**
+ * @return the name of the implementation
+ * */
+const char *crc32_implementation_to_string(enum crc32_implementation implementation);
+
 #endif /* CRC32_H_ */
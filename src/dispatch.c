@@ -0,0 +1,42 @@
+#include "dispatch.h"
+
+#include <string.h>
+
+#include "attributes.h"
+#include "log.h"
+#include "rx.h"
+
+void nan_attribute_dispatch_init(struct nan_attribute_dispatch *dispatch)
+{
+    memset(dispatch, 0, sizeof(struct nan_attribute_dispatch));
+}
+
+void nan_register_attribute_handler(struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                                    uint8_t attribute_id, nan_parse_attribute parse)
+{
+    struct nan_attribute_handler *handler = &dispatch->handlers[kind][attribute_id];
+    handler->parse = parse;
+    handler->flags &= ~NAN_ATTRIBUTE_SKIP;
+}
+
+void nan_skip_attribute(struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                        uint8_t attribute_id)
+{
+    struct nan_attribute_handler *handler = &dispatch->handlers[kind][attribute_id];
+    handler->parse = NULL;
+    handler->flags |= NAN_ATTRIBUTE_SKIP;
+}
+
+int nan_dispatch_attribute(const struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                           uint8_t attribute_id, struct buf *attribute, void *data)
+{
+    const struct nan_attribute_handler *handler = &dispatch->handlers[kind][attribute_id];
+
+    if (handler->parse)
+        return handler->parse(attribute, data);
+
+    if (!(handler->flags & NAN_ATTRIBUTE_SKIP))
+        log_trace("Unhandled attribute: %s", nan_attribute_type_as_string(attribute_id));
+
+    return RX_IGNORE;
+}
@@ -0,0 +1,90 @@
+#ifndef NAN_DISPATCH_H_
+#define NAN_DISPATCH_H_
+
+#include <stdint.h>
+
+#include "wire.h"
+
+#define NAN_ATTRIBUTE_ID_COUNT 256
+
+/**
+ * Frame types that carry NAN attributes. Each has its own set of attribute handlers.
+ */
+enum nan_frame_kind
+{
+    NAN_FRAME_BEACON,
+    NAN_FRAME_SERVICE_DISCOVERY,
+    NAN_FRAME_ACTION,
+    NAN_FRAME_KIND_COUNT,
+};
+
+/**
+ * Skip the attribute silently, i.e. without logging it as unhandled
+ */
+#define NAN_ATTRIBUTE_SKIP 0x01
+
+/**
+ * Parser for the data of a single attribute.
+ *
+ * @param frame - Buffer view on the attribute's data
+ * @param data - Frame type specific context passed to nan_dispatch_attribute
+ * @returns A RX_RESULT, negative values abort the processing of the frame
+ */
+typedef int (*nan_parse_attribute)(struct buf *frame, void *data);
+
+struct nan_attribute_handler
+{
+    nan_parse_attribute parse;
+    uint8_t flags;
+};
+
+/**
+ * Attribute handlers for all frame types, indexed by attribute id
+ */
+struct nan_attribute_dispatch
+{
+    struct nan_attribute_handler handlers[NAN_FRAME_KIND_COUNT][NAN_ATTRIBUTE_ID_COUNT];
+};
+
+/**
+ * Initialize a dispatch table without any handlers.
+ *
+ * @param dispatch - The dispatch table to initialize
+ */
+void nan_attribute_dispatch_init(struct nan_attribute_dispatch *dispatch);
+
+/**
+ * Register a parser for an attribute of a frame type, replacing the current one.
+ *
+ * @param dispatch - The dispatch table
+ * @param kind - The frame type the attribute is received in
+ * @param attribute_id - The attribute id
+ * @param parse - The parser to call for the attribute
+ */
+void nan_register_attribute_handler(struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                                    uint8_t attribute_id, nan_parse_attribute parse);
+
+/**
+ * Mark an attribute of a frame type to be skipped without parsing or logging.
+ *
+ * @param dispatch - The dispatch table
+ * @param kind - The frame type the attribute is received in
+ * @param attribute_id - The attribute id
+ */
+void nan_skip_attribute(struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                        uint8_t attribute_id);
+
+/**
+ * Pass an attribute to its registered parser.
+ *
+ * @param dispatch - The dispatch table
+ * @param kind - The frame type the attribute was received in
+ * @param attribute_id - The attribute id
+ * @param attribute - Buffer view on the attribute's data
+ * @param data - Context passed to the parser
+ * @returns The result of the parser or RX_IGNORE if no parser is registered
+ */
+int nan_dispatch_attribute(const struct nan_attribute_dispatch *dispatch, enum nan_frame_kind kind,
+                           uint8_t attribute_id, struct buf *attribute, void *data);
+
+#endif // NAN_DISPATCH_H_
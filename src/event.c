@@ -21,6 +21,13 @@ void nan_event_state_init(struct nan_event_state *state)
     state->listeners = list_init();
 }
 
+void nan_event_state_free(struct nan_event_state *state)
+{
+    struct nan_event_listeners_item *item;
+    LIST_FOR_EACH(state->listeners, item, free(item->service_name));
+    list_free(state->listeners, true);
+}
+
 void nan_add_event_listener(struct nan_event_state *state,
                             const enum nan_event_type event, const char *service_name,
                             const nan_event_listener_t listener, void *additional_data)
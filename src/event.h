@@ -132,6 +132,13 @@ struct nan_event_state
 
 void nan_event_state_init(struct nan_event_state *state);
 
+/**
+ * Remove and free all event listeners.
+ *
+ * @param state - The event state to free
+ */
+void nan_event_state_free(struct nan_event_state *state);
+
 /**
  * 
  * @param state - The current event state
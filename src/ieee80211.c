@@ -1,6 +1,8 @@
 #include "ieee80211.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <radiotap.h>
 #include <radiotap_iter.h>
@@ -13,6 +15,12 @@ void ieee80211_init_state(struct ieee80211_state *state)
 {
     state->sequence_number = 0;
     state->fcs = true;
+    ieee80211_radiotap_cache_init(&state->radiotap_cache);
+}
+
+void ieee80211_radiotap_cache_init(struct ieee80211_radiotap_cache *cache)
+{
+    memset(cache, 0, sizeof(struct ieee80211_radiotap_cache));
 }
 
 unsigned int ieee80211_state_next_sequence_number(struct ieee80211_state *state)
@@ -35,9 +43,9 @@ void ieee80211_add_nan_header(struct buf *buf, const struct ether_addr *src, con
     buf_advance(buf, sizeof(struct ieee80211_hdr));
 }
 
-inline static int ieee80211_radiotap_type_to_mask(int type)
+inline static uint32_t ieee80211_radiotap_type_to_mask(int type)
 {
-    return 1 << type;
+    return 1u << type;
 }
 
 void ieee80211_add_radiotap_header(struct buf *buf, const struct ieee80211_state *state)
@@ -63,7 +71,7 @@ void ieee80211_add_radiotap_header(struct buf *buf, const struct ieee80211_state
     }
 
     present |= ieee80211_radiotap_type_to_mask(IEEE80211_RADIOTAP_RATE);
-    length += write_u8(buf, 2);
+    length += write_u8(buf, IEEE80211_TX_RATE);
 
     present |= ieee80211_radiotap_type_to_mask(IEEE80211_RADIOTAP_DBM_ANTSIGNAL);
     length += write_u8(buf, 200);
@@ -119,6 +127,181 @@ int ieee80211_parse_radiotap_header(struct buf *frame, signed char *rssi, uint8_
     return RX_OK;
 }
 
+/*
+ * Alignment and size of the fields in the radiotap namespace, as defined by the radiotap library
+ * https://www.radiotap.org/fields/defined
+ * Fields the library does not know either (e.g. XChannel) are left out, so these layouts go to the iterator.
+ */
+static const struct
+{
+    uint8_t align;
+    uint8_t size;
+} ieee80211_radiotap_fields[] = {
+    [IEEE80211_RADIOTAP_TSFT] = {8, 8},
+    [IEEE80211_RADIOTAP_FLAGS] = {1, 1},
+    [IEEE80211_RADIOTAP_RATE] = {1, 1},
+    [IEEE80211_RADIOTAP_CHANNEL] = {2, 4},
+    [IEEE80211_RADIOTAP_FHSS] = {2, 2},
+    [IEEE80211_RADIOTAP_DBM_ANTSIGNAL] = {1, 1},
+    [IEEE80211_RADIOTAP_DBM_ANTNOISE] = {1, 1},
+    [IEEE80211_RADIOTAP_LOCK_QUALITY] = {2, 2},
+    [IEEE80211_RADIOTAP_TX_ATTENUATION] = {2, 2},
+    [IEEE80211_RADIOTAP_DB_TX_ATTENUATION] = {2, 2},
+    [IEEE80211_RADIOTAP_DBM_TX_POWER] = {1, 1},
+    [IEEE80211_RADIOTAP_ANTENNA] = {1, 1},
+    [IEEE80211_RADIOTAP_DB_ANTSIGNAL] = {1, 1},
+    [IEEE80211_RADIOTAP_DB_ANTNOISE] = {1, 1},
+    [IEEE80211_RADIOTAP_RX_FLAGS] = {2, 2},
+    [IEEE80211_RADIOTAP_TX_FLAGS] = {2, 2},
+    [IEEE80211_RADIOTAP_RTS_RETRIES] = {1, 1},
+    [IEEE80211_RADIOTAP_DATA_RETRIES] = {1, 1},
+    [IEEE80211_RADIOTAP_MCS] = {1, 3},
+    [IEEE80211_RADIOTAP_AMPDU_STATUS] = {4, 8},
+    [IEEE80211_RADIOTAP_VHT] = {2, 12},
+    [IEEE80211_RADIOTAP_TIMESTAMP] = {8, 12},
+};
+
+#define IEEE80211_RADIOTAP_FIELD_COUNT (int)(sizeof(ieee80211_radiotap_fields) / sizeof(ieee80211_radiotap_fields[0]))
+
+/*
+ * Compute the offsets of the needed fields for the given present words.
+ * Returns false if the layout cannot be cached and has to be passed to the iterator.
+ */
+static bool ieee80211_radiotap_layout_compute(struct ieee80211_radiotap_layout *layout,
+                                              const uint32_t *present, int present_words)
+{
+    unsigned int offset = sizeof(struct ieee80211_radiotap_header) + (present_words - 1) * sizeof(uint32_t);
+
+    memset(layout, 0, sizeof(struct ieee80211_radiotap_layout));
+    memcpy(layout->present, present, present_words * sizeof(uint32_t));
+    layout->present_words = present_words;
+
+    for (int word = 0; word < present_words; word++)
+    {
+        if (present[word] & ieee80211_radiotap_type_to_mask(IEEE80211_RADIOTAP_VENDOR_NAMESPACE))
+            return false;
+        /* only a word following a radiotap namespace switch starts again at field 0, otherwise it holds fields 32 and up */
+        if (word > 0 && !(present[word - 1] & ieee80211_radiotap_type_to_mask(IEEE80211_RADIOTAP_RADIOTAP_NAMESPACE)))
+            return false;
+
+        for (int type = 0; type < IEEE80211_RADIOTAP_RADIOTAP_NAMESPACE; type++)
+        {
+            if (!(present[word] & ieee80211_radiotap_type_to_mask(type)))
+                continue;
+            if (type >= IEEE80211_RADIOTAP_FIELD_COUNT || ieee80211_radiotap_fields[type].align == 0)
+                return false;
+
+            unsigned int align = ieee80211_radiotap_fields[type].align;
+            offset = (offset + align - 1) & ~(align - 1);
+
+            /* later occurrences in extended bitmaps override earlier ones like with the iterator */
+            if (type == IEEE80211_RADIOTAP_TSFT)
+                layout->tsft = offset;
+            else if (type == IEEE80211_RADIOTAP_FLAGS)
+                layout->flags = offset;
+            else if (type == IEEE80211_RADIOTAP_DBM_ANTSIGNAL)
+                layout->antsignal = offset;
+
+            offset += ieee80211_radiotap_fields[type].size;
+        }
+    }
+
+    if (offset > UINT16_MAX)
+        return false;
+
+    layout->end = offset;
+    return true;
+}
+
+static const struct ieee80211_radiotap_layout *
+ieee80211_radiotap_cache_lookup(struct ieee80211_radiotap_cache *cache, const uint32_t *present, int present_words)
+{
+    for (unsigned int i = 0; i < cache->count; i++)
+    {
+        const struct ieee80211_radiotap_layout *layout = &cache->layouts[i];
+        if (layout->present_words == present_words &&
+            memcmp(layout->present, present, present_words * sizeof(uint32_t)) == 0)
+            return layout;
+    }
+    return NULL;
+}
+
+int ieee80211_parse_radiotap_header_cached(struct ieee80211_radiotap_cache *cache, struct buf *frame,
+                                           signed char *rssi, uint8_t *flags, uint64_t *tsft)
+{
+    if (buf_rest(frame) < (int)sizeof(struct ieee80211_radiotap_header))
+        return RX_UNEXPECTED_FORMAT;
+
+    const uint8_t *data = buf_current(frame);
+    const struct ieee80211_radiotap_header *header = (const struct ieee80211_radiotap_header *)data;
+    uint16_t length = le16toh(header->it_len);
+
+    if (header->it_version != 0 || length > buf_rest(frame))
+        return RX_UNEXPECTED_FORMAT;
+
+    uint32_t present[IEEE80211_RADIOTAP_MAX_PRESENT_WORDS];
+    int present_words = 0;
+    const uint8_t *next_present = data + offsetof(struct ieee80211_radiotap_header, it_present);
+    do
+    {
+        if (present_words == IEEE80211_RADIOTAP_MAX_PRESENT_WORDS)
+        {
+            cache->fallbacks++;
+            return ieee80211_parse_radiotap_header(frame, rssi, flags, tsft);
+        }
+        if (next_present + sizeof(uint32_t) - data > length)
+            return RX_UNEXPECTED_FORMAT;
+
+        /* The frame is not necessarily aligned in the capture buffer */
+        uint32_t word;
+        memcpy(&word, next_present, sizeof(word));
+        next_present += sizeof(word);
+        present[present_words] = le32toh(word);
+    } while (present[present_words++] & ieee80211_radiotap_type_to_mask(IEEE80211_RADIOTAP_EXT));
+
+    const struct ieee80211_radiotap_layout *layout = ieee80211_radiotap_cache_lookup(cache, present, present_words);
+    if (layout)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        /* Only replace a cached layout once the new one is known to be usable */
+        struct ieee80211_radiotap_layout new_layout;
+        if (!ieee80211_radiotap_layout_compute(&new_layout, present, present_words))
+        {
+            cache->fallbacks++;
+            return ieee80211_parse_radiotap_header(frame, rssi, flags, tsft);
+        }
+
+        cache->misses++;
+        cache->layouts[cache->next] = new_layout;
+        layout = &cache->layouts[cache->next];
+        cache->next = (cache->next + 1) % IEEE80211_RADIOTAP_CACHE_SIZE;
+        if (cache->count < IEEE80211_RADIOTAP_CACHE_SIZE)
+            cache->count++;
+    }
+
+    if (layout->end > length)
+        return RX_UNEXPECTED_FORMAT;
+
+    if (tsft && layout->tsft)
+    {
+        uint64_t value;
+        memcpy(&value, data + layout->tsft, sizeof(value));
+        *tsft = le64toh(value);
+    }
+    if (flags && layout->flags)
+        *flags = data[layout->flags];
+    if (rssi && layout->antsignal)
+        *rssi = (signed char)data[layout->antsignal];
+
+    if (buf_advance(frame, length) < 0)
+        return RX_TOO_SHORT;
+
+    return RX_OK;
+}
+
 int ieee80211_parse_fcs(struct buf *frame, const uint8_t radiotap_flags)
 {
     if (radiotap_flags & IEEE80211_RADIOTAP_F_BADFCS)
@@ -20,6 +20,9 @@ struct oui
 
 #define FCS_LEN 4
 
+/* Data rate of injected frames in units of 500 kbps, written to the radiotap header */
+#define IEEE80211_TX_RATE 2
+
 #define IEEE80211_FCTL_VERS 0x0003
 #define IEEE80211_FCTL_FTYPE 0x000c
 #define IEEE80211_FCTL_STYPE 0x00f0
@@ -149,15 +152,53 @@ struct ieee80211_hdr
     uint16_t seq_ctrl;
 } __attribute__((__packed__));
 
+#define IEEE80211_RADIOTAP_CACHE_SIZE 8
+#define IEEE80211_RADIOTAP_MAX_PRESENT_WORDS 4
+
+/*
+ * Offsets of the radiotap fields needed on reception for one present bitmap layout.
+ * Offsets are relative to the start of the radiotap header, 0 if the field is absent.
+ */
+struct ieee80211_radiotap_layout
+{
+    uint32_t present[IEEE80211_RADIOTAP_MAX_PRESENT_WORDS];
+    uint8_t present_words;
+    uint16_t tsft;
+    uint16_t flags;
+    uint16_t antsignal;
+    /* end of the last field, must not exceed the header length */
+    uint16_t end;
+};
+
+/*
+ * Cache of radiotap layouts, as a driver emits the same present bitmaps on every frame
+ */
+struct ieee80211_radiotap_cache
+{
+    struct ieee80211_radiotap_layout layouts[IEEE80211_RADIOTAP_CACHE_SIZE];
+    unsigned int count;
+    unsigned int next;
+    /* number of headers decoded from a cached layout */
+    uint64_t hits;
+    /* number of headers that added a new layout */
+    uint64_t misses;
+    /* number of headers that had to be decoded by the radiotap iterator */
+    uint64_t fallbacks;
+};
+
 struct ieee80211_state
 {
     /* IEEE 802.11 sequence number */
     uint16_t sequence_number;
     /* whether we need to add an fcs */
     bool fcs;
+    /* layouts of received radiotap headers */
+    struct ieee80211_radiotap_cache radiotap_cache;
 };
 
 void ieee80211_init_state(struct ieee80211_state *state);
+void ieee80211_radiotap_cache_init(struct ieee80211_radiotap_cache *cache);
+unsigned int ieee80211_state_next_sequence_number(struct ieee80211_state *state);
 
 int ieee80211_channel_to_frequency(int chan);
 int ieee80211_frequency_to_channel(int freq);
@@ -168,6 +209,13 @@ void ieee80211_add_nan_header(struct buf *buf, const struct ether_addr *src, con
 void ieee80211_add_radiotap_header(struct buf *buf, const struct ieee80211_state *state);
 int ieee80211_parse_radiotap_header(struct buf *frame, signed char *rssi, uint8_t *flags, uint64_t *tsft);
 
+/*
+ * Same as ieee80211_parse_radiotap_header, but reads the fields at offsets cached per present bitmap.
+ * Layouts with vendor namespaces, unknown fields or too many present words are passed to the iterator.
+ */
+int ieee80211_parse_radiotap_header_cached(struct ieee80211_radiotap_cache *cache, struct buf *frame,
+                                           signed char *rssi, uint8_t *flags, uint64_t *tsft);
+
 void ieee80211_add_fcs(struct buf *buf);
 int ieee80211_parse_fcs(struct buf *frame, const uint8_t radiotap_flags);
 
@@ -2,34 +2,44 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
 #include "log.h"
 
 struct list_entry
 {
     any_t data;
     struct list_entry *next;
+    struct arena *arena;
 };
 
-struct list_it
+struct list_entry *list_entry_new(any_t item, struct arena *arena)
 {
-    struct list_entry *current;
-};
+    struct list_entry *entry = arena ? arena_alloc(arena, sizeof(struct list_entry))
+                                     : malloc(sizeof(struct list_entry));
+    if (entry == NULL)
+        return NULL;
 
-struct list_entry *list_entry_new(any_t item)
-{
-    struct list_entry *entry = malloc(sizeof(struct list_entry));
     entry->data = item;
     entry->next = NULL;
+    entry->arena = arena;
     return entry;
 };
 
 list_t list_init()
 {
-    return (list_t)list_entry_new(NULL);
+    return (list_t)list_entry_new(NULL, NULL);
+};
+
+list_t list_init_arena(struct arena *arena)
+{
+    return (list_t)list_entry_new(NULL, arena);
 };
 
 void list_free(list_t list, bool free_data)
 {
+    if (list->arena)
+        return;
+
     struct list_entry *current = list->next;
     while (current != NULL)
     {
@@ -66,7 +76,10 @@ enum list_status list_add(list_t list, any_t item)
         current = current->next;
     }
 
-    current->next = list_entry_new(item);
+    current->next = list_entry_new(item, list->arena);
+    if (current->next == NULL)
+        return LIST_OMEM;
+
     return LIST_OK;
 };
 
@@ -80,7 +93,8 @@ enum list_status list_remove(list_t list, any_t item)
         if (current->data == item)
         {
             last->next = current->next;
-            free(current);
+            if (!current->arena)
+                free(current);
             return LIST_OK;
         }
 
@@ -99,6 +113,11 @@ list_it_t list_it_new(list_t list)
     return it;
 };
 
+void list_it_init(list_it_t it, list_t list)
+{
+    it->current = list->next;
+};
+
 enum list_status list_it_next(list_it_t it, any_t *item)
 {
     if (it->current == NULL)
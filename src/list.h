@@ -8,6 +8,8 @@
  */
 typedef void *any_t;
 
+struct arena;
+
 /**
  * Opaque list implementation
  */
@@ -15,9 +17,12 @@ struct list_entry;
 typedef struct list_entry *list_t;
 
 /**
- * Opaque iterator implementation
+ * Iterator implementation, public so that iterators can live on the stack
  */
-struct list_it;
+struct list_it
+{
+    struct list_entry *current;
+};
 typedef struct list_it *list_it_t;
 
 enum list_status
@@ -31,6 +36,13 @@ typedef bool (*list_item_matches)(any_t item, any_t value);
 
 list_t list_init();
 
+/**
+ * Create a list whose entries are allocated from the given arena.
+ * The list is released together with the arena, list_free and list_remove
+ * do not free any memory of such a list.
+ */
+list_t list_init_arena(struct arena *arena);
+
 void list_free(list_t list, bool free_data);
 
 unsigned int list_len(list_t list);
@@ -41,33 +53,35 @@ enum list_status list_remove(list_t list, any_t item);
 
 list_it_t list_it_new(list_t list);
 
+void list_it_init(list_it_t it, list_t list);
+
 enum list_status list_it_next(list_it_t it, any_t *item);
 
 void list_it_free(list_it_t it);
 
-#define LIST_FOR_EACH(list, item_ptr, func)                     \
-    do                                                          \
-    {                                                           \
-        list_it_t it = list_it_new(list);                       \
-        while (list_it_next(it, (any_t *)&item_ptr) == LIST_OK) \
-        {                                                       \
-            func;                                               \
-        }                                                       \
-        list_it_free(it);                                       \
+#define LIST_FOR_EACH(list, item_ptr, func)                      \
+    do                                                           \
+    {                                                            \
+        struct list_it it;                                       \
+        list_it_init(&it, list);                                 \
+        while (list_it_next(&it, (any_t *)&item_ptr) == LIST_OK) \
+        {                                                        \
+            func;                                                \
+        }                                                        \
     } while (0);
 
-#define LIST_FILTER_FOR_EACH(list, item_ptr, condition, func)   \
-    do                                                          \
-    {                                                           \
-        list_it_t it = list_it_new(list);                       \
-        while (list_it_next(it, (any_t *)&item_ptr) == LIST_OK) \
-        {                                                       \
-            if (condition)                                      \
-            {                                                   \
-                func;                                           \
-            }                                                   \
-        }                                                       \
-        list_it_free(it);                                       \
+#define LIST_FILTER_FOR_EACH(list, item_ptr, condition, func)    \
+    do                                                           \
+    {                                                            \
+        struct list_it it;                                       \
+        list_it_init(&it, list);                                 \
+        while (list_it_next(&it, (any_t *)&item_ptr) == LIST_OK) \
+        {                                                        \
+            if (condition)                                       \
+            {                                                    \
+                func;                                            \
+            }                                                    \
+        }                                                        \
     } while (0);
 
 #define LIST_FIND(list, item_ptr, condition) \
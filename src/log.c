@@ -106,7 +106,9 @@ int log_log(int level, const char *file, int line, const char *fmt, ...)
         return 0;
     }
 
-    char *striped_file = (char *)(strstr(file, "nan-linux") + strlen("nan-linux"));
+    /* Print paths relative to the project, if built from a checkout named as the project */
+    const char *striped_file = strstr(file, "nan-linux");
+    striped_file = striped_file ? striped_file + strlen("nan-linux") : file;
 
     /* Acquire lock */
     lock();
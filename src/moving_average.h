@@ -19,6 +19,17 @@ typedef struct moving_average_state
         state.buffer_size = size;                       \
     } while (0)
 
+/* Same as moving_average_init, but uses the given buffer of at least size values */
+#define moving_average_init_buffer(state, average, values, size) \
+    do                                                           \
+    {                                                            \
+        average = 0;                                             \
+        state.buffer = values;                                   \
+        state.position = 0;                                      \
+        state.buffer_full = false;                               \
+        state.buffer_size = size;                                \
+    } while (0)
+
 #define moving_average_add(state, average, type, value)                            \
     do                                                                             \
     {                                                                              \
@@ -1,13 +1,413 @@
 #include "peer.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils.h"
+#include "ieee80211.h"
 #include "log.h"
+#include "sync.h"
+
+static size_t nan_peer_table_hash(const struct ether_addr *addr)
+{
+    uint64_t key = 0;
+    memcpy(&key, addr, ETH_ALEN);
+
+    // Multiplicative hashing, addresses of one vendor only differ in the last bytes
+    return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/**
+ * Find the slot of the peer with the given address or the empty slot it would be inserted at.
+ */
+static size_t nan_peer_table_find_slot(const struct nan_peer_table *table, const struct ether_addr *addr)
+{
+    size_t mask = table->capacity - 1;
+    size_t index = nan_peer_table_hash(addr) & mask;
+
+    while (table->slots[index] != NULL && !ether_addr_equal(&table->slots[index]->addr, addr))
+        index = (index + 1) & mask;
+
+    return index;
+}
+
+static int nan_peer_table_init(struct nan_peer_table *table, size_t capacity)
+{
+    table->slots = calloc(capacity, sizeof(struct nan_peer *));
+    if (table->slots == NULL)
+        return -1;
+
+    table->capacity = capacity;
+    table->count = 0;
+    return 0;
+}
+
+static int nan_peer_table_grow(struct nan_peer_table *table)
+{
+    struct nan_peer_table grown;
+    if (nan_peer_table_init(&grown, table->capacity * 2) < 0)
+        return -1;
+
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        struct nan_peer *peer = table->slots[i];
+        if (peer != NULL)
+            grown.slots[nan_peer_table_find_slot(&grown, &peer->addr)] = peer;
+    }
+    grown.count = table->count;
+
+    free(table->slots);
+    *table = grown;
+    return 0;
+}
+
+static int nan_peer_table_insert(struct nan_peer_table *table, struct nan_peer *peer)
+{
+    // Keep the load factor at most 1/2 to keep probe sequences short
+    if ((table->count + 1) * 2 > table->capacity && nan_peer_table_grow(table) < 0)
+        return -1;
+
+    table->slots[nan_peer_table_find_slot(table, &peer->addr)] = peer;
+    table->count++;
+    return 0;
+}
+
+static void nan_peer_table_remove(struct nan_peer_table *table, const struct nan_peer *peer)
+{
+    size_t mask = table->capacity - 1;
+    size_t index = nan_peer_table_find_slot(table, &peer->addr);
+    if (table->slots[index] != peer)
+        return;
+
+    table->slots[index] = NULL;
+    table->count--;
+
+    // Shift following entries back into the gap, so that no tombstones are needed
+    size_t next = index;
+    while (true)
+    {
+        next = (next + 1) & mask;
+        if (table->slots[next] == NULL)
+            break;
+
+        size_t home = nan_peer_table_hash(&table->slots[next]->addr) & mask;
+        // The entry may only move if its home slot does not lie cyclically in (index, next]
+        bool in_between = index <= next ? (index < home && home <= next)
+                                        : (index < home || home <= next);
+        if (in_between)
+            continue;
+
+        table->slots[index] = table->slots[next];
+        table->slots[next] = NULL;
+        index = next;
+    }
+}
+
+static uint64_t nan_peer_expiry_tick(const struct nan_peer_state *state, const struct nan_peer *peer)
+{
+    return (peer->last_update + state->timeout_usec) / PEER_EXPIRY_TICK_USEC;
+}
+
+static void nan_peer_expiry_link(struct nan_peer_expiry_wheel *wheel, struct nan_peer *peer,
+                                 uint64_t tick)
+{
+    struct nan_peer **bucket = &wheel->buckets[tick % PEER_EXPIRY_WHEEL_SIZE];
+
+    peer->expiry_tick = tick;
+    peer->expiry_prev = NULL;
+    peer->expiry_next = *bucket;
+    if (*bucket != NULL)
+        (*bucket)->expiry_prev = peer;
+    *bucket = peer;
+}
+
+static void nan_peer_expiry_unlink(struct nan_peer_expiry_wheel *wheel, struct nan_peer *peer)
+{
+    if (peer->expiry_prev != NULL)
+        peer->expiry_prev->expiry_next = peer->expiry_next;
+    else
+        wheel->buckets[peer->expiry_tick % PEER_EXPIRY_WHEEL_SIZE] = peer->expiry_next;
+
+    if (peer->expiry_next != NULL)
+        peer->expiry_next->expiry_prev = peer->expiry_prev;
+
+    peer->expiry_prev = NULL;
+    peer->expiry_next = NULL;
+}
+
+/**
+ * Move the peer to the bucket matching its last update, which only changes once per tick.
+ */
+static void nan_peer_expiry_refresh(struct nan_peer_state *state, struct nan_peer *peer)
+{
+    uint64_t tick = nan_peer_expiry_tick(state, peer);
+    if (tick == peer->expiry_tick)
+        return;
+
+    nan_peer_expiry_unlink(&state->expiry, peer);
+    nan_peer_expiry_link(&state->expiry, peer, tick);
+}
+
+static int nan_peer_hot_grow_array(void **array, size_t element_size, size_t capacity)
+{
+    void *grown = realloc(*array, capacity * element_size);
+    if (grown == NULL)
+        return -1;
+
+    *array = grown;
+    return 0;
+}
+
+static int nan_peer_hot_reserve(struct nan_peer_hot *hot, size_t capacity)
+{
+    if (capacity <= hot->capacity)
+        return 0;
+
+    if (nan_peer_hot_grow_array((void **)&hot->peers, sizeof(*hot->peers), capacity) < 0 ||
+        nan_peer_hot_grow_array((void **)&hot->master_rank, sizeof(*hot->master_rank), capacity) < 0 ||
+        nan_peer_hot_grow_array((void **)&hot->rssi_average, sizeof(*hot->rssi_average), capacity) < 0 ||
+        nan_peer_hot_grow_array((void **)&hot->master_candidate, sizeof(*hot->master_candidate), capacity) < 0 ||
+        nan_peer_hot_grow_array((void **)&hot->election_flags, sizeof(*hot->election_flags), capacity) < 0)
+        return -1;
+
+    hot->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Copy the fields read by the master election from the peer to the mirror.
+ */
+static void nan_peer_hot_sync(struct nan_peer_hot *hot, const struct nan_peer *peer)
+{
+    size_t index = peer->hot_index;
+    hot->master_rank[index] = nan_get_peer_master_rank(peer);
+    hot->rssi_average[index] = peer->rssi_average;
+    hot->master_candidate[index] = peer->master_candidate;
+}
+
+static int nan_peer_hot_add(struct nan_peer_hot *hot, struct nan_peer *peer)
+{
+    if (hot->count == hot->capacity &&
+        nan_peer_hot_reserve(hot, hot->capacity ? hot->capacity * 2 : PEER_TABLE_INITIAL_CAPACITY) < 0)
+        return -1;
+
+    peer->hot_index = hot->count++;
+    hot->peers[peer->hot_index] = peer;
+    hot->election_flags[peer->hot_index] = 0;
+    nan_peer_hot_sync(hot, peer);
+    return 0;
+}
+
+static void nan_peer_hot_remove(struct nan_peer_hot *hot, const struct nan_peer *peer)
+{
+    // Keep the arrays dense by moving the last peer into the gap
+    size_t index = peer->hot_index;
+    size_t last = --hot->count;
+    if (index == last)
+        return;
+
+    hot->peers[index] = hot->peers[last];
+    hot->master_rank[index] = hot->master_rank[last];
+    hot->rssi_average[index] = hot->rssi_average[last];
+    hot->master_candidate[index] = hot->master_candidate[last];
+    hot->election_flags[index] = hot->election_flags[last];
+    hot->peers[index]->hot_index = index;
+}
+
+static uint8_t nan_peer_election_flags(const struct nan_peer_hot *hot, size_t index,
+                                       const uint64_t master_rank)
+{
+    return (hot->rssi_average[index] > RSSI_CLOSE) * PEER_ELECTION_RSSI_CLOSE |
+           (hot->rssi_average[index] > RSSI_MIDDLE) * PEER_ELECTION_RSSI_MIDDLE |
+           (hot->master_rank[index] > master_rank) * PEER_ELECTION_HIGHER_MASTER_RANK |
+           (hot->master_candidate[index] != 0) * PEER_ELECTION_MASTER_CANDIDATE;
+}
+
+static void nan_peer_election_count(struct nan_election_counters *counters, uint8_t flags, int delta)
+{
+    bool higher_mr = flags & PEER_ELECTION_HIGHER_MASTER_RANK;
+    bool master_candidate = flags & PEER_ELECTION_MASTER_CANDIDATE;
+
+    if (higher_mr)
+        counters->count_higher_mr += delta;
+
+    if (flags & PEER_ELECTION_RSSI_CLOSE)
+    {
+        counters->count_rssi_close += delta;
+        if (higher_mr)
+            counters->count_rssi_close_higher_mr += delta;
+        if (master_candidate)
+            counters->count_rssi_close_master_candidate += delta;
+    }
+
+    if (flags & PEER_ELECTION_RSSI_MIDDLE)
+    {
+        counters->count_rssi_middle += delta;
+        if (higher_mr)
+            counters->count_rssi_middle_higher_mr += delta;
+        if (master_candidate)
+            counters->count_rssi_middle_master_candidate += delta;
+    }
+}
+
+/**
+ * Recompute the flags of all peers and count those that are counted in the election.
+ * Branch free over the mirrored arrays, so that the compiler can vectorize the loop.
+ */
+static void nan_peer_election_recount(struct nan_peer_hot *hot, struct nan_election_counters *counters,
+                                      const uint64_t master_rank)
+{
+    int higher_mr = 0, rssi_close = 0, rssi_middle = 0;
+    int rssi_close_higher_mr = 0, rssi_close_master_candidate = 0;
+    int rssi_middle_higher_mr = 0, rssi_middle_master_candidate = 0;
+
+    // Locals, so that the stores to the flags cannot alias the arrays or the count
+    const size_t count = hot->count;
+    const uint64_t *peer_master_rank = hot->master_rank;
+    const signed char *rssi_average = hot->rssi_average;
+    const uint8_t *master_candidate = hot->master_candidate;
+    uint8_t *election_flags = hot->election_flags;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int counted = (election_flags[i] & PEER_ELECTION_COUNTED) != 0;
+        int close = rssi_average[i] > RSSI_CLOSE;
+        int middle = rssi_average[i] > RSSI_MIDDLE;
+        int higher = peer_master_rank[i] > master_rank;
+        int candidate = master_candidate[i] != 0;
+
+        election_flags[i] = counted * PEER_ELECTION_COUNTED |
+                            close * PEER_ELECTION_RSSI_CLOSE |
+                            middle * PEER_ELECTION_RSSI_MIDDLE |
+                            higher * PEER_ELECTION_HIGHER_MASTER_RANK |
+                            candidate * PEER_ELECTION_MASTER_CANDIDATE;
+
+        higher_mr += counted & higher;
+        rssi_close += counted & close;
+        rssi_middle += counted & middle;
+        rssi_close_higher_mr += counted & close & higher;
+        rssi_close_master_candidate += counted & close & candidate;
+        rssi_middle_higher_mr += counted & middle & higher;
+        rssi_middle_master_candidate += counted & middle & candidate;
+    }
+
+    counters->count_higher_mr = higher_mr;
+    counters->count_rssi_close = rssi_close;
+    counters->count_rssi_middle = rssi_middle;
+    counters->count_rssi_close_higher_mr = rssi_close_higher_mr;
+    counters->count_rssi_close_master_candidate = rssi_close_master_candidate;
+    counters->count_rssi_middle_higher_mr = rssi_middle_higher_mr;
+    counters->count_rssi_middle_master_candidate = rssi_middle_master_candidate;
+}
+
+static void nan_peer_election_remove(struct nan_peer_state *state, struct nan_peer *peer)
+{
+    struct nan_peer_election *election = &state->election;
+    uint8_t *flags = &state->hot.election_flags[peer->hot_index];
+    if (!(*flags & PEER_ELECTION_COUNTED))
+        return;
+
+    nan_peer_election_count(&election->counters, *flags, -1);
+    *flags &= ~PEER_ELECTION_COUNTED;
+
+    if (peer->election_prev != NULL)
+        peer->election_prev->election_next = peer->election_next;
+    else
+        election->head = peer->election_next;
+
+    if (peer->election_next != NULL)
+        peer->election_next->election_prev = peer->election_prev;
+    else
+        election->tail = peer->election_prev;
+
+    peer->election_prev = NULL;
+    peer->election_next = NULL;
+}
+
+/**
+ * Count the peer again, keeping the counted peers ordered by their last update.
+ * Usually the peer is the most recently updated one and goes to the tail, but arrival
+ * times of different frames are not guaranteed to be monotonic.
+ */
+static void nan_peer_election_touch(struct nan_peer_state *state, struct nan_peer *peer)
+{
+    struct nan_peer_election *election = &state->election;
+    nan_peer_election_remove(state, peer);
+
+    struct nan_peer *prev = election->tail;
+    while (prev != NULL && prev->last_update > peer->last_update)
+        prev = prev->election_prev;
+
+    peer->election_prev = prev;
+    peer->election_next = prev != NULL ? prev->election_next : election->head;
+    if (peer->election_next != NULL)
+        peer->election_next->election_prev = peer;
+    else
+        election->tail = peer;
+    if (prev != NULL)
+        prev->election_next = peer;
+    else
+        election->head = peer;
+
+    nan_peer_hot_sync(&state->hot, peer);
+    uint8_t flags = nan_peer_election_flags(&state->hot, peer->hot_index, election->master_rank);
+    state->hot.election_flags[peer->hot_index] = flags | PEER_ELECTION_COUNTED;
+    nan_peer_election_count(&election->counters, flags, 1);
+}
+
+void nan_peer_election_update(struct nan_peer_state *state, struct nan_peer *peer)
+{
+    struct nan_peer_election *election = &state->election;
+    nan_peer_hot_sync(&state->hot, peer);
+
+    uint8_t *flags = &state->hot.election_flags[peer->hot_index];
+    if (!(*flags & PEER_ELECTION_COUNTED))
+        return;
+
+    uint8_t updated = nan_peer_election_flags(&state->hot, peer->hot_index, election->master_rank) |
+                      PEER_ELECTION_COUNTED;
+    if (updated == *flags)
+        return;
+
+    nan_peer_election_count(&election->counters, *flags, -1);
+    *flags = updated;
+    nan_peer_election_count(&election->counters, *flags, 1);
+}
+
+const struct nan_election_counters *nan_peer_election_counters(struct nan_peer_state *state,
+                                                               const uint64_t master_rank,
+                                                               const uint64_t now_usec,
+                                                               const uint64_t window_usec)
+{
+    struct nan_peer_election *election = &state->election;
+
+    // Peers updated after now_usec, e.g., from a frame timestamp ahead of the clock, are not aged
+    while (election->head != NULL && election->head->last_update < now_usec &&
+           now_usec - election->head->last_update > window_usec)
+        nan_peer_election_remove(state, election->head);
+
+    if (master_rank != election->master_rank)
+    {
+        election->master_rank = master_rank;
+        nan_peer_election_recount(&state->hot, &election->counters, master_rank);
+    }
+
+    return &election->counters;
+}
 
 void nan_peer_state_init(struct nan_peer_state *state)
 {
     state->peers = list_init();
+    if (nan_peer_table_init(&state->table, PEER_TABLE_INITIAL_CAPACITY) < 0)
+        log_error("Could not allocate peer table");
+
+    memset(state->expiry.buckets, 0, sizeof(state->expiry.buckets));
+    state->expiry.next_tick = 0;
+
+    slab_init(&state->pool, sizeof(struct nan_peer), PEER_POOL_CHUNK_SIZE, PEER_DEFAULT_MAX_PEERS);
+
+    memset(&state->election, 0, sizeof(state->election));
+    memset(&state->hot, 0, sizeof(state->hot));
     state->timeout_usec = PEER_DEFAULT_TIMEOUT_USEC;
     state->clean_interval_usec = PEER_DEFAULT_CLEAN_INTERVAL_USEC;
 
@@ -17,6 +417,20 @@ void nan_peer_state_init(struct nan_peer_state *state)
     state->peer_remove_callback_data = NULL;
 }
 
+void nan_peer_state_free(struct nan_peer_state *state)
+{
+    // Peer records live in the pool, the list and the table only reference them
+    list_free(state->peers, false);
+    free(state->table.slots);
+    slab_free(&state->pool);
+
+    free(state->hot.peers);
+    free(state->hot.master_rank);
+    free(state->hot.rssi_average);
+    free(state->hot.master_candidate);
+    free(state->hot.election_flags);
+}
+
 void nan_peer_set_callbacks(struct nan_peer_state *state,
                             nan_peer_callback peer_add_callback, void *peer_add_data,
                             nan_peer_callback peer_remove_callback, void *peer_remove_data)
@@ -27,9 +441,18 @@ void nan_peer_set_callbacks(struct nan_peer_state *state,
     state->peer_remove_callback_data = peer_remove_data;
 }
 
-struct nan_peer *nan_peer_new(const struct ether_addr *addr, const struct ether_addr *cluster_id)
+void nan_peer_set_max_peers(struct nan_peer_state *state, size_t max_peers)
 {
-    struct nan_peer *peer = malloc(sizeof(struct nan_peer));
+    state->pool.max_objects = max_peers;
+}
+
+static struct nan_peer *nan_peer_new(struct nan_peer_state *state, const struct ether_addr *addr,
+                                     const struct ether_addr *cluster_id)
+{
+    struct nan_peer *peer = slab_alloc(&state->pool);
+    if (peer == NULL)
+        return NULL;
+
     peer->addr = *addr;
     peer->cluster_id = *cluster_id;
     ether_addr_to_ipv6_addr(addr, &peer->ipv6_addr);
@@ -46,28 +469,68 @@ struct nan_peer *nan_peer_new(const struct ether_addr *addr, const struct ether_
     peer->hop_count = 0;
     peer->master_candidate = false;
 
-    moving_average_init(peer->rssi_average_state, peer->rssi_average,
-                        signed char, PEER_RSSI_BUFFER_SIZE);
+    memset(&peer->timestamp_offsets, 0, sizeof(peer->timestamp_offsets));
+    memset(peer->recent_frames, 0, sizeof(peer->recent_frames));
+    peer->recent_frames_next = 0;
+
+    peer->hot_index = 0;
+    peer->election_prev = NULL;
+    peer->election_next = NULL;
+
+    peer->expiry_tick = 0;
+    peer->expiry_prev = NULL;
+    peer->expiry_next = NULL;
+
+    moving_average_init_buffer(peer->rssi_average_state, peer->rssi_average,
+                               peer->rssi_samples, PEER_RSSI_BUFFER_SIZE);
 
     return peer;
 }
 
 enum peer_status nan_peer_get(struct nan_peer_state *state, const struct ether_addr *addr, struct nan_peer **peer)
 {
-    LIST_FIND(state->peers, *peer, ether_addr_equal(&((*peer)->addr), addr))
+    *peer = NULL;
+    if (state->table.slots == NULL)
+        return PEER_INTERNAL;
+
+    *peer = state->table.slots[nan_peer_table_find_slot(&state->table, addr)];
     if (*peer)
         return PEER_OK;
     return PEER_MISSING;
 }
 
 enum peer_status nan_peer_add(struct nan_peer_state *state, const struct ether_addr *addr,
-                              const struct ether_addr *cluster_id, uint64_t now_usec)
+                              const struct ether_addr *cluster_id, uint64_t now_usec,
+                              struct nan_peer **added_peer)
 {
     struct nan_peer *peer = NULL;
     int status = nan_peer_get(state, addr, &peer);
+    if (status == PEER_INTERNAL)
+        return PEER_INTERNAL;
+
     if (status == PEER_MISSING)
     {
-        peer = nan_peer_new(addr, cluster_id);
+        peer = nan_peer_new(state, addr, cluster_id);
+        if (peer == NULL)
+        {
+            if (slab_full(&state->pool))
+                return PEER_LIMIT;
+            return PEER_INTERNAL;
+        }
+
+        if (nan_peer_table_insert(&state->table, peer) < 0)
+        {
+            slab_release(&state->pool, peer);
+            return PEER_INTERNAL;
+        }
+
+        if (nan_peer_hot_add(&state->hot, peer) < 0)
+        {
+            nan_peer_table_remove(&state->table, peer);
+            slab_release(&state->pool, peer);
+            return PEER_INTERNAL;
+        }
+
         if (state->peer_add_callback != NULL)
             state->peer_add_callback(peer, state->peer_add_callback_data);
 
@@ -77,13 +540,20 @@ enum peer_status nan_peer_add(struct nan_peer_state *state, const struct ether_a
     }
 
     peer->last_update = now_usec;
+    if (added_peer != NULL)
+        *added_peer = peer;
 
     if (status == PEER_MISSING)
     {
+        nan_peer_expiry_link(&state->expiry, peer, nan_peer_expiry_tick(state, peer));
+        nan_peer_election_touch(state, peer);
         list_add(state->peers, (any_t)peer);
         return PEER_ADD;
     }
 
+    nan_peer_expiry_refresh(state, peer);
+    nan_peer_election_touch(state, peer);
+
     if (!ether_addr_equal(&peer->cluster_id, cluster_id))
     {
         log_debug("Updated cluster id of peer %s to %s",
@@ -94,6 +564,38 @@ enum peer_status nan_peer_add(struct nan_peer_state *state, const struct ether_a
     return PEER_UPDATE;
 }
 
+bool nan_peer_is_duplicate_frame(const struct nan_peer *peer, const uint16_t seq_ctrl,
+                                 const uint16_t frame_control, const uint16_t length,
+                                 const uint64_t now_usec)
+{
+    /* The retry bit differs between the original frame and its retransmission */
+    uint16_t type = frame_control & ~IEEE80211_FCTL_RETRY;
+
+    for (int i = 0; i < PEER_RECENT_FRAMES_SIZE; i++)
+    {
+        const struct nan_peer_recent_frame *frame = &peer->recent_frames[i];
+        if (frame->time_usec == 0 || now_usec - frame->time_usec > PEER_DUPLICATE_WINDOW_USEC)
+            continue;
+
+        if (frame->seq_ctrl == seq_ctrl && frame->frame_control == type && frame->length == length)
+            return true;
+    }
+    return false;
+}
+
+void nan_peer_add_recent_frame(struct nan_peer *peer, const uint16_t seq_ctrl,
+                               const uint16_t frame_control, const uint16_t length,
+                               const uint64_t now_usec)
+{
+    struct nan_peer_recent_frame *frame = &peer->recent_frames[peer->recent_frames_next];
+    frame->seq_ctrl = seq_ctrl;
+    frame->frame_control = frame_control & ~IEEE80211_FCTL_RETRY;
+    frame->length = length;
+    frame->time_usec = now_usec;
+
+    peer->recent_frames_next = (peer->recent_frames_next + 1) % PEER_RECENT_FRAMES_SIZE;
+}
+
 void nan_peer_set_master_indication(struct nan_peer *peer,
                                     const uint8_t master_preference,
                                     const uint8_t random_factor)
@@ -127,17 +629,45 @@ void nan_peer_set_beacon_information(struct nan_peer *peer, const signed char rs
 void nan_peer_remove(struct nan_peer_state *state, struct nan_peer *peer)
 {
     list_remove(state->peers, (any_t)peer);
-    state->peer_remove_callback(peer, state->peer_remove_callback_data);
-    free(peer);
+    nan_peer_table_remove(&state->table, peer);
+    nan_peer_expiry_unlink(&state->expiry, peer);
+    nan_peer_election_remove(state, peer);
+    nan_peer_hot_remove(&state->hot, peer);
+    if (state->peer_remove_callback != NULL)
+        state->peer_remove_callback(peer, state->peer_remove_callback_data);
+    slab_release(&state->pool, peer);
 }
 
 void nan_peers_clean(struct nan_peer_state *state, uint64_t now_usec)
 {
-    struct nan_peer *peer;
-    do
+    struct nan_peer_expiry_wheel *wheel = &state->expiry;
+    uint64_t now_tick = now_usec / PEER_EXPIRY_TICK_USEC;
+
+    // After a long pause every bucket has to be checked, but only once
+    uint64_t tick = wheel->next_tick;
+    if (now_tick >= PEER_EXPIRY_WHEEL_SIZE && tick < now_tick - PEER_EXPIRY_WHEEL_SIZE + 1)
+        tick = now_tick - PEER_EXPIRY_WHEEL_SIZE + 1;
+
+    for (; tick <= now_tick; tick++)
     {
-        LIST_FIND(state->peers, peer, peer->last_update < now_usec - state->timeout_usec)
-        if (peer)
-            nan_peer_remove(state, peer);
-    } while (peer);
+        struct nan_peer *next = wheel->buckets[tick % PEER_EXPIRY_WHEEL_SIZE];
+        while (next != NULL)
+        {
+            struct nan_peer *peer = next;
+            next = peer->expiry_next;
+
+            // Peers in the same bucket might expire in a later round of the wheel
+            if (peer->expiry_tick > now_tick)
+                continue;
+
+            if (peer->last_update + state->timeout_usec < now_usec)
+                nan_peer_remove(state, peer);
+            else
+                nan_peer_expiry_refresh(state, peer);
+        }
+    }
+
+    // The current tick is not over yet and is checked again on the next call
+    if (now_tick > wheel->next_tick)
+        wheel->next_tick = now_tick;
 }
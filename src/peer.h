@@ -3,16 +3,40 @@
 
 #include <netinet/ether.h>
 #include <netinet/in.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "list.h"
 #include "moving_average.h"
+#include "slab.h"
+#include "timestamp.h"
 
 #define HOST_NAME_LENGTH_MAX 64
 #define PEER_DEFAULT_TIMEOUT_USEC TU_TO_USEC(512) * 10
-#define PEER_DEFAULT_CLEAN_INTERVAL_USEC TU_TO_USEC(512) * 2
+/* Cleaning only touches expiring peers, so it is cheap enough to run once per DW */
+#define PEER_DEFAULT_CLEAN_INTERVAL_USEC TU_TO_USEC(512)
+/* Width of a bucket of the peer expiry wheel */
+#define PEER_EXPIRY_TICK_USEC TU_TO_USEC(512)
+/* Number of buckets of the peer expiry wheel, should cover the peer timeout */
+#define PEER_EXPIRY_WHEEL_SIZE 32
 #define PEER_RSSI_BUFFER_SIZE 32
+/* Maximum number of peers tracked at the same time */
+#define PEER_DEFAULT_MAX_PEERS 1024
+/* Number of peer records allocated at once */
+#define PEER_POOL_CHUNK_SIZE 32
+/* Number of recently received frames remembered per peer to detect duplicates */
+#define PEER_RECENT_FRAMES_SIZE 4
+/* Frames with the same sequence control received within this time are duplicates */
+#define PEER_DUPLICATE_WINDOW_USEC 50000
+
+struct nan_peer_recent_frame
+{
+    uint16_t seq_ctrl;
+    uint16_t frame_control;
+    uint16_t length;
+    uint64_t time_usec;
+};
 
 #ifndef RSSI_CLOSE
 #define RSSI_CLOSE -60
@@ -43,6 +67,25 @@ struct nan_peer
 
     signed char rssi_average;
     moving_average_t rssi_average_state;
+    /* Kept in the record, so that the samples share cache lines with the peer */
+    signed char rssi_samples[PEER_RSSI_BUFFER_SIZE];
+
+    struct nan_timestamp_peer timestamp_offsets;
+
+    struct nan_peer_recent_frame recent_frames[PEER_RECENT_FRAMES_SIZE];
+    uint8_t recent_frames_next;
+
+    /* Position in the mirror of hot fields */
+    size_t hot_index;
+    /* Links the counted peers, ordered by last update */
+    struct nan_peer *election_prev;
+    struct nan_peer *election_next;
+
+    /* Tick of the expiry wheel in which the peer times out */
+    uint64_t expiry_tick;
+    /* Links the peers within a bucket of the expiry wheel */
+    struct nan_peer *expiry_prev;
+    struct nan_peer *expiry_next;
 
     bool availability_all_slots;
     list_t availability_entries;
@@ -67,13 +110,109 @@ enum peer_status
     PEER_OK = 0,        /* New peer added */
     PEER_MISSING = -1,  /* Peer does not exist */
     PEER_INTERNAL = -2, /* Internal error */
+    PEER_LIMIT = -3,    /* Maximum number of peers reached */
 };
 
 typedef void (*nan_peer_callback)(struct nan_peer *peer, void *arg);
 
+/* How a peer counts in the master election */
+enum nan_peer_election_flag
+{
+    PEER_ELECTION_RSSI_CLOSE = 1 << 0,
+    PEER_ELECTION_RSSI_MIDDLE = 1 << 1,
+    PEER_ELECTION_HIGHER_MASTER_RANK = 1 << 2,
+    PEER_ELECTION_MASTER_CANDIDATE = 1 << 3,
+    /* The peer was updated within the election window */
+    PEER_ELECTION_COUNTED = 1 << 4,
+};
+
+/**
+ * Number of recently updated peers per category considered by the master election
+ */
+struct nan_election_counters
+{
+    int count_higher_mr;
+    int count_rssi_close;
+    int count_rssi_middle;
+    int count_rssi_close_higher_mr;
+    int count_rssi_close_master_candidate;
+    int count_rssi_middle_higher_mr;
+    int count_rssi_middle_master_candidate;
+};
+
+/**
+ * Master election counters maintained whenever a peer is updated, so that
+ * the election does not have to look at all peers at the end of every DW.
+ * Peers leave the counters once their last update is older than the election window.
+ */
+struct nan_peer_election
+{
+    struct nan_election_counters counters;
+    /* Own master rank the higher master rank counters refer to */
+    uint64_t master_rank;
+    /* Counted peers ordered by last update, the least recently updated first */
+    struct nan_peer *head;
+    struct nan_peer *tail;
+};
+
+/**
+ * Mirror of the peer fields read by the master election as structure of arrays,
+ * indexed by nan_peer.hot_index. Scans over all peers run over contiguous memory
+ * instead of chasing pointers and can be vectorized by the compiler.
+ * Updated by nan_peer_add and nan_peer_election_update.
+ */
+struct nan_peer_hot
+{
+    size_t count;
+    size_t capacity;
+    struct nan_peer **peers;
+    uint64_t *master_rank;
+    signed char *rssi_average;
+    uint8_t *master_candidate;
+    /* Contribution to the master election counters, see nan_peer_election_flag */
+    uint8_t *election_flags;
+};
+
+/* Initial number of slots of the peer table, must be a power of two */
+#define PEER_TABLE_INITIAL_CAPACITY 16
+
+/**
+ * Open addressing hash table with linear probing mapping addresses to peers.
+ * Only pointers are stored, so peers never move when the table grows.
+ */
+struct nan_peer_table
+{
+    struct nan_peer **slots;
+    size_t capacity;
+    size_t count;
+};
+
+/**
+ * Hashed timing wheel tracking when peers time out. Each bucket holds the
+ * peers expiring in ticks that map to it, so that cleaning only has to look
+ * at the buckets of the ticks that passed instead of at all peers.
+ */
+struct nan_peer_expiry_wheel
+{
+    struct nan_peer *buckets[PEER_EXPIRY_WHEEL_SIZE];
+    /* All ticks before this one have been processed */
+    uint64_t next_tick;
+};
+
 struct nan_peer_state
 {
+    /* Used to iterate over all peers */
     list_t peers;
+    /* Used to look up peers by address */
+    struct nan_peer_table table;
+    /* Used to time out peers */
+    struct nan_peer_expiry_wheel expiry;
+    /* Peer records, also tracks the occupancy */
+    struct slab pool;
+    /* Used by the master election */
+    struct nan_peer_election election;
+    struct nan_peer_hot hot;
+    /* Should only be changed before peers are added */
     uint64_t timeout_usec;
     uint64_t clean_interval_usec;
 
@@ -91,6 +230,13 @@ struct nan_peer_state
  */
 void nan_peer_state_init(struct nan_peer_state *state);
 
+/**
+ * Free all peers of the peer state without calling the remove callback
+ *
+ * @param state - The peer state to free
+ */
+void nan_peer_state_free(struct nan_peer_state *state);
+
 /**
  * Set callbacks to hook adding and removing of peers.
  * 
@@ -104,6 +250,14 @@ void nan_peer_set_callbacks(struct nan_peer_state *state,
                             nan_peer_callback peer_add_callback, void *peer_add_data,
                             nan_peer_callback peer_remove_callback, void *peer_remove_data);
 
+/**
+ * Limit the number of peers tracked at the same time. Peers beyond the limit are not added.
+ * 
+ * @param state - The current peer state
+ * @param max_peers - Maximum number of peers, 0 for no limit
+ */
+void nan_peer_set_max_peers(struct nan_peer_state *state, size_t max_peers);
+
 /**
  * Get a peer from the storage matching the give address
  */
@@ -111,9 +265,17 @@ enum peer_status nan_peer_get(struct nan_peer_state *state, const struct ether_a
 
 /** 
  * Adds a peer to the storage if it is not already included
+ * 
+ * @param state - The current peer state
+ * @param addr - The address of the peer
+ * @param cluster_id - The cluster the peer is part of
+ * @param now - Current time in microseconds
+ * @param peer - Set to the added or updated peer, may be NULL
+ * @returns PEER_ADD if the peer is new, PEER_UPDATE if it already existed or a negative error
  */
 enum peer_status nan_peer_add(struct nan_peer_state *state, const struct ether_addr *addr,
-                              const struct ether_addr *cluster_id, uint64_t now);
+                              const struct ether_addr *cluster_id, uint64_t now,
+                              struct nan_peer **peer);
 
 /**
  * Remove the given peer from the list of known peers
@@ -123,6 +285,58 @@ enum peer_status nan_peer_add(struct nan_peer_state *state, const struct ether_a
  */
 void nan_peer_remove(struct nan_peer_state *state, struct nan_peer *peer);
 
+/**
+ * Check whether a frame is a duplicate of a frame recently received from the peer,
+ * e.g. a retransmission or the same frame captured twice.
+ * 
+ * @param peer - The sending peer
+ * @param seq_ctrl - The sequence control field of the frame
+ * @param frame_control - The frame control field of the frame
+ * @param length - The length of the frame without radiotap header and FCS
+ * @param now_usec - Current time in microseconds
+ * @returns Whether the frame is a duplicate
+ */
+bool nan_peer_is_duplicate_frame(const struct nan_peer *peer, const uint16_t seq_ctrl,
+                                 const uint16_t frame_control, const uint16_t length,
+                                 const uint64_t now_usec);
+
+/**
+ * Remember a received frame for duplicate detection.
+ * 
+ * @param peer - The sending peer
+ * @param seq_ctrl - The sequence control field of the frame
+ * @param frame_control - The frame control field of the frame
+ * @param length - The length of the frame without radiotap header and FCS
+ * @param now_usec - Current time in microseconds
+ */
+void nan_peer_add_recent_frame(struct nan_peer *peer, const uint16_t seq_ctrl,
+                               const uint16_t frame_control, const uint16_t length,
+                               const uint64_t now_usec);
+
+/**
+ * Update the mirrored fields and the master election counters after the RSSI,
+ * master indication or master candidate state of a peer changed.
+ * 
+ * @param state - The current peer state
+ * @param peer - The changed peer
+ */
+void nan_peer_election_update(struct nan_peer_state *state, struct nan_peer *peer);
+
+/**
+ * Get the master election counters over all peers updated within the given window.
+ * Costs are independent of the number of peers, unless the own master rank changed.
+ * 
+ * @param state - The current peer state
+ * @param master_rank - The own master rank
+ * @param now_usec - Current time in microseconds, peers updated later are counted
+ * @param window_usec - Peers updated longer ago are not counted
+ * @returns The election counters
+ */
+const struct nan_election_counters *nan_peer_election_counters(struct nan_peer_state *state,
+                                                               const uint64_t master_rank,
+                                                               const uint64_t now_usec,
+                                                               const uint64_t window_usec);
+
 /**
  * Update the peer's master indication information.
  * 
@@ -158,6 +372,7 @@ void nan_peer_set_beacon_information(struct nan_peer *peer, const signed char rs
 /**
  * Removes all peers that were last updated before the timeout.
  * Invokes the remove callback if present in the state.
+ * Only the peers in the expiry wheel buckets of the ticks since the last call are checked.
  * 
  * @param state - The current peers state, including the used timeout value
  * @param now_usec - The current time in microseconds
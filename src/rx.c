@@ -13,6 +13,7 @@
 #include "timer.h"
 #include "frame.h"
 #include "list.h"
+#include "arena.h"
 #include "tx.h"
 #include "sync.h"
 
@@ -20,6 +21,8 @@ const char *nan_rx_result_to_string(const int result)
 {
     switch (result)
     {
+    case RX_IGNORE_DUPLICATE:
+        return "ignore duplicate";
     case RX_IGNORE_SYNC_OUTSIDE_DW:
         return "ignore sync beacon outside dw";
     case RX_IGNORE_OUI:
@@ -107,12 +110,15 @@ int nan_parse_cluster_attribute(struct buf *buf, struct nan_peer *peer)
  * 
  * @param buf - The buffer that contains the attribute's data
  * @param service_descriptors - A list of service descriptors
+ * @param arena - Arena used for all allocations, valid until the next received frame
  * @returns - 0 on success, a negative value otherwise
  */
-int nan_parse_sda(struct buf *buf, list_t service_descriptors)
+int nan_parse_sda(struct buf *buf, list_t service_descriptors, struct arena *arena)
 {
     struct nan_service_descriptor_attribute *attribute =
-        malloc(sizeof(struct nan_service_descriptor_attribute));
+        arena_alloc(arena, sizeof(struct nan_service_descriptor_attribute));
+    if (attribute == NULL)
+        return RX_OTHER_ERROR;
 
     read_bytes_copy(buf, (uint8_t *)&attribute->service_id, NAN_SERVICE_ID_LENGTH);
     read_u8(buf, &attribute->instance_id);
@@ -139,15 +145,14 @@ int nan_parse_sda(struct buf *buf, list_t service_descriptors)
     if (attribute->control.service_info_present)
     {
         read_u8(buf, &attribute->service_info_length);
-        attribute->service_info = malloc(attribute->service_info_length);
+        attribute->service_info = arena_alloc(arena, attribute->service_info_length);
+        if (attribute->service_info == NULL)
+            return RX_OTHER_ERROR;
         read_bytes_copy(buf, (uint8_t *)attribute->service_info, attribute->service_info_length);
     }
 
     if (buf_error(buf))
-    {
-        free(attribute);
         return RX_TOO_SHORT;
-    }
 
     if (service_descriptors)
         list_add(service_descriptors, (any_t)attribute);
@@ -160,12 +165,16 @@ int nan_parse_sda(struct buf *buf, list_t service_descriptors)
  * 
  * @param buf - The buffer that contains the attribute's data
  * @param service_descriptor_extensions - A list of service descriptor extensions
+ * @param arena - Arena used for all allocations, valid until the next received frame
  * @returns - 0 on success, a negative value otherwise
  */
-int nan_parse_sdea(struct buf *buf, size_t length, list_t service_descriptor_extensions)
+int nan_parse_sdea(struct buf *buf, size_t length, list_t service_descriptor_extensions,
+                   struct arena *arena)
 {
     struct nan_service_descriptor_extension_attribute *attribute =
-        malloc(sizeof(struct nan_service_descriptor_extension_attribute));
+        arena_alloc(arena, sizeof(struct nan_service_descriptor_extension_attribute));
+    if (attribute == NULL)
+        return RX_OTHER_ERROR;
 
     read_u8(buf, &attribute->instance_id);
     read_le16(buf, (uint16_t *)&attribute->control);
@@ -188,10 +197,7 @@ int nan_parse_sdea(struct buf *buf, size_t length, list_t service_descriptor_ext
     }
 
     if (buf_error(buf))
-    {
-        free(attribute);
         return RX_TOO_SHORT;
-    }
 
     if (service_descriptor_extensions)
         list_add(service_descriptor_extensions, (any_t)attribute);
@@ -232,68 +238,127 @@ int nan_handle_availability_attribute(struct nan_state *state, struct buf *buf,
 }
 */
 
-/**
- * Read the next attribute from the frame
- * 
- * @param frame The frame buffer pointing to the start of a NAN attribute
- * @param attribute_id Pointer that will be set to the parsed attribtue id
- * @param attribute_length Pointer that will be set to the parsed attribtue length
- * @param data Pointer that will be set to start of the attribute's data
- */
-int nan_attribute_read_next(struct buf *frame, uint8_t *attribute_id,
-                            uint16_t *attribute_length, const uint8_t **data)
+int nan_attribute_next(struct buf *frame, struct nan_attribute_view *attribute)
 {
-    read_u8(frame, attribute_id);
-    read_le16(frame, attribute_length);
-    read_bytes(frame, data, *attribute_length);
+    const uint8_t *data = NULL;
+
+    if (buf_rest(frame) <= 0)
+        return 0;
+
+    read_u8(frame, &attribute->id);
+    read_le16(frame, &attribute->length);
+    read_bytes(frame, &data, attribute->length);
 
     if (buf_error(frame) < 0)
         return RX_TOO_SHORT;
 
-    return 3 + (int)*attribute_length;
+    attribute->data = buf_view(data, attribute->length);
+    return 3 + (int)attribute->length;
 };
 
 /**
- * Mactro to iterate through the NAN attribtues of a frame. 
- * Available variables in handle function:
- *  * attribute_id - Parsed attribute id
- *  * attribute_length - Parsed attribute length
- *  * attribute_buf - Buffer of attribute data
- * 
- * @param handle Handle function called for each attribute
+ * Context passed to the attribute parsers of service discovery frames
+ */
+struct nan_service_discovery_context
+{
+    list_t service_descriptors;
+    list_t service_descriptor_extensions;
+    struct arena *arena;
+};
+
+static int nan_handle_master_indication_attribute(struct buf *buf, void *data)
+{
+    return nan_parse_master_indication_attribute(buf, (struct nan_peer *)data);
+}
+
+static int nan_handle_cluster_attribute(struct buf *buf, void *data)
+{
+    return nan_parse_cluster_attribute(buf, (struct nan_peer *)data);
+}
+
+static int nan_handle_sda(struct buf *buf, void *data)
+{
+    struct nan_service_discovery_context *context = data;
+    return nan_parse_sda(buf, context->service_descriptors, context->arena);
+}
+
+static int nan_handle_sdea(struct buf *buf, void *data)
+{
+    struct nan_service_discovery_context *context = data;
+    return nan_parse_sdea(buf, buf_rest(buf), context->service_descriptor_extensions, context->arena);
+}
+
+void nan_rx_register_default_handlers(struct nan_attribute_dispatch *dispatch)
+{
+    nan_register_attribute_handler(dispatch, NAN_FRAME_BEACON, MASTER_INDICATION_ATTRIBUTE,
+                                   nan_handle_master_indication_attribute);
+    nan_register_attribute_handler(dispatch, NAN_FRAME_BEACON, CLUSTER_ATTRIBUTE,
+                                   nan_handle_cluster_attribute);
+    nan_skip_attribute(dispatch, NAN_FRAME_BEACON, SERVICE_ID_LIST_ATTRIBUTE);
+    nan_skip_attribute(dispatch, NAN_FRAME_BEACON, VENDOR_SPECIFIC_ATTRIBUTE);
+
+    nan_register_attribute_handler(dispatch, NAN_FRAME_SERVICE_DISCOVERY, SERVICE_DESCRIPTOR_ATTRIBUTE,
+                                   nan_handle_sda);
+    nan_register_attribute_handler(dispatch, NAN_FRAME_SERVICE_DISCOVERY, SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE,
+                                   nan_handle_sdea);
+    nan_skip_attribute(dispatch, NAN_FRAME_SERVICE_DISCOVERY, DEVICE_CAPABILITY_ATTRIBUTE);
+    nan_skip_attribute(dispatch, NAN_FRAME_SERVICE_DISCOVERY, NAN_AVAILABILITY_ATTRIBUTE);
+    nan_skip_attribute(dispatch, NAN_FRAME_SERVICE_DISCOVERY, VENDOR_SPECIFIC_ATTRIBUTE);
+}
+
+/**
+ * Iterate through the NAN attributes of a frame and pass each one to the parser
+ * registered for the frame type.
+ *
+ * @param frame The frame buffer pointing to the first NAN attribute
+ * @param dispatch The attribute handlers
+ * @param kind The type of the received frame
+ * @param data Frame type specific context for the parsers
+ * @returns RX_OK if all attributes could be parsed, a negative value otherwise
+ */
+static int nan_rx_attributes(struct buf *frame, const struct nan_attribute_dispatch *dispatch,
+                             enum nan_frame_kind kind, void *data)
+{
+    struct nan_attribute_view attribute;
+
+    while (nan_attribute_next(frame, &attribute) > 0)
+    {
+        int result = nan_dispatch_attribute(dispatch, kind, attribute.id, &attribute.data, data);
+        if (result < 0)
+        {
+            log_warn("Could not parse nan attribute: %s", nan_attribute_type_as_string(attribute.id));
+            return result;
+        }
+    }
+
+    if (buf_rest(frame) > 0)
+        return RX_UNEXPECTED_FORMAT;
+
+    return RX_OK;
+}
+
+/**
+ * Log a peer that could not be added. Once the peer limit is reached, every frame of an
+ * unknown peer ends up here, so these are only counted and warned about once.
+ *
+ * @param state The NAN state
+ * @param prefix The frame type for the log
+ * @param address The address of the peer
+ * @param status The status returned by nan_peer_add
  */
-#define NAN_ITERATE_ATTRIBUTES(handle)                                  \
-    do                                                                  \
-    {                                                                   \
-        const uint8_t *attribute_data;                                  \
-        uint8_t attribute_id;                                           \
-        uint16_t attribute_length;                                      \
-        int length;                                                     \
-        while (0 < (length = nan_attribute_read_next(frame,             \
-                                                     &attribute_id,     \
-                                                     &attribute_length, \
-                                                     &attribute_data))) \
-        {                                                               \
-            struct buf *attribute_buf =                                 \
-                buf_new_const(attribute_data, attribute_length);        \
-            handle;                                                     \
-            buf_free(attribute_buf);                                    \
-            if (result < 0)                                             \
-            {                                                           \
-                log_warn("Could not parse nan attribute: %s",           \
-                         nan_attribute_type_as_string(attribute_id));   \
-                break;                                                  \
-            }                                                           \
-        }                                                               \
-        if (result < 0)                                                 \
-            break;                                                      \
-        if (buf_rest(frame) > 0)                                        \
-        {                                                               \
-            result = RX_UNEXPECTED_FORMAT;                              \
-            break;                                                      \
-        }                                                               \
-        result = RX_OK;                                                 \
-    } while (0);
+static void nan_rx_peer_rejected(struct nan_state *state, const char *prefix,
+                                 const struct ether_addr *address, enum peer_status status)
+{
+    if (status != PEER_LIMIT)
+    {
+        log_warn("%s: could not add peer: %s (%d)", prefix, ether_addr_to_string(address), status);
+        return;
+    }
+
+    if (state->rx_peer_limit++ == 0)
+        log_warn("%s: peer limit reached, ignoring frames from new peers", prefix);
+    log_debug("%s: peer limit reached, ignoring %s", prefix, ether_addr_to_string(address));
+}
 
 int nan_parse_beacon_header(struct buf *frame, int *beacon_type, uint64_t *timestamp)
 {
@@ -344,19 +409,10 @@ int nan_rx_beacon(struct buf *frame, struct nan_state *state,
               ether_addr_to_string(cluster_id));
 
     struct nan_peer *peer = NULL;
-    enum peer_status peer_status = nan_peer_add(&state->peers, peer_address, cluster_id, now_usec);
+    enum peer_status peer_status = nan_peer_add(&state->peers, peer_address, cluster_id, now_usec, &peer);
     if (peer_status < 0)
     {
-        log_warn("nan_beacon: could not add peer: %s (%d)",
-                 ether_addr_to_string(peer_address), peer_status);
-        return RX_IGNORE;
-    }
-
-    nan_peer_get(&state->peers, peer_address, &peer);
-    if (peer == NULL)
-    {
-        log_warn("nan_beacon: could not get peer: %s (%d)",
-                 ether_addr_to_string(peer_address), peer_status);
+        nan_rx_peer_rejected(state, "nan_beacon", peer_address, peer_status);
         return RX_IGNORE;
     }
 
@@ -367,21 +423,7 @@ int nan_rx_beacon(struct buf *frame, struct nan_state *state,
     if (!nan_timer_initial_scan_done(&state->timer, now_usec))
         nan_timer_initial_scan_cancel(&state->timer);
 
-    NAN_ITERATE_ATTRIBUTES({
-        switch (attribute_id)
-        {
-        case MASTER_INDICATION_ATTRIBUTE:
-            result = nan_parse_master_indication_attribute(attribute_buf, peer);
-            break;
-        case CLUSTER_ATTRIBUTE:
-            result = nan_parse_cluster_attribute(attribute_buf, peer);
-            break;
-        default:
-            log_trace("Unhandled attribute: %s", nan_attribute_type_as_string(attribute_id));
-            result = RX_IGNORE;
-        }
-    });
-
+    result = nan_rx_attributes(frame, &state->attribute_dispatch, NAN_FRAME_BEACON, peer);
     if (result < 0)
         return result;
 
@@ -403,9 +445,11 @@ int nan_rx_beacon(struct buf *frame, struct nan_state *state,
         }
     }
 
+    nan_timestamp_beacon(&state->timestamp, &peer->timestamp_offsets, timestamp);
     nan_peer_set_beacon_information(peer, rssi, timestamp);
     nan_update_master_preference(&state->sync, peer, now_usec);
     nan_check_master_candidate(&state->sync, peer);
+    nan_peer_election_update(&state->peers, peer);
 
     bool is_new_cluster = !ether_addr_equal(cluster_id, &state->cluster.cluster_id);
     bool in_initial_cluster = list_len(state->peers.peers) == 1 && peer_status == PEER_ADD;
@@ -452,29 +496,19 @@ int nan_rx_service_discovery(struct buf *frame, struct nan_state *state,
                              const struct ether_addr *cluster_id,
                              const struct nan_peer *peer)
 {
-    (void)state;
     (void)cluster_id;
 
-    list_t service_descriptors = list_init();
-    list_t service_descriptor_extensions = list_init();
-    int result = 0;
+    struct nan_service_discovery_context context = {
+        .service_descriptors = list_init_arena(&state->rx_arena),
+        .service_descriptor_extensions = list_init_arena(&state->rx_arena),
+        .arena = &state->rx_arena,
+    };
 
-    NAN_ITERATE_ATTRIBUTES({
-        switch (attribute_id)
-        {
-        case SERVICE_DESCRIPTOR_ATTRIBUTE:
-            result = nan_parse_sda(attribute_buf, service_descriptors);
-            break;
-        case SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE:
-            result = nan_parse_sdea(attribute_buf, attribute_length,
-                                    service_descriptor_extensions);
-            break;
-        default:
-            log_trace("Unhandled attribute: %s", nan_attribute_type_as_string(attribute_id));
-            result = RX_IGNORE;
-        }
-    })
+    if (context.service_descriptors == NULL || context.service_descriptor_extensions == NULL)
+        return RX_OTHER_ERROR;
 
+    int result = nan_rx_attributes(frame, &state->attribute_dispatch,
+                                   NAN_FRAME_SERVICE_DISCOVERY, &context);
     if (result < 0)
     {
         log_error("Error while parsing attributes: %d", result);
@@ -483,7 +517,7 @@ int nan_rx_service_discovery(struct buf *frame, struct nan_state *state,
 
     struct nan_service_descriptor_attribute *service_descriptor;
     LIST_FOR_EACH(
-        service_descriptors, service_descriptor, {
+        context.service_descriptors, service_descriptor, {
             log_trace("Received service discovery for %u of type %d",
                       nan_service_id_to_string(&service_descriptor->service_id),
                       service_descriptor->control.service_control_type);
@@ -491,9 +525,6 @@ int nan_rx_service_discovery(struct buf *frame, struct nan_state *state,
                                                   &peer->addr, destination_address, service_descriptor);
         })
 
-    list_free(service_descriptors, true);
-    list_free(service_descriptor_extensions, true);
-
     return result;
 }
 
@@ -514,22 +545,15 @@ int nan_rx_action(struct buf *frame, struct nan_state *state,
     struct nan_peer *peer = NULL;
     enum peer_status status = PEER_MISSING;
 
-    status = nan_peer_add(&state->peers, source_address, cluster_id, now_usec);
+    status = nan_peer_add(&state->peers, source_address, cluster_id, now_usec, &peer);
     if (status < 0)
     {
-        log_warn("nan_action: could not add peer: %s (%d)", ether_addr_to_string(source_address), status);
+        nan_rx_peer_rejected(state, "nan_action", source_address, status);
         return RX_IGNORE;
     }
-    if (status == PEER_OK)
+    if (status == PEER_ADD)
         log_debug("nan_action: peer added %s", ether_addr_to_string(source_address));
 
-    status = nan_peer_get(&state->peers, source_address, &peer);
-    if (status < 0 || peer == NULL)
-    {
-        log_warn("nan_action: could not get peer: %s (%d)", ether_addr_to_string(source_address), status);
-        return RX_IGNORE;
-    }
-
     if (action_frame->oui_type == NAN_OUT_TYPE_SERVICE_DISCOVERY)
     {
         // service discovery frame is just one byte shorter than action frame
@@ -547,21 +571,58 @@ int nan_rx_action(struct buf *frame, struct nan_state *state,
               nan_action_frame_subtype_to_string(action_frame->oui_subtype),
               ether_addr_to_string(source_address));
 
+    // NAFs were accepted without looking at their attributes, an attribute that cannot be parsed
+    // or trailing bytes therefore do not reject the frame, the peer has been updated already
+    int result = nan_rx_attributes(frame, &state->attribute_dispatch, NAN_FRAME_ACTION, peer);
+    if (result < 0)
+        log_debug("nan_action: ignoring attributes from %s: %d", ether_addr_to_string(source_address), result);
+
     return RX_OK;
 }
 
-int nan_rx(struct buf *frame, struct nan_state *state)
+/**
+ * Estimate the TSF of the interface at the arrival of a frame without radiotap TSFT.
+ * The TSF can only be read while processing, so it is moved back by the time since capture.
+ *
+ * @param clock The clock of the NAN state
+ * @param now_usec The current time of the clock
+ * @param rx_time_usec The capture time of the frame, or 0 if not known
+ * @returns The TSF at arrival, the current TSF without capture time, or 0 without TSF source
+ */
+static uint64_t nan_rx_fallback_tsft(const struct nan_clock *clock, uint64_t now_usec, uint64_t rx_time_usec)
+{
+    uint64_t tsf = nan_clock_tsf_usec(clock);
+    if (tsf == 0 || rx_time_usec == 0 || rx_time_usec > now_usec)
+        return tsf;
+
+    uint64_t age_usec = now_usec - rx_time_usec;
+    return tsf > age_usec ? tsf - age_usec : 0;
+}
+
+int nan_rx(struct buf *frame, struct nan_state *state, uint64_t rx_time_usec)
 {
     signed char rssi;
     uint8_t flags;
+    uint64_t tsft = 0;
 
-    uint64_t now_usec = clock_time_usec();
-    if (ieee80211_parse_radiotap_header(frame, &rssi, &flags, NULL /*&now_usec*/) < 0)
+    // Everything allocated while parsing the previous frame is released at once
+    arena_reset(&state->rx_arena);
+
+    if (ieee80211_parse_radiotap_header_cached(&state->ieee80211.radiotap_cache, frame,
+                                               &rssi, &flags, &tsft) < 0)
     {
         log_trace("radiotap: cannot parse header");
         return RX_UNEXPECTED_FORMAT;
     }
 
+    uint64_t clock_usec = nan_clock_now_usec(&state->clock);
+
+    // Without a TSFT in the radiotap header, fall back to the TSF of the interface if known
+    if (tsft == 0)
+        tsft = nan_rx_fallback_tsft(&state->clock, clock_usec, rx_time_usec);
+
+    uint64_t now_usec = nan_timestamp_frame(&state->timestamp, clock_usec, rx_time_usec, tsft);
+
     if (ieee80211_parse_fcs(frame, flags) < 0)
     {
         log_trace("CRC failed");
@@ -583,19 +644,42 @@ int nan_rx(struct buf *frame, struct nan_state *state)
     if (ether_addr_equal(source_address, &state->self_address))
         return RX_IGNORE_FROM_SELF;
 
+    uint16_t seq_ctrl = le16toh(ieee80211->seq_ctrl);
+    uint16_t length = buf_rest(frame);
+
+    // Retransmissions and frames captured more than once must not be processed twice
+    struct nan_peer *peer = NULL;
+    if (nan_peer_get(&state->peers, source_address, &peer) == PEER_OK &&
+        nan_peer_is_duplicate_frame(peer, seq_ctrl, frame_control, length, now_usec))
+    {
+        log_trace("ieee80211: duplicate frame %u from %s", seq_ctrl >> 4,
+                  ether_addr_to_string(source_address));
+        state->rx_duplicates++;
+        return RX_IGNORE_DUPLICATE;
+    }
+
     if (buf_advance(frame, sizeof(struct ieee80211_hdr)) < 0)
         return RX_TOO_SHORT;
 
+    int result;
     switch (frame_control & (IEEE80211_FCTL_FTYPE | IEEE80211_FCTL_STYPE))
     {
     case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON:
-        return nan_rx_beacon(frame, state, source_address, cluster_id, rssi, now_usec);
+        result = nan_rx_beacon(frame, state, source_address, cluster_id, rssi, now_usec);
+        break;
     case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_ACTION:
         log_trace("Received action frame");
-        return nan_rx_action(frame, state, source_address, destination_address, cluster_id, now_usec);
+        result = nan_rx_action(frame, state, source_address, destination_address, cluster_id, now_usec);
+        break;
     default:
         log_trace("ieee80211: cannot handle type %x and subtype %x of received frame from %s",
                   frame_control & IEEE80211_FCTL_FTYPE, frame_control & IEEE80211_FCTL_STYPE, ether_addr_to_string(source_address));
         return RX_UNEXPECTED_TYPE;
     }
+
+    // The peer might have been added or removed while handling the frame
+    if (nan_peer_get(&state->peers, source_address, &peer) == PEER_OK)
+        nan_peer_add_recent_frame(peer, seq_ctrl, frame_control, length, now_usec);
+
+    return result;
 }
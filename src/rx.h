@@ -7,9 +7,11 @@
 #include "wire.h"
 #include "attributes.h"
 #include "service.h"
+#include "dispatch.h"
 
 enum RX_RESULT
 {
+    RX_IGNORE_DUPLICATE = 9,
     RX_IGNORE_SYNC_OUTSIDE_DW = 8,
     RX_IGNORE_OUI = 7,
     RX_IGNORE_PEER = 6,
@@ -28,10 +30,44 @@ enum RX_RESULT
     RX_OTHER_ERROR = -7,
 };
 
-typedef int (*nan_parse_attribute)(struct buf *frame, void *data);
+/**
+ * View on a single NAN attribute of a received frame.
+ * The data buffer only references the frame, so a view can live on the stack
+ * and must not be passed to buf_free.
+ */
+struct nan_attribute_view
+{
+    uint8_t id;
+    uint16_t length;
+    struct buf data;
+};
+
+/**
+ * Read the next attribute from the frame without allocating
+ *
+ * @param frame The frame buffer pointing to the start of a NAN attribute
+ * @param attribute The view that will be set to the parsed attribute
+ * @returns The number of bytes consumed, 0 if no attributes are left or RX_TOO_SHORT
+ */
+int nan_attribute_next(struct buf *frame, struct nan_attribute_view *attribute);
 
 const char *nan_rx_result_to_string(const int result);
 
-int nan_rx(struct buf *frame, struct nan_state *state);
+/**
+ * Register the parsers for all attributes handled by this module.
+ *
+ * @param dispatch - The dispatch table to register the parsers in
+ */
+void nan_rx_register_default_handlers(struct nan_attribute_dispatch *dispatch);
+
+/**
+ * Handle a received frame.
+ *
+ * @param frame - The frame including its radiotap header
+ * @param state - The current state
+ * @param rx_time_usec - Kernel receive timestamp in microseconds of the state's clock, or 0 if not known
+ * @returns A RX_RESULT
+ */
+int nan_rx(struct buf *frame, struct nan_state *state, uint64_t rx_time_usec);
 
 #endif // NAN_RX_H_
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "schedule.h"
+
+#include <inttypes.h>
+
+#include "ieee80211.h"
+#include "log.h"
+
+// Slot time, DIFS and half the minimum contention window of DSSS rates
+#define DSSS_ACCESS_USEC (50 + 31 * 20 / 2)
+// Long preamble and PLCP header
+#define DSSS_PREAMBLE_USEC 192
+// Short slot time, DIFS and half the minimum contention window of OFDM rates
+#define OFDM_ACCESS_USEC (28 + 15 * 9 / 2)
+// Preamble, SIGNAL field and signal extension on 2.4 GHz
+#define OFDM_PREAMBLE_USEC (20 + 6)
+// SERVICE field and tail bits
+#define OFDM_OVERHEAD_BITS (16 + 6)
+
+#define NAN_TX_FRAMES_CHUNK_SIZE 8
+
+static bool is_dsss_rate(int rate)
+{
+    return rate == 2 || rate == 4 || rate == 11 || rate == 22;
+}
+
+void nan_tx_schedule_init(struct nan_tx_schedule *schedule)
+{
+    for (int i = 0; i < NAN_TX_PRIORITIES; i++)
+    {
+        schedule->queues[i].head = NULL;
+        schedule->queues[i].tail = NULL;
+        schedule->queues[i].length = 0;
+    }
+    slab_init(&schedule->frames, sizeof(struct nan_tx_frame), NAN_TX_FRAMES_CHUNK_SIZE,
+              NAN_TX_SCHEDULE_MAX_FRAMES);
+
+    schedule->window_end_usec = 0;
+    schedule->window_next_usec = 0;
+
+    schedule->sent = 0;
+    schedule->deferred = 0;
+    schedule->expired = 0;
+    schedule->dropped = 0;
+    schedule->oversize = 0;
+    schedule->coalesced = 0;
+}
+
+static struct nan_tx_frame *nan_tx_queue_pop(struct nan_tx_queue *queue)
+{
+    struct nan_tx_frame *frame = queue->head;
+    if (frame == NULL)
+        return NULL;
+
+    queue->head = frame->next;
+    if (queue->head == NULL)
+        queue->tail = NULL;
+    queue->length--;
+
+    return frame;
+}
+
+void nan_tx_schedule_free(struct nan_tx_schedule *schedule)
+{
+    for (int i = 0; i < NAN_TX_PRIORITIES; i++)
+    {
+        struct nan_tx_frame *frame;
+        while ((frame = nan_tx_queue_pop(&schedule->queues[i])) != NULL)
+            buf_free(frame->buf);
+    }
+    slab_free(&schedule->frames);
+}
+
+uint64_t nan_tx_airtime_usec(const uint8_t *frame, size_t length, bool fcs)
+{
+    size_t radiotap_length = length >= 4 ? (size_t)(frame[2] | frame[3] << 8) : 0;
+    size_t psdu_length = length > radiotap_length ? length - radiotap_length : 0;
+    if (!fcs)
+        psdu_length += FCS_LEN;
+
+    const int rate = IEEE80211_TX_RATE;
+    if (is_dsss_rate(rate))
+        return DSSS_ACCESS_USEC + DSSS_PREAMBLE_USEC + (psdu_length * 8 * 2 + rate - 1) / rate;
+
+    uint64_t bits_per_symbol = (uint64_t)rate * 2;
+    uint64_t symbols = (OFDM_OVERHEAD_BITS + psdu_length * 8 + bits_per_symbol - 1) / bits_per_symbol;
+    return OFDM_ACCESS_USEC + OFDM_PREAMBLE_USEC + symbols * 4;
+}
+
+int nan_tx_schedule_enqueue(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                            struct buf *buf, uint64_t airtime_usec, uint64_t deadline_usec)
+{
+    struct nan_tx_frame *frame = slab_alloc(&schedule->frames);
+    if (frame == NULL)
+    {
+        schedule->dropped++;
+        return -1;
+    }
+
+    frame->next = NULL;
+    frame->buf = buf;
+    frame->airtime_usec = airtime_usec;
+    frame->deadline_usec = deadline_usec;
+
+    struct nan_tx_queue *queue = &schedule->queues[priority];
+    if (queue->tail == NULL)
+        queue->head = frame;
+    else
+        queue->tail->next = frame;
+    queue->tail = frame;
+    queue->length++;
+
+    return 0;
+}
+
+size_t nan_tx_schedule_length(const struct nan_tx_schedule *schedule, enum nan_tx_priority priority)
+{
+    return schedule->queues[priority].length;
+}
+
+struct nan_tx_frame *nan_tx_schedule_find_last(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                                               nan_tx_frame_matches matches, const void *data)
+{
+    // The queue is only linked forwards and short, remember the last match
+    struct nan_tx_frame *found = NULL;
+    for (struct nan_tx_frame *frame = schedule->queues[priority].head; frame != NULL; frame = frame->next)
+        if (matches(frame->buf, data))
+            found = frame;
+
+    return found;
+}
+
+void nan_tx_schedule_replace(struct nan_tx_schedule *schedule, struct nan_tx_frame *frame,
+                             struct buf *buf, uint64_t airtime_usec)
+{
+    buf_free(frame->buf);
+    frame->buf = buf;
+    frame->airtime_usec = airtime_usec;
+    schedule->coalesced++;
+}
+
+void nan_tx_window_open(struct nan_tx_schedule *schedule, uint64_t now_usec, uint64_t end_usec)
+{
+    schedule->window_next_usec = now_usec;
+    schedule->window_end_usec = end_usec;
+}
+
+static bool nan_tx_window_fits(const struct nan_tx_schedule *schedule, uint64_t airtime_usec)
+{
+    if (airtime_usec > NAN_TX_MAX_AIRTIME_USEC)
+        return schedule->window_next_usec < schedule->window_end_usec;
+    return schedule->window_next_usec + airtime_usec <= schedule->window_end_usec;
+}
+
+static void nan_tx_window_take(struct nan_tx_schedule *schedule, uint64_t airtime_usec)
+{
+    if (airtime_usec > NAN_TX_MAX_AIRTIME_USEC && schedule->oversize++ == 0)
+        log_warn("Frame of %" PRIu64 " us airtime is longer than a discovery window, sending it anyway",
+                 airtime_usec);
+
+    schedule->window_next_usec += airtime_usec;
+    schedule->sent++;
+}
+
+bool nan_tx_window_reserve(struct nan_tx_schedule *schedule, uint64_t airtime_usec)
+{
+    if (!nan_tx_window_fits(schedule, airtime_usec))
+    {
+        schedule->deferred++;
+        return false;
+    }
+
+    nan_tx_window_take(schedule, airtime_usec);
+    return true;
+}
+
+struct buf *nan_tx_schedule_next(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                                 uint64_t now_usec)
+{
+    struct nan_tx_queue *queue = &schedule->queues[priority];
+
+    while (queue->head != NULL)
+    {
+        struct nan_tx_frame *frame = queue->head;
+        if (frame->deadline_usec <= now_usec)
+        {
+            log_debug("Drop expired %s frame", nan_tx_priority_to_string(priority));
+            nan_tx_queue_pop(queue);
+            buf_free(frame->buf);
+            slab_release(&schedule->frames, frame);
+            schedule->expired++;
+            continue;
+        }
+
+        if (!nan_tx_window_fits(schedule, frame->airtime_usec))
+        {
+            log_trace("Defer %zu %s frames to the next window", queue->length, nan_tx_priority_to_string(priority));
+            schedule->deferred += queue->length;
+            return NULL;
+        }
+
+        nan_tx_queue_pop(queue);
+        nan_tx_window_take(schedule, frame->airtime_usec);
+
+        struct buf *buf = frame->buf;
+        slab_release(&schedule->frames, frame);
+        return buf;
+    }
+
+    return NULL;
+}
+
+const char *nan_tx_priority_to_string(enum nan_tx_priority priority)
+{
+    switch (priority)
+    {
+    case NAN_TX_SYNC_BEACON:
+        return "sync beacon";
+    case NAN_TX_FOLLOW_UP:
+        return "follow up";
+    case NAN_TX_SERVICE_DISCOVERY:
+        return "service discovery";
+    case NAN_TX_DISCOVERY_BEACON:
+        return "discovery beacon";
+    default:
+        return "unknown";
+    }
+}
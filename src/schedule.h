@@ -0,0 +1,201 @@
+#ifndef NAN_SCHEDULE_H_
+#define NAN_SCHEDULE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wire.h"
+#include "slab.h"
+#include "timer.h"
+#include "utils.h"
+
+// Maximum number of frames waiting for a transmission window
+#define NAN_TX_SCHEDULE_MAX_FRAMES 16
+// Time after which a queued follow-up is dropped if it could not be sent
+#define NAN_TX_FOLLOW_UP_LIFETIME_USEC TU_TO_USEC(4 * NAN_DW_INTERVAL_TU)
+// Longest airtime of a frame that still fits into an otherwise empty discovery window,
+// at 1 Mbps about 1.9 kB. Longer frames are oversize, see nan_tx_window_reserve.
+#define NAN_TX_MAX_AIRTIME_USEC TU_TO_USEC(NAN_DW_LENGTH_TU)
+
+/**
+ * Transmission priorities, from highest to lowest.
+ * Higher priorities get the airtime of a window first.
+ */
+enum nan_tx_priority
+{
+    NAN_TX_SYNC_BEACON,
+    NAN_TX_FOLLOW_UP,
+    NAN_TX_SERVICE_DISCOVERY,
+    NAN_TX_DISCOVERY_BEACON,
+};
+
+#define NAN_TX_PRIORITIES 4
+
+/**
+ * Selects a queued frame
+ */
+typedef bool (*nan_tx_frame_matches)(struct buf *buf, const void *data);
+
+/**
+ * Frame waiting for a window with enough airtime left
+ */
+struct nan_tx_frame
+{
+    struct nan_tx_frame *next;
+    struct buf *buf;
+    // Estimated time on air including channel access
+    uint64_t airtime_usec;
+    // The frame is dropped if not sent before this time
+    uint64_t deadline_usec;
+};
+
+/**
+ * First in, first out queue of frames of the same priority
+ */
+struct nan_tx_queue
+{
+    struct nan_tx_frame *head;
+    struct nan_tx_frame *tail;
+    size_t length;
+};
+
+/**
+ * Frames to send, ordered by priority, and the airtime left in the current transmission window.
+ * A frame is only handed out if it is estimated to complete before the window ends,
+ * otherwise it stays queued for the next window until its deadline passes.
+ * An oversize frame, which would not fit into any window, is handed out instead of waiting forever
+ * if the window has airtime left, and takes all of it.
+ */
+struct nan_tx_schedule
+{
+    struct nan_tx_queue queues[NAN_TX_PRIORITIES];
+    // Records of queued frames
+    struct slab frames;
+
+    // End of the current window
+    uint64_t window_end_usec;
+    // Estimated time at which the next frame of the window can start
+    uint64_t window_next_usec;
+
+    // Number of frames sent within a window, queued or reserved
+    uint64_t sent;
+    // Number of times a frame was held back because the window had not enough airtime left
+    uint64_t deferred;
+    // Number of queued frames dropped after their deadline
+    uint64_t expired;
+    // Number of frames refused because the queue was full
+    uint64_t dropped;
+    // Number of oversize frames sent, overrunning their window
+    uint64_t oversize;
+    // Number of times a queued frame was replaced by one carrying more content
+    uint64_t coalesced;
+};
+
+/**
+ * Initialize a schedule without an open window.
+ *
+ * @param schedule - The schedule to initialize
+ */
+void nan_tx_schedule_init(struct nan_tx_schedule *schedule);
+
+/**
+ * Free all queued frames and their records.
+ *
+ * @param schedule - The schedule to free
+ */
+void nan_tx_schedule_free(struct nan_tx_schedule *schedule);
+
+/**
+ * Estimate the airtime of an injected frame, including the average time to access the channel.
+ *
+ * @param frame - The frame starting with its radiotap header
+ * @param length - Length of the frame in bytes
+ * @param fcs - Whether the frame already ends with its FCS
+ * @returns The estimated airtime in microseconds
+ */
+uint64_t nan_tx_airtime_usec(const uint8_t *frame, size_t length, bool fcs);
+
+/**
+ * Queue a frame until a window with enough airtime left.
+ *
+ * @param schedule - The schedule
+ * @param priority - The priority of the frame
+ * @param buf - The frame, owned by the schedule on success
+ * @param airtime_usec - The estimated airtime of the frame
+ * @param deadline_usec - The time after which the frame is dropped
+ * @returns 0 on success, -1 if the queue is full
+ */
+int nan_tx_schedule_enqueue(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                            struct buf *buf, uint64_t airtime_usec, uint64_t deadline_usec);
+
+/**
+ * @param schedule - The schedule
+ * @param priority - The priority
+ * @returns The number of frames queued with the given priority
+ */
+size_t nan_tx_schedule_length(const struct nan_tx_schedule *schedule, enum nan_tx_priority priority);
+
+/**
+ * Find the most recently queued frame of a priority that matches.
+ *
+ * @param schedule - The schedule
+ * @param priority - The priority to search
+ * @param matches - Called for every queued frame of the priority
+ * @param data - Passed to matches
+ * @returns The queued frame, owned by the schedule, or NULL if no frame matches
+ */
+struct nan_tx_frame *nan_tx_schedule_find_last(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                                               nan_tx_frame_matches matches, const void *data);
+
+/**
+ * Replace the content of a queued frame, e.g., by a copy with further attributes appended.
+ * The frame keeps its position in the queue and its deadline.
+ *
+ * @param schedule - The schedule
+ * @param frame - The queued frame, as returned by nan_tx_schedule_find_last
+ * @param buf - The new content, owned by the schedule, the old one is freed
+ * @param airtime_usec - The estimated airtime of the new content
+ */
+void nan_tx_schedule_replace(struct nan_tx_schedule *schedule, struct nan_tx_frame *frame,
+                             struct buf *buf, uint64_t airtime_usec);
+
+/**
+ * Start a new transmission window, e.g., a discovery window.
+ *
+ * @param schedule - The schedule
+ * @param now_usec - The current time in microseconds
+ * @param end_usec - The time at which the window ends in microseconds
+ */
+void nan_tx_window_open(struct nan_tx_schedule *schedule, uint64_t now_usec, uint64_t end_usec);
+
+/**
+ * Reserve airtime in the current window for a frame that is sent right away instead of being queued.
+ * An oversize frame gets the rest of the window if any airtime is left, nothing fits after it.
+ *
+ * @param schedule - The schedule
+ * @param airtime_usec - The estimated airtime of the frame
+ * @returns Whether the frame completes before the window ends, nothing is reserved otherwise
+ */
+bool nan_tx_window_reserve(struct nan_tx_schedule *schedule, uint64_t airtime_usec);
+
+/**
+ * Take the next queued frame of a priority that fits into the current window.
+ * Frames whose deadline passed are dropped on the way.
+ * Frames of the same priority are sent in order, so a frame that does not fit holds back the ones behind it.
+ *
+ * @param schedule - The schedule
+ * @param priority - The priority to take the frame from
+ * @param now_usec - The current time in microseconds
+ * @returns The frame, owned by the caller, or NULL if no frame of the priority fits
+ */
+struct buf *nan_tx_schedule_next(struct nan_tx_schedule *schedule, enum nan_tx_priority priority,
+                                 uint64_t now_usec);
+
+/**
+ * @param priority - The priority
+ * @returns The name of the priority
+ */
+const char *nan_tx_priority_to_string(enum nan_tx_priority priority);
+
+#endif // NAN_SCHEDULE_H_
@@ -0,0 +1,45 @@
+#ifndef NAN_SDF_CACHE_H_
+#define NAN_SDF_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/ether.h>
+
+#include "list.h"
+
+/**
+ * State a cached service discovery frame was built from. The frame is rebuilt once any of it changes.
+ */
+struct nan_sdf_cache_key
+{
+    // Generation of the service state
+    uint64_t generation;
+    struct ether_addr interface_address;
+    struct ether_addr destination;
+    struct ether_addr cluster_id;
+    bool fcs;
+};
+
+/**
+ * Service discovery frame announcing the current services, of which only
+ * the sequence number and the FCS change from one transmission to the next.
+ */
+struct nan_sdf_cache
+{
+    uint8_t *data;
+    size_t capacity;
+    // Length of the frame including the FCS if present
+    size_t length;
+    size_t seq_ctrl_offset;
+    // Checksum of the bytes before the sequence control field
+    uint32_t prefix_crc;
+    // Services announced by the frame
+    list_t announced_services;
+    bool valid;
+    struct nan_sdf_cache_key key;
+    // Number of times the frame had to be rebuilt
+    uint64_t rebuilds;
+};
+
+#endif // NAN_SDF_CACHE_H_
@@ -14,6 +14,28 @@ void nan_service_state_init(struct nan_service_state *state)
     state->published_services = list_init();
     state->subscribed_services = list_init();
     state->last_instance_id = 0;
+    state->generation = 0;
+}
+
+static void nan_services_free(list_t services)
+{
+    struct nan_service *service;
+    LIST_FOR_EACH(services, service, {
+        free(service->service_name);
+        free(service->service_specific_info);
+    });
+    list_free(services, true);
+}
+
+void nan_service_state_free(struct nan_service_state *state)
+{
+    nan_services_free(state->published_services);
+    nan_services_free(state->subscribed_services);
+}
+
+static void nan_service_state_changed(struct nan_service_state *state)
+{
+    state->generation++;
 }
 
 struct nan_service *nan_get_service_by_service_id(const struct nan_service_state *state,
@@ -147,6 +169,7 @@ uint8_t nan_publish(struct nan_service_state *state,
     service->parameters.publish.do_publish = false;
 
     list_add(state->published_services, (any_t)service);
+    nan_service_state_changed(state);
     return service->instance_id;
 }
 
@@ -159,7 +182,9 @@ int nan_update_publish(struct nan_service_state *state, const uint8_t publish_id
     if (service)
     {
         service->service_specific_info = realloc(service->service_specific_info, service_specific_info_length);
+        service->service_specific_info_length = service_specific_info_length;
         memcpy(service->service_specific_info, service_specific_info, service_specific_info_length);
+        nan_service_state_changed(state);
         return 0;
     }
 
@@ -174,6 +199,7 @@ int nan_cancel_publish(struct nan_service_state *state, uint8_t publish_id)
     if (service)
     {
         free(service);
+        nan_service_state_changed(state);
         return 0;
     }
     return -1;
@@ -195,6 +221,7 @@ uint8_t nan_subscribe(struct nan_service_state *state,
     service->parameters.subscribe.is_subscribed = false;
 
     list_add(state->subscribed_services, (any_t)service);
+    nan_service_state_changed(state);
     return service->instance_id;
 }
 
@@ -206,6 +233,7 @@ int nan_cancel_subscribe(struct nan_service_state *state, const uint8_t subscrib
     if (service)
     {
         free(service);
+        nan_service_state_changed(state);
         return 0;
     }
 
@@ -254,8 +282,9 @@ void nan_get_services_to_announce(const struct nan_service_state *state, list_t
     });
 }
 
-void nan_update_announced_services(list_t announced_services)
+void nan_update_announced_services(struct nan_service_state *state, list_t announced_services)
 {
+    bool changed = false;
     struct nan_service *service;
     LIST_FOR_EACH(announced_services, service, {
         if (service->time_to_live > 0)
@@ -263,10 +292,15 @@ void nan_update_announced_services(list_t announced_services)
 
         if (service->type == PUBLISHED)
             service->parameters.publish.do_publish = false;
+
+        changed |= !nan_should_announce_service(service);
     });
+
+    if (changed)
+        nan_service_state_changed(state);
 }
 
-void nan_handle_received_service_discovery(const struct nan_service_state *state,
+void nan_handle_received_service_discovery(struct nan_service_state *state,
                                            struct nan_event_state *event_state,
                                            const struct ether_addr *self_address,
                                            const struct ether_addr *source_address,
@@ -306,7 +340,10 @@ void nan_handle_received_service_discovery(const struct nan_service_state *state
             return;
         }
 
+        bool announced = nan_should_announce_service(service);
         service->parameters.publish.do_publish = true;
+        if (!announced)
+            nan_service_state_changed(state);
     }
 
     else if (service_descriptor->control.service_control_type == CONTROL_TYPE_FOLLOW_UP)
@@ -67,6 +67,8 @@ struct nan_service_state
     list_t published_services;
     list_t subscribed_services;
     uint8_t last_instance_id;
+    // Incremented whenever the set or content of the announced services may have changed
+    uint64_t generation;
 };
 
 /**
@@ -76,6 +78,13 @@ struct nan_service_state
  */
 void nan_service_state_init(struct nan_service_state *state);
 
+/**
+ * Free all published and subscribed services.
+ *
+ * @param state - The service state to free
+ */
+void nan_service_state_free(struct nan_service_state *state);
+
 /**
  * Find a matching service by its service id
  * 
@@ -211,11 +220,12 @@ void nan_get_services_to_announce(const struct nan_service_state *state, list_t
 /**
  * Update the services after the transmission of a service discovery frame.
  * 
+ * @param state - The current service state
  * @param announced_services - The list of announced services to update
  */
-void nan_update_announced_services(list_t announced_services);
+void nan_update_announced_services(struct nan_service_state *state, list_t announced_services);
 
-void nan_handle_received_service_discovery(const struct nan_service_state *state,
+void nan_handle_received_service_discovery(struct nan_service_state *state,
                                            struct nan_event_state *event_state,
                                            const struct ether_addr *self_address,
                                            const struct ether_addr *source_address,
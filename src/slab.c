@@ -0,0 +1,101 @@
+#include "slab.h"
+
+#include <stdlib.h>
+
+struct slab_chunk
+{
+    struct slab_chunk *next;
+    uint8_t data[] __attribute__((aligned(SLAB_ALIGNMENT)));
+};
+
+static size_t slab_align(size_t size)
+{
+    return (size + SLAB_ALIGNMENT - 1) & ~(SLAB_ALIGNMENT - 1);
+}
+
+static int slab_grow(struct slab *slab)
+{
+    size_t count = slab->chunk_objects;
+    if (slab->max_objects > 0 && slab->capacity + count > slab->max_objects)
+        count = slab->max_objects - slab->capacity;
+
+    struct slab_chunk *chunk = malloc(sizeof(struct slab_chunk) + count * slab->object_size);
+    if (chunk == NULL)
+        return -1;
+
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+    slab->capacity += count;
+
+    // Link in reverse, so that objects are handed out in address order
+    for (size_t i = count; i > 0; i--)
+    {
+        void **object = (void **)(chunk->data + (i - 1) * slab->object_size);
+        *object = slab->free_list;
+        slab->free_list = object;
+    }
+    return 0;
+}
+
+void slab_init(struct slab *slab, size_t object_size, size_t chunk_objects, size_t max_objects)
+{
+    slab->chunks = NULL;
+    slab->free_list = NULL;
+    slab->object_size = slab_align(object_size > sizeof(void *) ? object_size : sizeof(void *));
+    slab->chunk_objects = chunk_objects > 0 ? chunk_objects : 1;
+    slab->max_objects = max_objects;
+
+    slab->capacity = 0;
+    slab->used = 0;
+    slab->high_water = 0;
+    slab->failed = 0;
+}
+
+bool slab_full(const struct slab *slab)
+{
+    return slab->max_objects > 0 && slab->used >= slab->max_objects;
+}
+
+void *slab_alloc(struct slab *slab)
+{
+    if (slab_full(slab) || (slab->free_list == NULL && slab_grow(slab) < 0))
+    {
+        slab->failed++;
+        return NULL;
+    }
+
+    void **object = slab->free_list;
+    slab->free_list = *object;
+
+    slab->used++;
+    if (slab->used > slab->high_water)
+        slab->high_water = slab->used;
+
+    return object;
+}
+
+void slab_release(struct slab *slab, void *object)
+{
+    if (object == NULL)
+        return;
+
+    *(void **)object = slab->free_list;
+    slab->free_list = object;
+    slab->used--;
+}
+
+void slab_free(struct slab *slab)
+{
+    struct slab_chunk *chunk = slab->chunks;
+    while (chunk != NULL)
+    {
+        struct slab_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    slab->chunks = NULL;
+    slab->free_list = NULL;
+    slab->capacity = 0;
+    slab->used = 0;
+}
@@ -0,0 +1,83 @@
+#ifndef NAN_SLAB_H_
+#define NAN_SLAB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Alignment of all objects returned by the slab
+ */
+#define SLAB_ALIGNMENT (2 * sizeof(void *))
+
+struct slab_chunk;
+
+/**
+ * Pool of fixed-size objects for records that are allocated and released frequently.
+ * Objects are carved out of larger chunks and recycled through a free list.
+ * Chunks are only handed back to the system when the slab itself is freed,
+ * so objects never move and freeing an object never touches the heap.
+ */
+struct slab
+{
+    // Chunks objects are taken from
+    struct slab_chunk *chunks;
+    // Released objects, linked through their first bytes
+    void *free_list;
+    // Size of a single object including padding for alignment
+    size_t object_size;
+    // Number of objects allocated at once when the free list is empty
+    size_t chunk_objects;
+    // Maximum number of objects in use, 0 for no limit
+    size_t max_objects;
+
+    // Number of objects in all chunks
+    size_t capacity;
+    // Number of objects currently in use
+    size_t used;
+    // Highest number of objects in use at the same time
+    size_t high_water;
+    // Number of allocations refused because of the limit or a failed chunk allocation
+    uint64_t failed;
+};
+
+/**
+ * Initialize a slab. Does not allocate until the first call to slab_alloc.
+ *
+ * @param slab - The slab to initialize
+ * @param object_size - Size of a single object in bytes
+ * @param chunk_objects - Number of objects allocated at once
+ * @param max_objects - Maximum number of objects in use, 0 for no limit
+ */
+void slab_init(struct slab *slab, size_t object_size, size_t chunk_objects, size_t max_objects);
+
+/**
+ * Take an object from the slab. The content of the object is undefined.
+ *
+ * @param slab - The slab to allocate from
+ * @returns Pointer to the object or NULL if the limit is reached or a new chunk could not be allocated
+ */
+void *slab_alloc(struct slab *slab);
+
+/**
+ * Return an object to the slab.
+ *
+ * @param slab - The slab the object was allocated from
+ * @param object - The object to release, may be NULL
+ */
+void slab_release(struct slab *slab, void *object);
+
+/**
+ * @param slab - The slab
+ * @returns Whether the limit of objects in use is reached
+ */
+bool slab_full(const struct slab *slab);
+
+/**
+ * Free all memory held by the slab, including objects still in use.
+ *
+ * @param slab - The slab to free
+ */
+void slab_free(struct slab *slab);
+
+#endif // NAN_SLAB_H_
@@ -1,7 +1,10 @@
 #include "state.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "rx.h"
+
 void init_nan_state(struct nan_state *state, const char *hostname,
                     struct ether_addr *addr, int channel, uint64_t now_usec)
 {
@@ -9,7 +12,8 @@ void init_nan_state(struct nan_state *state, const char *hostname,
     state->self_address = *addr;
     state->interface_address = *addr;
 
-    state->buffer = circular_buf_init(16);
+    nan_tx_schedule_init(&state->tx_schedule);
+    buf_pool_init(&state->tx_pool);
 
     nan_channel_state_init(&state->channel, channel);
     nan_cluster_state_init(&state->cluster);
@@ -19,4 +23,27 @@ void init_nan_state(struct nan_state *state, const char *hostname,
     nan_event_state_init(&state->events);
     nan_service_state_init(&state->services);
     ieee80211_init_state(&state->ieee80211);
+    arena_init(&state->rx_arena, ARENA_DEFAULT_CHUNK_SIZE);
+    nan_attribute_dispatch_init(&state->attribute_dispatch);
+    nan_rx_register_default_handlers(&state->attribute_dispatch);
+    nan_clock_init_real(&state->clock);
+    nan_timestamp_state_init(&state->timestamp, TIMESTAMP_SOURCE_CLOCK);
+    state->rx_duplicates = 0;
+    state->rx_peer_limit = 0;
+    memset(&state->beacon_templates, 0, sizeof(state->beacon_templates));
+    memset(&state->sdf_cache, 0, sizeof(state->sdf_cache));
+    state->sdf_cache.announced_services = list_init();
+}
+
+void free_nan_state(struct nan_state *state)
+{
+    nan_tx_schedule_free(&state->tx_schedule);
+    buf_pool_free(&state->tx_pool);
+    nan_peer_state_free(&state->peers);
+    nan_timer_state_free(&state->timer);
+    nan_event_state_free(&state->events);
+    nan_service_state_free(&state->services);
+    arena_free(&state->rx_arena);
+    free(state->sdf_cache.data);
+    list_free(state->sdf_cache.announced_services, false);
 }
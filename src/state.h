@@ -12,8 +12,15 @@
 #include "channel.h"
 #include "event.h"
 #include "service.h"
-#include "circular_buffer.h"
+#include "schedule.h"
 #include "sync.h"
+#include "arena.h"
+#include "dispatch.h"
+#include "timestamp.h"
+#include "clock.h"
+#include "beacon_template.h"
+#include "buf_pool.h"
+#include "sdf_cache.h"
 
 struct nan_state
 {
@@ -23,8 +30,10 @@ struct nan_state
     struct ether_addr self_address;
     // The current ethernet address of the interface
     struct ether_addr interface_address;
-    // Buffer for outgoing frames
-    circular_buf_t buffer;
+    // Outgoing frames waiting for a discovery window
+    struct nan_tx_schedule tx_schedule;
+    // Recycled buffers outgoing frames are built in
+    struct buf_pool tx_pool;
 
     // Information about used channels
     struct nan_channel_state channel;
@@ -42,10 +51,27 @@ struct nan_state
     struct nan_service_state services;
     // Needed information for IEEE 802.11 frames
     struct ieee80211_state ieee80211;
+    // Scratch memory for parsing a received frame, reset per frame
+    struct arena rx_arena;
+    // Parsers for received attributes per frame type
+    struct nan_attribute_dispatch attribute_dispatch;
+    // Source of the current time
+    struct nan_clock clock;
+    // Arrival time of received frames
+    struct nan_timestamp_state timestamp;
+    // Number of received frames dropped as duplicates
+    uint64_t rx_duplicates;
+    // Number of received frames ignored because their sender could not be added within the peer limit
+    uint64_t rx_peer_limit;
+    // Prebuilt beacons patched before each transmission
+    struct nan_beacon_templates beacon_templates;
+    // Last service discovery frame, reused while the announced services stay the same
+    struct nan_sdf_cache sdf_cache;
 };
 
 /** 
  * Initializes the state according to the specs.
+ * The state uses the host clock, which may be replaced afterwards.
  * 
  * @param state - The state to initialize
  * @param hostname - The hostname of the device
@@ -55,4 +81,11 @@ struct nan_state
 void init_nan_state(struct nan_state *state, const char *hostname,
                     struct ether_addr *addr, int channel, uint64_t now_usec);
 
+/**
+ * Free everything allocated by the state, e.g., peers, services and queued frames.
+ *
+ * @param state - The state to free
+ */
+void free_nan_state(struct nan_state *state);
+
 #endif //NAN_STATE_H_
@@ -103,56 +103,16 @@ void nan_check_master_candidate(const struct nan_sync_state *state, struct nan_p
         peer->master_candidate = true;
 }
 
-void nan_master_election(struct nan_sync_state *state, const list_t peers, const uint64_t now_usec)
+void nan_master_election(struct nan_sync_state *state, struct nan_peer_state *peers, const uint64_t now_usec)
 {
-    struct nan_peer *peer;
-    int count_higher_mr = 0;
-    int count_rssi_close = 0;
-    int count_rssi_middle = 0;
-    int count_rssi_close_higher_mr = 0;
-    int count_rssi_close_master_candidate = 0;
-    int count_rssi_middle_higher_mr = 0;
-    int count_rssi_middle_master_candidate = 0;
-
-    LIST_FOR_EACH(peers, peer, {
-        uint64_t peer_master_rank = nan_get_peer_master_rank(peer);
-
-        // Asume currently at the end of a DW
-        // Check if last update was in the current DW plus 4 TU guard
-        log_debug("%d", USEC_TO_TU(now_usec - peer->last_update));
-        if (now_usec - peer->last_update > TU_TO_USEC(NAN_DW_LENGTH_TU + 4)) 
-            continue;
-
-        if (peer->rssi_average > RSSI_CLOSE)
-        {
-            count_rssi_close++;
-
-            if (peer_master_rank > state->master_rank)
-                count_rssi_close_higher_mr++;
-
-            if (peer->master_candidate)
-                count_rssi_close_master_candidate++;
-        }
-
-        if (peer->rssi_average > RSSI_MIDDLE)
-        {
-            count_rssi_middle++;
-
-            if (peer_master_rank > state->master_rank)
-                count_rssi_middle_higher_mr++;
-
-            if (peer->master_candidate)
-                count_rssi_middle_master_candidate++;
-        }
-
-        if (peer_master_rank > state->master_rank)
-            count_higher_mr++;
-    })
+    // Asume currently at the end of a DW
+    const struct nan_election_counters *counters = nan_peer_election_counters(
+        peers, state->master_rank, now_usec, NAN_MASTER_ELECTION_WINDOW_USEC);
 
     if (state->role == MASTER)
     {
         // master -> sync
-        if (count_rssi_close_higher_mr >= 1 || count_rssi_middle_higher_mr >= 3)
+        if (counters->count_rssi_close_higher_mr >= 1 || counters->count_rssi_middle_higher_mr >= 3)
         {
             log_debug("master election: transition from master to sync");
             state->role = SYNC;
@@ -161,7 +121,7 @@ void nan_master_election(struct nan_sync_state *state, const list_t peers, const
     else
     {
         // non-master -> master
-        if (count_rssi_close == 0 && count_higher_mr > 0)
+        if (counters->count_rssi_close == 0 && counters->count_higher_mr > 0)
         {
             log_debug("master election: transition from non-master to master");
             state->role = MASTER;
@@ -171,8 +131,8 @@ void nan_master_election(struct nan_sync_state *state, const list_t peers, const
     if (state->role == SYNC)
     {
         // sync -> non-sync
-        if (count_rssi_close_master_candidate >= 1 ||
-            count_rssi_middle_master_candidate >= 3)
+        if (counters->count_rssi_close_master_candidate >= 1 ||
+            counters->count_rssi_middle_master_candidate >= 3)
         {
             log_debug("master election: transition from sync to non-sync");
             state->role = NON_SYNC;
@@ -181,7 +141,7 @@ void nan_master_election(struct nan_sync_state *state, const list_t peers, const
     else
     {
         // non-sync -> sync
-        if (count_rssi_close_master_candidate == 0 && count_rssi_middle_master_candidate < 3)
+        if (counters->count_rssi_close_master_candidate == 0 && counters->count_rssi_middle_master_candidate < 3)
         {
             log_debug("master election: transition from non-sync to sync");
             state->role = SYNC;
@@ -8,10 +8,13 @@
 #include "timer.h"
 #include "list.h"
 #include "peer.h"
+#include "utils.h"
 
 #define NAN_MASTER_PREFERENCE_UPDATE_MIN_DW 240
 #define NAN_RANDOM_FACTOR_UPDATE_MIN_DW 120
 #define NAN_RANDOM_FACTOR_UPDATE_MAX_DW 240
+// Peers count in the master election if updated within the current DW plus 4 TU guard
+#define NAN_MASTER_ELECTION_WINDOW_USEC (TU_TO_USEC(NAN_DW_LENGTH_TU + 4))
 
 #ifndef NAN_MASTER_PREFERENCE
 #define NAN_MASTER_PREFERENCE 200;
@@ -103,10 +106,10 @@ void nan_check_master_candidate(const struct nan_sync_state *state, struct nan_p
  * Perform master election
  * 
  * @param state - The current sync state
- * @param peers - The list of known peers
+ * @param peers - The current peer state
  * @param now_usec - The current time in microseconds
  */
-void nan_master_election(struct nan_sync_state *state, const list_t peers, const uint64_t now_usec);
+void nan_master_election(struct nan_sync_state *state, struct nan_peer_state *peers, const uint64_t now_usec);
 
 /**
  * Get the address of the peer that has issued the master rank
@@ -17,6 +17,11 @@ void nan_timer_state_init(struct nan_timer_state *state, const uint64_t now_usec
     moving_average_init(state->average_error_state, state->average_error, int, 32);
 }
 
+void nan_timer_state_free(struct nan_timer_state *state)
+{
+    free(state->average_error_state.buffer);
+}
+
 void nan_timer_set_now_usec(struct nan_timer_state *state, uint64_t now_usec)
 {
     state->now_usec = now_usec;
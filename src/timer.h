@@ -42,6 +42,13 @@ struct nan_timer_state
  */
 void nan_timer_state_init(struct nan_timer_state *state, const uint64_t now_usec);
 
+/**
+ * Free the timer state.
+ *
+ * @param state - The timer state to free
+ */
+void nan_timer_state_free(struct nan_timer_state *state);
+
 /**
  * Get the synchronized time value in microseconds.
  * 
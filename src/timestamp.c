@@ -0,0 +1,149 @@
+#include "timestamp.h"
+
+#include <math.h>
+#include <string.h>
+
+void nan_timestamp_state_init(struct nan_timestamp_state *state, enum nan_timestamp_source source)
+{
+    memset(state, 0, sizeof(struct nan_timestamp_state));
+    state->source = source;
+}
+
+static void nan_timestamp_stats_add(struct nan_timestamp_stats *stats, double value)
+{
+    stats->count++;
+    double delta = value - stats->mean;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (value - stats->mean);
+}
+
+double nan_timestamp_stats_mean(const struct nan_timestamp_stats *stats)
+{
+    return stats->mean;
+}
+
+double nan_timestamp_stats_stddev(const struct nan_timestamp_stats *stats)
+{
+    if (stats->count < 2)
+        return 0;
+    return sqrt(stats->m2 / (stats->count - 1));
+}
+
+/**
+ * Map the TSFT of the interface to the host clock.
+ * The offset between both clocks is the minimum over recent frames, i.e. the one
+ * with the least delay between reception and the host timestamp.
+ */
+static uint64_t nan_timestamp_map_tsft(struct nan_timestamp_state *state, uint64_t host_usec, uint64_t tsft_usec)
+{
+    int64_t offset = (int64_t)(host_usec - tsft_usec);
+
+    if (!state->tsft_offset_valid || host_usec - state->tsft_window_start_usec > NAN_TIMESTAMP_TSFT_WINDOW_USEC)
+    {
+        state->tsft_offset_usec[1] = state->tsft_offset_valid ? state->tsft_offset_usec[0] : offset;
+        state->tsft_offset_usec[0] = offset;
+        state->tsft_window_start_usec = host_usec;
+        state->tsft_offset_valid = true;
+    }
+    else if (offset < state->tsft_offset_usec[0])
+    {
+        state->tsft_offset_usec[0] = offset;
+    }
+
+    int64_t min_offset = state->tsft_offset_usec[0] < state->tsft_offset_usec[1]
+                             ? state->tsft_offset_usec[0]
+                             : state->tsft_offset_usec[1];
+
+    // The TSF jumped backwards, e.g. after the interface was reset
+    if (offset - min_offset > NAN_TIMESTAMP_TSFT_WINDOW_USEC)
+    {
+        state->tsft_offset_usec[0] = state->tsft_offset_usec[1] = offset;
+        state->tsft_window_start_usec = host_usec;
+        min_offset = offset;
+    }
+
+    return tsft_usec + min_offset;
+}
+
+uint64_t nan_timestamp_frame(struct nan_timestamp_state *state, uint64_t now_usec,
+                             uint64_t kernel_usec, uint64_t tsft_usec)
+{
+    struct nan_timestamp_sample *sample = &state->sample;
+
+    sample->time_usec[TIMESTAMP_SOURCE_CLOCK] = now_usec;
+    sample->available[TIMESTAMP_SOURCE_CLOCK] = true;
+
+    sample->time_usec[TIMESTAMP_SOURCE_KERNEL] = kernel_usec;
+    sample->available[TIMESTAMP_SOURCE_KERNEL] = kernel_usec > 0 && kernel_usec <= now_usec;
+
+    sample->available[TIMESTAMP_SOURCE_TSFT] = tsft_usec > 0;
+    if (sample->available[TIMESTAMP_SOURCE_TSFT])
+    {
+        uint64_t host_usec = sample->available[TIMESTAMP_SOURCE_KERNEL] ? kernel_usec : now_usec;
+        sample->time_usec[TIMESTAMP_SOURCE_TSFT] = nan_timestamp_map_tsft(state, host_usec, tsft_usec);
+    }
+
+    for (int source = 0; source < TIMESTAMP_SOURCE_COUNT; source++)
+    {
+        if (sample->available[source])
+            nan_timestamp_stats_add(&state->delay[source],
+                                    (double)(int64_t)(now_usec - sample->time_usec[source]));
+    }
+
+    for (int source = state->source; source >= 0; source--)
+    {
+        if (sample->available[source])
+            return sample->time_usec[source];
+    }
+    return now_usec;
+}
+
+void nan_timestamp_beacon(struct nan_timestamp_state *state, struct nan_timestamp_peer *peer,
+                          uint64_t beacon_timestamp)
+{
+    const struct nan_timestamp_sample *sample = &state->sample;
+    uint64_t now_usec = sample->time_usec[TIMESTAMP_SOURCE_CLOCK];
+    bool recent = now_usec - peer->time_usec < NAN_TIMESTAMP_JITTER_MAX_INTERVAL_USEC;
+
+    for (int source = 0; source < TIMESTAMP_SOURCE_COUNT; source++)
+    {
+        if (!sample->available[source])
+        {
+            peer->available[source] = false;
+            continue;
+        }
+
+        int64_t offset = (int64_t)(sample->time_usec[source] - beacon_timestamp);
+        if (recent && peer->available[source])
+            nan_timestamp_stats_add(&state->jitter[source], (double)(offset - peer->offset_usec[source]));
+
+        peer->offset_usec[source] = offset;
+        peer->available[source] = true;
+    }
+    peer->time_usec = now_usec;
+}
+
+const char *nan_timestamp_source_to_string(enum nan_timestamp_source source)
+{
+    switch (source)
+    {
+    case TIMESTAMP_SOURCE_CLOCK:
+        return "clock";
+    case TIMESTAMP_SOURCE_KERNEL:
+        return "kernel";
+    case TIMESTAMP_SOURCE_TSFT:
+        return "tsft";
+    default:
+        return "unknown";
+    }
+}
+
+int nan_timestamp_source_from_string(const char *name)
+{
+    for (int source = 0; source < TIMESTAMP_SOURCE_COUNT; source++)
+    {
+        if (strcmp(name, nan_timestamp_source_to_string(source)) == 0)
+            return source;
+    }
+    return -1;
+}
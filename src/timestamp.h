@@ -0,0 +1,123 @@
+#ifndef NAN_TIMESTAMP_H_
+#define NAN_TIMESTAMP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Length of the window over which the minimal offset between TSFT and host clock is taken
+ */
+#define NAN_TIMESTAMP_TSFT_WINDOW_USEC 1000000
+
+/**
+ * Maximal time between two beacons of a peer that are compared for the jitter
+ */
+#define NAN_TIMESTAMP_JITTER_MAX_INTERVAL_USEC 1000000
+
+/**
+ * Sources for the arrival time of a received frame
+ */
+enum nan_timestamp_source
+{
+    // Host clock when the frame is processed in user space
+    TIMESTAMP_SOURCE_CLOCK,
+    // Kernel receive timestamp of the capture socket
+    TIMESTAMP_SOURCE_KERNEL,
+    // Radiotap TSFT of the wireless interface mapped to the host clock
+    TIMESTAMP_SOURCE_TSFT,
+    TIMESTAMP_SOURCE_COUNT,
+};
+
+/**
+ * Running mean and variance (Welford) of a series of samples
+ */
+struct nan_timestamp_stats
+{
+    uint64_t count;
+    double mean;
+    double m2;
+};
+
+/**
+ * Arrival time of the current frame according to each available source
+ */
+struct nan_timestamp_sample
+{
+    uint64_t time_usec[TIMESTAMP_SOURCE_COUNT];
+    bool available[TIMESTAMP_SOURCE_COUNT];
+};
+
+/**
+ * Offsets between the arrival time and the peer's timestamp of the last beacon of a peer
+ */
+struct nan_timestamp_peer
+{
+    int64_t offset_usec[TIMESTAMP_SOURCE_COUNT];
+    bool available[TIMESTAMP_SOURCE_COUNT];
+    uint64_t time_usec;
+};
+
+struct nan_timestamp_state
+{
+    // Source used for the arrival time if available
+    enum nan_timestamp_source source;
+    // Arrival times of the frame currently processed
+    struct nan_timestamp_sample sample;
+
+    // Minimal offset between host clock and TSFT in the current and last window
+    int64_t tsft_offset_usec[2];
+    uint64_t tsft_window_start_usec;
+    bool tsft_offset_valid;
+
+    // Time between arrival and processing in user space per source
+    struct nan_timestamp_stats delay[TIMESTAMP_SOURCE_COUNT];
+    // Change of the offset to the peer's timestamp between two beacons per source
+    struct nan_timestamp_stats jitter[TIMESTAMP_SOURCE_COUNT];
+};
+
+/**
+ * Initialize the timestamp state.
+ *
+ * @param state - The state to initialize
+ * @param source - The preferred source for arrival times
+ */
+void nan_timestamp_state_init(struct nan_timestamp_state *state, enum nan_timestamp_source source);
+
+/**
+ * Determine the arrival time of a received frame from the preferred source.
+ * Falls back to the kernel timestamp and then to the host clock if a source is not available.
+ *
+ * @param state - The timestamp state
+ * @param now_usec - The current host clock in microseconds
+ * @param kernel_usec - The kernel receive timestamp in host clock microseconds, or 0 if not known
+ * @param tsft_usec - The radiotap TSFT of the frame, or 0 if not present
+ * @returns The arrival time of the frame in host clock microseconds
+ */
+uint64_t nan_timestamp_frame(struct nan_timestamp_state *state, uint64_t now_usec,
+                             uint64_t kernel_usec, uint64_t tsft_usec);
+
+/**
+ * Record the offset of the current frame's arrival times to the timestamp of a received beacon.
+ * The change of this offset between two beacons of the same peer is the jitter of a source.
+ *
+ * @param state - The timestamp state
+ * @param peer - Offsets of the last beacon of the sending peer
+ * @param beacon_timestamp - The timestamp field of the received beacon
+ */
+void nan_timestamp_beacon(struct nan_timestamp_state *state, struct nan_timestamp_peer *peer,
+                          uint64_t beacon_timestamp);
+
+double nan_timestamp_stats_mean(const struct nan_timestamp_stats *stats);
+double nan_timestamp_stats_stddev(const struct nan_timestamp_stats *stats);
+
+const char *nan_timestamp_source_to_string(enum nan_timestamp_source source);
+
+/**
+ * Parse the name of a timestamp source.
+ *
+ * @param name - One of "clock", "kernel" or "tsft"
+ * @returns The timestamp source or a negative value if the name is unknown
+ */
+int nan_timestamp_source_from_string(const char *name);
+
+#endif // NAN_TIMESTAMP_H_
@@ -1,6 +1,8 @@
 #include "tx.h"
 
 #include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include <radiotap.h>
 
 #include "attributes.h"
@@ -8,7 +10,8 @@
 #include "timer.h"
 #include "log.h"
 #include "utils.h"
-#include "circular_buffer.h"
+#include "schedule.h"
+#include "crc32.h"
 
 bool nan_can_send_discovery_beacon(const struct nan_state *state, uint64_t now_usec)
 {
@@ -21,6 +24,31 @@ bool nan_can_send_discovery_beacon(const struct nan_state *state, uint64_t now_u
     return nan_timer_can_send_discovery_beacon(&state->timer, now_usec);
 }
 
+void nan_open_discovery_window_schedule(struct nan_state *state, uint64_t now_usec)
+{
+    nan_tx_window_open(&state->tx_schedule, now_usec, now_usec + nan_timer_dw_end_usec(&state->timer, now_usec));
+}
+
+void nan_open_discovery_beacon_schedule(struct nan_state *state, uint64_t now_usec)
+{
+    if (nan_timer_in_dw(&state->timer, now_usec))
+        nan_tx_window_open(&state->tx_schedule, now_usec, now_usec);
+    else
+        nan_tx_window_open(&state->tx_schedule, now_usec, now_usec + nan_timer_next_dw_usec(&state->timer, now_usec));
+}
+
+bool nan_reserve_airtime(struct nan_state *state, enum nan_tx_priority priority,
+                         const uint8_t *frame, size_t length)
+{
+    uint64_t airtime_usec = nan_tx_airtime_usec(frame, length, state->ieee80211.fcs);
+    if (nan_tx_window_reserve(&state->tx_schedule, airtime_usec))
+        return true;
+
+    log_debug("Defer %s frame of %" PRIu64 " us airtime to the next window",
+              nan_tx_priority_to_string(priority), airtime_usec);
+    return false;
+}
+
 int nan_add_master_indication_attribute(struct buf *buf, const struct nan_state *state)
 {
     struct nan_master_indication_attribute *attribute = (struct nan_master_indication_attribute *)buf_current(buf);
@@ -265,6 +293,93 @@ void nan_build_beacon_frame(struct buf *buf, struct nan_state *state,
         ieee80211_add_fcs(buf);
 }
 
+static size_t nan_seq_ctrl_offset(const uint8_t *data)
+{
+    uint16_t radiotap_length = data[2] | data[3] << 8;
+    return radiotap_length + offsetof(struct ieee80211_hdr, seq_ctrl);
+}
+
+/**
+ * Write the next sequence number into a prebuilt frame and update its FCS.
+ * Everything before the sequence control field must be unchanged since prefix_crc was calculated.
+ */
+static void nan_patch_prebuilt_frame(struct nan_state *state, uint8_t *data, size_t length,
+                                     size_t seq_ctrl_offset, uint32_t prefix_crc, bool fcs)
+{
+    uint16_t seq_ctrl = htole16(ieee80211_state_next_sequence_number(&state->ieee80211) << 4);
+    memcpy(data + seq_ctrl_offset, &seq_ctrl, sizeof(seq_ctrl));
+
+    if (fcs)
+    {
+        size_t fcs_offset = length - sizeof(uint32_t);
+        uint32_t checksum = htole32(crc32_update(prefix_crc, data + seq_ctrl_offset, fcs_offset - seq_ctrl_offset));
+        memcpy(data + fcs_offset, &checksum, sizeof(checksum));
+    }
+}
+
+static void nan_beacon_template_key_init(struct nan_beacon_template_key *key, const struct nan_state *state)
+{
+    // Keys are compared as a whole, including padding
+    memset(key, 0, sizeof(struct nan_beacon_template_key));
+    key->interface_address = state->interface_address;
+    key->cluster_id = state->cluster.cluster_id;
+    key->master_preference = state->sync.master_preference;
+    key->random_factor = state->sync.random_factor;
+    key->hop_count = state->sync.hop_count;
+    key->fcs = state->ieee80211.fcs;
+    key->anchor_master_rank = state->sync.anchor_master_rank;
+    key->ambtt = state->sync.ambtt;
+}
+
+static int nan_beacon_template_build(struct nan_beacon_template *template, struct nan_state *state,
+                                     const enum nan_beacon_type type, const struct nan_beacon_template_key *key)
+{
+    template->valid = false;
+
+    // Sequence numbers are only assigned on transmission
+    uint16_t sequence_number = state->ieee80211.sequence_number;
+    struct buf buf = buf_view(template->data, sizeof(template->data));
+    nan_build_beacon_frame(&buf, state, type, 0);
+    state->ieee80211.sequence_number = sequence_number;
+
+    if (buf_error(&buf) < 0)
+        return -1;
+
+    template->length = buf_position(&buf);
+    template->seq_ctrl_offset = nan_seq_ctrl_offset(template->data);
+    // The sequence control field ends the 802.11 header
+    template->time_stamp_offset = template->seq_ctrl_offset + sizeof(uint16_t) +
+                                  offsetof(struct nan_beacon_frame, time_stamp);
+    template->prefix_crc = crc32(template->data, template->seq_ctrl_offset);
+    template->key = *key;
+    template->valid = true;
+    return 0;
+}
+
+const uint8_t *nan_get_beacon_frame(struct nan_state *state, const enum nan_beacon_type type,
+                                    const uint64_t now_usec, size_t *length)
+{
+    struct nan_beacon_templates *templates = &state->beacon_templates;
+    struct nan_beacon_template *template = type == NAN_SYNC_BEACON ? &templates->sync : &templates->discovery;
+
+    struct nan_beacon_template_key key;
+    nan_beacon_template_key_init(&key, state);
+    if (!template->valid || memcmp(&key, &template->key, sizeof(key)) != 0)
+    {
+        if (nan_beacon_template_build(template, state, type, &key) < 0)
+            return NULL;
+        templates->rebuilds++;
+    }
+
+    uint64_t time_stamp = htole64(nan_timer_get_synced_time_usec(&state->timer, now_usec));
+    memcpy(template->data + template->time_stamp_offset, &time_stamp, sizeof(time_stamp));
+    nan_patch_prebuilt_frame(state, template->data, template->length,
+                             template->seq_ctrl_offset, template->prefix_crc, key.fcs);
+
+    *length = template->length;
+    return template->data;
+}
+
 void nan_add_service_discovery_header(struct buf *buf, struct nan_state *state, const struct ether_addr *destination)
 {
     ieee80211_add_radiotap_header(buf, &state->ieee80211);
@@ -309,6 +424,186 @@ void nan_build_service_discovery_frame(struct buf *buf, struct nan_state *state,
         ieee80211_add_fcs(buf);
 }
 
+size_t nan_service_discovery_frame_max_length(const list_t announced_services)
+{
+    size_t length = NAN_SERVICE_DISCOVERY_FRAME_BASE_LENGTH;
+    if (announced_services)
+    {
+        struct nan_service *service;
+        LIST_FOR_EACH(announced_services, service, {
+            length += NAN_SERVICE_DESCRIPTOR_MAX_LENGTH + service->service_specific_info_length;
+        });
+    }
+    return length;
+}
+
+static void nan_sdf_cache_key_init(struct nan_sdf_cache_key *key, const struct nan_state *state,
+                                   const struct ether_addr *destination)
+{
+    // Keys are compared as a whole, including padding
+    memset(key, 0, sizeof(struct nan_sdf_cache_key));
+    key->generation = state->services.generation;
+    key->interface_address = state->interface_address;
+    key->destination = *destination;
+    key->cluster_id = state->cluster.cluster_id;
+    key->fcs = state->ieee80211.fcs;
+}
+
+static int nan_sdf_cache_build(struct nan_sdf_cache *cache, struct nan_state *state,
+                               const struct nan_sdf_cache_key *key)
+{
+    cache->valid = false;
+    cache->length = 0;
+
+    list_free(cache->announced_services, false);
+    cache->announced_services = list_init();
+    nan_get_services_to_announce(&state->services, cache->announced_services);
+
+    if (list_len(cache->announced_services) > 0)
+    {
+        size_t max_length = nan_service_discovery_frame_max_length(cache->announced_services);
+        if (max_length > cache->capacity)
+        {
+            uint8_t *data = realloc(cache->data, max_length);
+            if (data == NULL)
+                return -1;
+            cache->data = data;
+            cache->capacity = max_length;
+        }
+
+        // Sequence numbers are only assigned on transmission
+        uint16_t sequence_number = state->ieee80211.sequence_number;
+        struct buf buf = buf_view(cache->data, max_length);
+        nan_build_service_discovery_frame(&buf, state, &key->destination, cache->announced_services);
+        state->ieee80211.sequence_number = sequence_number;
+
+        if (buf_error(&buf) < 0)
+            return -1;
+
+        cache->length = buf_position(&buf);
+        cache->seq_ctrl_offset = nan_seq_ctrl_offset(cache->data);
+        cache->prefix_crc = crc32(cache->data, cache->seq_ctrl_offset);
+    }
+
+    cache->key = *key;
+    cache->valid = true;
+    return 0;
+}
+
+const uint8_t *nan_get_service_discovery_frame(struct nan_state *state, const struct ether_addr *destination,
+                                               list_t *announced_services, size_t *length)
+{
+    struct nan_sdf_cache *cache = &state->sdf_cache;
+
+    struct nan_sdf_cache_key key;
+    nan_sdf_cache_key_init(&key, state, destination);
+    if (!cache->valid || memcmp(&key, &cache->key, sizeof(key)) != 0)
+    {
+        cache->rebuilds++;
+        if (nan_sdf_cache_build(cache, state, &key) < 0)
+        {
+            *announced_services = cache->announced_services;
+            return NULL;
+        }
+    }
+
+    *announced_services = cache->announced_services;
+    if (cache->length == 0)
+        return NULL;
+
+    nan_patch_prebuilt_frame(state, cache->data, cache->length, cache->seq_ctrl_offset, cache->prefix_crc, key.fcs);
+
+    *length = cache->length;
+    return cache->data;
+}
+
+static void nan_add_follow_up_attributes(struct buf *buf, const struct nan_service *service,
+                                        const uint8_t requestor_instance_id,
+                                        const char *service_specific_info, const size_t service_specific_info_length)
+{
+    nan_add_service_descriptor_attribute(buf, service, CONTROL_TYPE_FOLLOW_UP,
+                                         requestor_instance_id, service_specific_info, service_specific_info_length);
+
+    if (service_specific_info_length >= 256)
+        nan_add_service_descriptor_extension_attribute(buf, service, service_specific_info, service_specific_info_length);
+}
+
+/**
+ * Whether a queued follow-up goes to the given destination
+ */
+static bool nan_is_follow_up_to(struct buf *buf, const void *data)
+{
+    const struct ether_addr *destination = data;
+    const uint8_t *frame = buf_data(buf);
+    size_t offset = nan_seq_ctrl_offset(frame) - offsetof(struct ieee80211_hdr, seq_ctrl);
+    if (offset + sizeof(struct ieee80211_hdr) > buf_position(buf))
+        return false;
+
+    const struct ieee80211_hdr *header = (const struct ieee80211_hdr *)(frame + offset);
+    return ether_addr_equal(&header->addr1, destination);
+}
+
+/**
+ * Whether further service descriptors may be appended to a queued follow-up.
+ * Frames with an extension attribute are left alone, as it is only tied to its descriptor by the instance id.
+ */
+static bool nan_is_extendable_follow_up(struct buf *buf, bool fcs)
+{
+    const uint8_t *frame = buf_data(buf);
+    size_t length = buf_position(buf) - (fcs ? FCS_LEN : 0);
+    size_t offset = nan_seq_ctrl_offset(frame) - offsetof(struct ieee80211_hdr, seq_ctrl) +
+                    sizeof(struct ieee80211_hdr) + sizeof(struct nan_service_discovery_frame);
+
+    while (offset + sizeof(struct nan_attribute_header) <= length)
+    {
+        const struct nan_attribute_header *attribute = (const struct nan_attribute_header *)(frame + offset);
+        if (attribute->id == SERVICE_DESCRIPTOR_EXTENSION_ATTRIBUTE)
+            return false;
+        offset += sizeof(struct nan_attribute_header) + le16toh(attribute->length);
+    }
+
+    return true;
+}
+
+/**
+ * Append a follow-up to a queued frame by replacing it with an extended copy.
+ *
+ * @returns 0 on success, -1 if the follow-up does not fit and needs a frame of its own
+ */
+static int nan_coalesce_follow_up(struct nan_state *state, struct nan_tx_frame *queued,
+                                  const struct nan_service *service, const uint8_t requestor_instance_id,
+                                  const char *service_specific_info, const size_t service_specific_info_length)
+{
+    bool fcs = state->ieee80211.fcs;
+    if (!nan_is_extendable_follow_up(queued->buf, fcs))
+        return -1;
+
+    size_t queued_length = buf_position(queued->buf) - (fcs ? FCS_LEN : 0);
+    size_t max_length = queued_length + NAN_SERVICE_DESCRIPTOR_MAX_LENGTH + service_specific_info_length + FCS_LEN;
+    if (max_length > NAN_FOLLOW_UP_COALESCE_MAX_LENGTH)
+        return -1;
+
+    struct buf *buf = buf_pool_get(&state->tx_pool, max_length);
+    if (buf == NULL)
+        return -1;
+
+    write_bytes(buf, buf_data(queued->buf), queued_length);
+    nan_add_follow_up_attributes(buf, service, requestor_instance_id, service_specific_info, service_specific_info_length);
+    if (fcs)
+        ieee80211_add_fcs(buf);
+
+    uint64_t airtime_usec = nan_tx_airtime_usec(buf_data(buf), buf_position(buf), fcs);
+    if (buf_error(buf) < 0 || airtime_usec > NAN_TX_MAX_AIRTIME_USEC)
+    {
+        buf_free(buf);
+        return -1;
+    }
+
+    log_trace("Append follow up to queued frame of length %zu", queued_length);
+    nan_tx_schedule_replace(&state->tx_schedule, queued, buf, airtime_usec);
+    return 0;
+}
+
 int nan_transmit(struct nan_state *state, const struct ether_addr *destination,
                  const uint8_t instance_id, const uint8_t requestor_instance_id,
                  const char *service_specific_info, const size_t service_specific_info_length)
@@ -321,21 +616,37 @@ int nan_transmit(struct nan_state *state, const struct ether_addr *destination,
         return -1;
     }
 
-    struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+    if (service_specific_info_length < 256)
+    {
+        struct nan_tx_frame *queued = nan_tx_schedule_find_last(&state->tx_schedule, NAN_TX_FOLLOW_UP,
+                                                                nan_is_follow_up_to, destination);
+        if (queued != NULL && nan_coalesce_follow_up(state, queued, service, requestor_instance_id,
+                                                     service_specific_info, service_specific_info_length) == 0)
+            return 0;
+    }
 
-    nan_add_service_discovery_header(buf, state, destination);
-    nan_add_service_descriptor_attribute(buf, service, CONTROL_TYPE_FOLLOW_UP,
-                                         requestor_instance_id, service_specific_info, service_specific_info_length);
+    struct buf *buf = buf_pool_get(&state->tx_pool, NAN_SERVICE_DISCOVERY_FRAME_BASE_LENGTH +
+                                                        NAN_SERVICE_DESCRIPTOR_MAX_LENGTH +
+                                                        service_specific_info_length);
+    if (buf == NULL)
+    {
+        log_warn("No buffer for follow up frame of %zu bytes", service_specific_info_length);
+        return -1;
+    }
 
-    if (service_specific_info_length >= 256)
-        nan_add_service_descriptor_extension_attribute(buf, service, service_specific_info, service_specific_info_length);
+    nan_add_service_discovery_header(buf, state, destination);
+    nan_add_follow_up_attributes(buf, service, requestor_instance_id, service_specific_info, service_specific_info_length);
 
     if (state->ieee80211.fcs)
         ieee80211_add_fcs(buf);
 
-    if (circular_buf_put(state->buffer, (any_t)buf) < 0)
+    uint64_t now_usec = nan_clock_now_usec(&state->clock);
+    uint64_t airtime_usec = nan_tx_airtime_usec(buf_data(buf), buf_position(buf), state->ieee80211.fcs);
+    if (nan_tx_schedule_enqueue(&state->tx_schedule, NAN_TX_FOLLOW_UP, buf, airtime_usec,
+                                now_usec + NAN_TX_FOLLOW_UP_LIFETIME_USEC) < 0)
     {
-        log_warn("Could not add follow up frame to buffer");
+        log_warn("Could not schedule follow up frame");
+        buf_free(buf);
         return -1;
     }
 
@@ -9,6 +9,15 @@
 #include "service.h"
 #include "data_path.h"
 
+// Upper bound of a service discovery frame without service descriptors,
+// including the radiotap header and the FCS
+#define NAN_SERVICE_DISCOVERY_FRAME_BASE_LENGTH 96
+// Upper bound of a service descriptor and its extension without the service specific info
+#define NAN_SERVICE_DESCRIPTOR_MAX_LENGTH 32
+// Largest follow-up frame further follow-ups to the same destination are appended to,
+// including the radiotap header and the FCS
+#define NAN_FOLLOW_UP_COALESCE_MAX_LENGTH 2304
+
 /**
  * Check if we are allowed to send a discovery beacon now.
  * 
@@ -18,6 +27,35 @@
  */
 bool nan_can_send_discovery_beacon(const struct nan_state *state, uint64_t now_usec);
 
+/**
+ * Open the transmission window of the current discovery window, which lasts until the end of the DW.
+ * 
+ * @param state - The current state
+ * @param now_usec - The current time in microseconds
+ */
+void nan_open_discovery_window_schedule(struct nan_state *state, uint64_t now_usec);
+
+/**
+ * Open the transmission window for a discovery beacon, which lasts until the next DW starts.
+ * The window is empty during a DW, as the DW is reserved for frames of higher priority.
+ * 
+ * @param state - The current state
+ * @param now_usec - The current time in microseconds
+ */
+void nan_open_discovery_beacon_schedule(struct nan_state *state, uint64_t now_usec);
+
+/**
+ * Reserve airtime in the current transmission window for a frame that is sent right away.
+ * 
+ * @param state - The current state
+ * @param priority - The priority of the frame, only used for logging
+ * @param frame - The frame ready for injection
+ * @param length - The length of the frame in bytes
+ * @returns Whether the frame completes before the window ends, otherwise it should be deferred
+ */
+bool nan_reserve_airtime(struct nan_state *state, enum nan_tx_priority priority,
+                         const uint8_t *frame, size_t length);
+
 /**
  * Add a master indication attribute to the given buffer.
  * 
@@ -85,13 +123,56 @@ void nan_add_service_discovery_header(struct buf *buf, struct nan_state *state,
 void nan_build_beacon_frame(struct buf *buf, struct nan_state *state,
                             const enum nan_beacon_type type, const uint64_t now_usec);
 
+/**
+ * Get a beacon frame ready for transmission without building it from scratch.
+ * The frame is taken from a template per beacon type, which is only rebuilt when the
+ * sync or cluster state changed. Only the sequence number, the timestamp and the FCS
+ * are updated in place.
+ * 
+ * @param state - The current state
+ * @param type - The type of beacon
+ * @param now_usec - The current time in microseconds
+ * @param length - Set to the length of the frame in bytes
+ * @returns The frame, valid until the next call for the same type, or NULL on error
+ */
+const uint8_t *nan_get_beacon_frame(struct nan_state *state, const enum nan_beacon_type type,
+                                    const uint64_t now_usec, size_t *length);
+
 void nan_build_service_discovery_frame(struct buf *buf, struct nan_state *state,
                                        const struct ether_addr *destination, const list_t announced_services);
 
+/**
+ * Upper bound of the length of a service discovery frame, used to pick a buffer of the right size.
+ * 
+ * @param announced_services - The services to announce, may be NULL
+ * @returns The maximum length of the frame in bytes
+ */
+size_t nan_service_discovery_frame_max_length(const list_t announced_services);
+
+/**
+ * Get a service discovery frame announcing all services that should be announced now.
+ * The frame is cached and only rebuilt when the services, the cluster or the destination changed.
+ * Only the sequence number and the FCS are updated in place.
+ * 
+ * @param state - The current state
+ * @param destination - Ethernet address of the destination
+ * @param announced_services - Set to the services announced by the frame, owned by the cache
+ *                             and valid until the next call
+ * @param length - Set to the length of the frame in bytes
+ * @returns The frame, valid until the next call, or NULL if no service is announced
+ *          or the frame could not be built
+ */
+const uint8_t *nan_get_service_discovery_frame(struct nan_state *state, const struct ether_addr *destination,
+                                               list_t *announced_services, size_t *length);
+
 /**
  * With this Method a service/application may request the NAN Discovery Engine to transmit 
  * a follow-up message with a given content to a given NAN Device and targeted to a given 
  * instance of the publish function or the subscribe function in the given NAN Device.
+ * The frame is queued until a discovery window with enough airtime left
+ * and dropped if that does not happen within NAN_TX_FOLLOW_UP_LIFETIME_USEC.
+ * If a follow-up to the same destination is still queued, the service descriptor
+ * is appended to that frame instead, as long as it stays below NAN_FOLLOW_UP_COALESCE_MAX_LENGTH.
  * 
  * @param state - The current state
  * @param destination - Ethernet address of the destination device
@@ -119,6 +119,15 @@ uint64_t clock_time_usec()
     return now_us;
 }
 
+uint64_t clock_time_nsec()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+        return 0;
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
 uint8_t get_rand_num(uint8_t min, uint8_t max)
 {
     uint16_t range = max - min + 1;
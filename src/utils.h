@@ -76,6 +76,13 @@ bool oui_equal(const struct oui oui1, const struct oui oui2);
  */
 uint64_t clock_time_usec();
 
+/**
+ * Get the current time in nanoseconds.
+ * 
+ * @returns Current time in nanoseconds
+ */
+uint64_t clock_time_nsec();
+
 /**
  * Get a random number between a defined interval.
  * 
@@ -6,16 +6,7 @@
 #include <stdbool.h>
 
 #include "log.h"
-struct buf
-{
-    const uint8_t *data;
-    uint8_t *current;
-    int start;
-    int end;
-    size_t size;
-    bool owned;
-    int error;
-};
+#include "buf_pool.h"
 
 struct buf *buf_new_owned(size_t size)
 {
@@ -27,6 +18,7 @@ struct buf *buf_new_owned(size_t size)
     buf->end = size;
     buf->owned = true;
     buf->error = 0;
+    buf->pool = NULL;
     return buf;
 }
 
@@ -48,11 +40,33 @@ struct buf *buf_new_const(const uint8_t *data, size_t size)
     buf->end = size;
     buf->owned = false;
     buf->error = 0;
+    buf->pool = NULL;
+    return buf;
+}
+
+struct buf buf_view(const uint8_t *data, size_t size)
+{
+    struct buf buf = {
+        .data = data,
+        .current = (uint8_t *)data,
+        .start = 0,
+        .end = size,
+        .size = size,
+        .owned = false,
+        .error = 0,
+        .pool = NULL,
+    };
     return buf;
 }
 
 void buf_free(struct buf *buf)
 {
+    if (buf->pool)
+    {
+        buf_pool_put(buf);
+        return;
+    }
+
     if (buf->owned)
         free((void *)buf->data);
     free(buf);
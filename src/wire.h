@@ -2,6 +2,7 @@
 #define NAN_WIRE_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <net/ethernet.h>
 
 #define BUF_MAX_LENGTH 65535
@@ -33,9 +34,22 @@
 #endif /* __APPLE__ */
 
 /** 
- * Opaque buffer used for ethernet frames.
- */
-struct buf;
+ * Buffer used for ethernet frames.
+ * Only access its fields through the functions below. The definition is public
+ * so that buffer views (see buf_view) can live on the stack.
+ */
+struct buf
+{
+    const uint8_t *data;
+    uint8_t *current;
+    int start;
+    int end;
+    size_t size;
+    bool owned;
+    int error;
+    // Size class of a buf_pool the buffer returns to on buf_free, NULL if not pooled
+    void *pool;
+};
 
 /** 
  * Allocates a new buffer of given size.
@@ -63,8 +77,20 @@ struct buf *buf_new_copy(const uint8_t *data, size_t size);
  */
 struct buf *buf_new_const(const uint8_t *data, size_t size);
 
+/** 
+ * Creates a buffer view on an already existing bytes array without allocating.
+ * The view is returned by value, so it can live on the stack. It must not be passed
+ * to buf_free and is only valid as long as the underlying data.
+ *
+ * @param data Immutable reference to buffer array
+ * @param size Size of the buffer in bytes
+ * @return The buffer view
+ */
+struct buf buf_view(const uint8_t *data, size_t size);
+
 /** 
  * Deallocates a buffer instance and its data if not initiated using buf_new_const.
+ * Buffers taken from a buf_pool are returned to their pool instead.
  *
  * @param buf Buffer instance to free
  */
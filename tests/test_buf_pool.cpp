@@ -0,0 +1,64 @@
+extern "C" {
+#include "buf_pool.h"
+#include "wire.h"
+}
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    class TestBufPool : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            buf_pool_init(&pool);
+        }
+
+        void TearDown() override {
+            buf_pool_free(&pool);
+        }
+
+        struct buf_pool pool;
+    };
+
+    TEST_F(TestBufPool, testSmallestClassThatFits) {
+        struct buf *small = buf_pool_get(&pool, 100);
+        struct buf *large = buf_pool_get(&pool, 3000);
+        ASSERT_NE(small, nullptr);
+        ASSERT_NE(large, nullptr);
+
+        ASSERT_EQ(buf_size(small), 100);
+        ASSERT_EQ(buf_rest(large), 3000);
+        ASSERT_EQ(pool.classes[0].slab.used, 1);
+        ASSERT_EQ(pool.classes[2].slab.used, 1);
+        ASSERT_EQ(buf_pool_in_use(&pool), 2);
+
+        // Writing past the requested size is refused like for any other buffer
+        ASSERT_EQ(buf_advance(small, 101), -1);
+
+        buf_free(small);
+        buf_free(large);
+        ASSERT_EQ(buf_pool_in_use(&pool), 0);
+    }
+
+    TEST_F(TestBufPool, testBuffersAreRecycled) {
+        struct buf *first = buf_pool_get(&pool, 200);
+        const uint8_t *data = buf_data(first);
+        write_u8(first, 0x42);
+        buf_free(first);
+
+        size_t capacity = pool.classes[0].slab.capacity;
+        struct buf *second = buf_pool_get(&pool, 256);
+        ASSERT_EQ(second, first);
+        ASSERT_EQ(buf_data(second), data);
+        ASSERT_EQ(buf_position(second), 0);
+        ASSERT_EQ(buf_error(second), 0);
+        ASSERT_EQ(pool.classes[0].slab.capacity, capacity);
+        buf_free(second);
+    }
+
+    TEST_F(TestBufPool, testOversized) {
+        ASSERT_NE(buf_pool_get(&pool, BUF_MAX_LENGTH), nullptr);
+        ASSERT_EQ(buf_pool_get(&pool, BUF_MAX_LENGTH + 1), nullptr);
+        ASSERT_EQ(pool.oversized, 1);
+    }
+}
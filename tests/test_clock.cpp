@@ -0,0 +1,65 @@
+extern "C" {
+#include "clock.h"
+}
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    uint64_t read_tsf(const void *data) {
+        return *(const uint64_t *)data;
+    }
+
+    TEST(TestClock, testVirtual) {
+        struct nan_virtual_clock virtual_clock;
+        nan_virtual_clock_init(&virtual_clock, 1000);
+
+        struct nan_clock clock;
+        nan_clock_init_virtual(&clock, &virtual_clock);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 1000u);
+
+        nan_virtual_clock_advance(&virtual_clock, 500);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 1500u);
+
+        // A virtual clock never goes backwards
+        nan_virtual_clock_set(&virtual_clock, 1200);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 1500u);
+        nan_virtual_clock_set(&virtual_clock, 3600000000);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 3600000000u);
+    }
+
+    TEST(TestClock, testDrift) {
+        struct nan_virtual_clock virtual_clock;
+        nan_virtual_clock_init(&virtual_clock, 1000000);
+        struct nan_clock base;
+        nan_clock_init_virtual(&base, &virtual_clock);
+
+        struct nan_drift_clock fast, slow;
+        nan_drift_clock_init(&fast, &base, 100, 20);
+        nan_drift_clock_init(&slow, &base, -100, -20);
+
+        struct nan_clock clock;
+        nan_clock_init_drift(&clock, &fast);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 1000100u);
+
+        // 20 ppm over 10 s are 200 us
+        nan_virtual_clock_advance(&virtual_clock, 10000000);
+        ASSERT_EQ(nan_clock_now_usec(&clock), 11000300u);
+        ASSERT_EQ(nan_drift_clock_now_usec(&slow), 10999700u);
+    }
+
+    TEST(TestClock, testTsf) {
+        struct nan_clock clock;
+        nan_clock_init_real(&clock);
+        ASSERT_FALSE(nan_clock_has_tsf(&clock));
+        ASSERT_EQ(nan_clock_tsf_usec(&clock), 0u);
+
+        uint64_t tsf = 42;
+        nan_clock_set_tsf(&clock, read_tsf, &tsf);
+        ASSERT_TRUE(nan_clock_has_tsf(&clock));
+        ASSERT_EQ(nan_clock_tsf_usec(&clock), 42u);
+
+        uint64_t first = nan_clock_now_usec(&clock);
+        ASSERT_GE(nan_clock_now_usec(&clock), first);
+    }
+}
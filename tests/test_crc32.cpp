@@ -3,6 +3,8 @@ extern "C" {
 #include "wire.h"
 }
 
+#include <stdlib.h>
+
 #include "gtest/gtest.h"
 
 namespace {
@@ -40,4 +42,57 @@ namespace {
         uint32_t result = crc32(testBuf, 72);
         EXPECT_EQ(htobe32(0x57e148ff), result);
     }
+
+    TEST(TestCrc32, testCrcUpdate) {
+        uint8_t data[100];
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = (uint8_t)(i * 31 + 7);
+
+        uint32_t expected = crc32(data, sizeof(data));
+        for (size_t split = 0; split <= sizeof(data); split += 9) {
+            uint32_t prefix = crc32(data, split);
+            EXPECT_EQ(expected, crc32_update(prefix, data + split, sizeof(data) - split));
+        }
+        EXPECT_EQ(crc32(data, 0), 0u);
+    }
+
+    TEST(TestCrc32, testCrcImplementations) {
+        static uint8_t data[BUF_MAX_LENGTH + 8];
+        srand(1);
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = (uint8_t)rand();
+
+        const size_t sizes[] = {0, 1, 7, 8, 15, 16, 63, 64, 65, 79, 80, 127, 128, 1500, 2304, BUF_MAX_LENGTH};
+        const enum crc32_implementation implementations[] = {
+            CRC32_IMPL_SLICE_BY_8, CRC32_IMPL_PCLMUL, CRC32_IMPL_ARMV8};
+
+        enum crc32_implementation selected = crc32_get_implementation();
+        ASSERT_EQ(0, crc32_set_implementation(CRC32_IMPL_TABLE));
+        uint32_t expected[sizeof(sizes) / sizeof(sizes[0])][8];
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            for (size_t offset = 0; offset < 8; offset++)
+                expected[i][offset] = crc32(data + offset, sizes[i]);
+
+        for (enum crc32_implementation implementation : implementations) {
+            if (!crc32_implementation_supported(implementation)) {
+                EXPECT_EQ(-1, crc32_set_implementation(implementation));
+                continue;
+            }
+            ASSERT_EQ(0, crc32_set_implementation(implementation));
+            EXPECT_EQ(implementation, crc32_get_implementation());
+
+            for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+                for (size_t offset = 0; offset < 8; offset++)
+                    EXPECT_EQ(expected[i][offset], crc32(data + offset, sizes[i]))
+                        << crc32_implementation_to_string(implementation) << " size " << sizes[i]
+                        << " offset " << offset;
+
+            // Split at arbitrary points to mix the wide paths with the bytewise tail
+            for (size_t split = 0; split < 300; split += 13)
+                EXPECT_EQ(expected[sizeof(sizes) / sizeof(sizes[0]) - 1][0],
+                          crc32_update(crc32(data, split), data + split, BUF_MAX_LENGTH - split));
+        }
+
+        EXPECT_EQ(0, crc32_set_implementation(selected));
+    }
 }
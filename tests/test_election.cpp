@@ -0,0 +1,184 @@
+extern "C" {
+#include "peer.h"
+#include "sync.h"
+}
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    // The master election counters as computed by scanning all peers
+    struct nan_election_counters scan_counters(const struct nan_sync_state *state, const list_t peers,
+                                               const uint64_t now_usec) {
+        struct nan_election_counters counters = {};
+        struct nan_peer *peer;
+
+        LIST_FOR_EACH(peers, peer, {
+            uint64_t peer_master_rank = nan_get_peer_master_rank(peer);
+
+            // Peers updated after now_usec are within the window
+            if (peer->last_update < now_usec && now_usec - peer->last_update > NAN_MASTER_ELECTION_WINDOW_USEC)
+                continue;
+
+            if (peer->rssi_average > RSSI_CLOSE) {
+                counters.count_rssi_close++;
+                if (peer_master_rank > state->master_rank)
+                    counters.count_rssi_close_higher_mr++;
+                if (peer->master_candidate)
+                    counters.count_rssi_close_master_candidate++;
+            }
+
+            if (peer->rssi_average > RSSI_MIDDLE) {
+                counters.count_rssi_middle++;
+                if (peer_master_rank > state->master_rank)
+                    counters.count_rssi_middle_higher_mr++;
+                if (peer->master_candidate)
+                    counters.count_rssi_middle_master_candidate++;
+            }
+
+            if (peer_master_rank > state->master_rank)
+                counters.count_higher_mr++;
+        })
+
+        return counters;
+    }
+
+    void expect_counters_equal(const struct nan_election_counters *expected,
+                               const struct nan_election_counters *actual) {
+        EXPECT_EQ(expected->count_higher_mr, actual->count_higher_mr);
+        EXPECT_EQ(expected->count_rssi_close, actual->count_rssi_close);
+        EXPECT_EQ(expected->count_rssi_middle, actual->count_rssi_middle);
+        EXPECT_EQ(expected->count_rssi_close_higher_mr, actual->count_rssi_close_higher_mr);
+        EXPECT_EQ(expected->count_rssi_close_master_candidate, actual->count_rssi_close_master_candidate);
+        EXPECT_EQ(expected->count_rssi_middle_higher_mr, actual->count_rssi_middle_higher_mr);
+        EXPECT_EQ(expected->count_rssi_middle_master_candidate, actual->count_rssi_middle_master_candidate);
+    }
+
+    class TestElection : public ::testing::Test {
+    protected:
+        struct nan_peer_state peers;
+        struct nan_sync_state sync;
+        struct ether_addr self = {{0x02, 0x11, 0x22, 0x33, 0x44, 0x80}};
+        struct ether_addr cluster_id = {{0x50, 0x6f, 0x9a, 0x01, 0x00, 0x00}};
+
+        void SetUp() override {
+            nan_peer_state_init(&peers);
+            nan_sync_state_init(&sync, &self);
+        }
+
+        struct ether_addr peer_address(int index) {
+            struct ether_addr addr = {{0x02, 0x11, 0x22, 0x33, 0x00, 0x00}};
+            addr.ether_addr_octet[5] = (uint8_t)index;
+            return addr;
+        }
+
+        // Update a peer the same way a received beacon does
+        struct nan_peer *receive_beacon(int index, signed char rssi, uint8_t master_preference,
+                                        uint64_t now_usec) {
+            struct ether_addr addr = peer_address(index);
+            struct nan_peer *peer = NULL;
+            nan_peer_add(&peers, &addr, &cluster_id, now_usec, &peer);
+            nan_peer_set_master_indication(peer, master_preference, index);
+            nan_peer_set_beacon_information(peer, rssi, now_usec);
+            nan_check_master_candidate(&sync, peer);
+            nan_peer_election_update(&peers, peer);
+            return peer;
+        }
+    };
+
+    TEST_F(TestElection, testCountersAgeOut) {
+        uint64_t now_usec = 3600000000;
+        receive_beacon(1, -40, 10, now_usec);
+        receive_beacon(2, -70, 0, now_usec + 1000);
+
+        const struct nan_election_counters *counters =
+            nan_peer_election_counters(&peers, sync.master_rank, now_usec + 2000, NAN_MASTER_ELECTION_WINDOW_USEC);
+        ASSERT_EQ(counters->count_rssi_close, 1);
+        ASSERT_EQ(counters->count_rssi_middle, 2);
+        ASSERT_EQ(counters->count_rssi_close_higher_mr, 1);
+        ASSERT_EQ(counters->count_higher_mr, 2);
+
+        counters = nan_peer_election_counters(&peers, sync.master_rank,
+                                              now_usec + NAN_MASTER_ELECTION_WINDOW_USEC + 1, NAN_MASTER_ELECTION_WINDOW_USEC);
+        ASSERT_EQ(counters->count_rssi_close, 0);
+        ASSERT_EQ(counters->count_rssi_middle, 1);
+        ASSERT_EQ(counters->count_higher_mr, 1);
+
+        // Another beacon counts the peer again
+        receive_beacon(1, -40, 10, now_usec + 600000);
+        counters = nan_peer_election_counters(&peers, sync.master_rank, now_usec + 600000, NAN_MASTER_ELECTION_WINDOW_USEC);
+        ASSERT_EQ(counters->count_rssi_close, 1);
+        ASSERT_EQ(counters->count_rssi_middle, 1);
+    }
+
+    TEST_F(TestElection, testCountersAgeOutOfOrder) {
+        uint64_t now_usec = 3600000000;
+        // Arrival times are not monotonic, e.g., when the timestamp source changes
+        receive_beacon(1, -40, 10, now_usec + 1000);
+        receive_beacon(2, -70, 0, now_usec);
+        receive_beacon(3, -70, 0, now_usec + 500);
+
+        uint64_t later_usec = now_usec + NAN_MASTER_ELECTION_WINDOW_USEC + 700;
+        struct nan_election_counters expected = scan_counters(&sync, peers.peers, later_usec);
+        ASSERT_EQ(expected.count_rssi_middle, 1);
+        expect_counters_equal(&expected, nan_peer_election_counters(&peers, sync.master_rank, later_usec,
+                                                                    NAN_MASTER_ELECTION_WINDOW_USEC));
+
+        // A peer updated after the given time is counted
+        receive_beacon(2, -70, 0, later_usec + 1000);
+        expected = scan_counters(&sync, peers.peers, later_usec);
+        ASSERT_EQ(expected.count_rssi_middle, 2);
+        ASSERT_EQ(expected.count_rssi_close, 1);
+        expect_counters_equal(&expected, nan_peer_election_counters(&peers, sync.master_rank, later_usec,
+                                                                    NAN_MASTER_ELECTION_WINDOW_USEC));
+    }
+
+    TEST_F(TestElection, testMatchesFullScan) {
+        const int peer_count = 60;
+        std::mt19937 random(7);
+        std::uniform_int_distribution<int> peer_index(1, peer_count);
+        std::uniform_int_distribution<int> rssi(-95, -30);
+        std::uniform_int_distribution<int> percent(0, 99);
+
+        uint64_t now_usec = 3600000000;
+        for (int dw = 0; dw < 300; dw++) {
+            // Beacons spread over the DW and the time before it
+            int beacons = percent(random) % 40;
+            for (int i = 0; i < beacons; i++) {
+                now_usec += percent(random) * 300;
+                uint8_t master_preference = percent(random) < 10 ? percent(random) : 0;
+                receive_beacon(peer_index(random), rssi(random), master_preference, now_usec);
+            }
+
+            // Own master rank and the anchor master change from time to time
+            if (percent(random) < 10) {
+                sync.master_preference = percent(random);
+                sync.random_factor = percent(random);
+                nan_update_master_rank(&sync, NULL);
+            }
+            if (percent(random) < 10)
+                sync.hop_count = percent(random) % 4;
+
+            if (percent(random) < 5)
+                nan_peers_clean(&peers, now_usec);
+
+            now_usec += TU_TO_USEC(NAN_DW_LENGTH_TU);
+
+            struct nan_election_counters expected = scan_counters(&sync, peers.peers, now_usec);
+            const struct nan_election_counters *actual =
+                nan_peer_election_counters(&peers, sync.master_rank, now_usec, NAN_MASTER_ELECTION_WINDOW_USEC);
+            expect_counters_equal(&expected, actual);
+
+            enum nan_role role = sync.role;
+            nan_master_election(&sync, &peers, now_usec);
+            if (role == MASTER && (expected.count_rssi_close_higher_mr >= 1 || expected.count_rssi_middle_higher_mr >= 3)) {
+                ASSERT_NE(sync.role, MASTER);
+            }
+
+            now_usec += TU_TO_USEC(NAN_DW_INTERVAL_TU - NAN_DW_LENGTH_TU) - percent(random) * 1000;
+        }
+    }
+
+}
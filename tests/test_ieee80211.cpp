@@ -0,0 +1,183 @@
+extern "C" {
+#include <radiotap.h>
+
+#include "ieee80211.h"
+#include "rx.h"
+#include "wire.h"
+}
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    struct radiotap_fields {
+        int result;
+        signed char rssi;
+        uint8_t flags;
+        uint64_t tsft;
+        int position;
+    };
+
+    radiotap_fields parse_iterator(const uint8_t *data, size_t length) {
+        radiotap_fields fields = {};
+        struct buf frame = buf_view(data, length);
+        fields.result = ieee80211_parse_radiotap_header(&frame, &fields.rssi, &fields.flags, &fields.tsft);
+        fields.position = buf_position(&frame);
+        return fields;
+    }
+
+    radiotap_fields parse_cached(struct ieee80211_radiotap_cache *cache, const uint8_t *data, size_t length) {
+        radiotap_fields fields = {};
+        struct buf frame = buf_view(data, length);
+        fields.result = ieee80211_parse_radiotap_header_cached(cache, &frame, &fields.rssi, &fields.flags, &fields.tsft);
+        fields.position = buf_position(&frame);
+        return fields;
+    }
+
+    void expect_equal(const radiotap_fields &expected, const radiotap_fields &actual) {
+        ASSERT_EQ(expected.result, actual.result);
+        ASSERT_EQ(expected.rssi, actual.rssi);
+        ASSERT_EQ(expected.flags, actual.flags);
+        ASSERT_EQ(expected.tsft, actual.tsft);
+        ASSERT_EQ(expected.position, actual.position);
+    }
+
+    // TSFT, flags, rate, channel, antenna signal, RX flags and a second radiotap namespace
+    // with antenna signal and antenna, as emitted by ath9k
+    const uint8_t extended_header[] = {
+            0x00, 0x00, 0x24, 0x00, 0x2f, 0x40, 0x00, 0xa0,
+            0x20, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+            0x10, 0x02, 0x6c, 0x09, 0xa0, 0x00, 0xc4, 0x00,
+            0x00, 0x00, 0xbf, 0x00,
+    };
+
+    TEST(TestIeee80211, testRadiotapCachedOwnHeader) {
+        struct ieee80211_state state;
+        ieee80211_init_state(&state);
+
+        struct buf *buf = buf_new_owned(64);
+        ieee80211_add_radiotap_header(buf, &state);
+        size_t length = buf_position(buf);
+
+        radiotap_fields expected = parse_iterator(buf_data(buf), length);
+        ASSERT_EQ(expected.result, RX_OK);
+        ASSERT_EQ(expected.flags, IEEE80211_RADIOTAP_F_FCS);
+
+        expect_equal(expected, parse_cached(&state.radiotap_cache, buf_data(buf), length));
+        expect_equal(expected, parse_cached(&state.radiotap_cache, buf_data(buf), length));
+        ASSERT_EQ(state.radiotap_cache.misses, 1u);
+        ASSERT_EQ(state.radiotap_cache.hits, 1u);
+
+        buf_free(buf);
+    }
+
+    TEST(TestIeee80211, testRadiotapCachedExtendedBitmap) {
+        struct ieee80211_radiotap_cache cache;
+        ieee80211_radiotap_cache_init(&cache);
+
+        radiotap_fields expected = parse_iterator(extended_header, sizeof(extended_header));
+        ASSERT_EQ(expected.result, RX_OK);
+        ASSERT_EQ(expected.tsft, 0x1122334455667788u);
+        ASSERT_EQ(expected.flags, 0x10);
+        ASSERT_EQ(expected.rssi, (signed char)0xbf);
+        ASSERT_EQ(expected.position, (int)sizeof(extended_header));
+
+        for (int i = 0; i < 3; i++)
+            expect_equal(expected, parse_cached(&cache, extended_header, sizeof(extended_header)));
+        ASSERT_EQ(cache.misses, 1u);
+        ASSERT_EQ(cache.hits, 2u);
+        ASSERT_EQ(cache.fallbacks, 0u);
+    }
+
+    TEST(TestIeee80211, testRadiotapCachedTruncated) {
+        struct ieee80211_radiotap_cache cache;
+        ieee80211_radiotap_cache_init(&cache);
+
+        uint8_t header[sizeof(extended_header)];
+        memcpy(header, extended_header, sizeof(header));
+        header[2] = 0x20;
+
+        ASSERT_LT(parse_iterator(header, sizeof(header)).result, 0);
+        ASSERT_LT(parse_cached(&cache, header, sizeof(header)).result, 0);
+        ASSERT_LT(parse_cached(&cache, extended_header, sizeof(extended_header) - 1).result, 0);
+    }
+
+    TEST(TestIeee80211, testRadiotapCachedVendorNamespace) {
+        struct ieee80211_radiotap_cache cache;
+        ieee80211_radiotap_cache_init(&cache);
+
+        uint8_t header[sizeof(extended_header)];
+        memcpy(header, extended_header, sizeof(header));
+        header[7] = 0xc0;
+
+        expect_equal(parse_iterator(header, sizeof(header)), parse_cached(&cache, header, sizeof(header)));
+        ASSERT_EQ(cache.fallbacks, 1u);
+        ASSERT_EQ(cache.count, 0u);
+    }
+
+    TEST(TestIeee80211, testRadiotapCachedExtendedFields) {
+        struct ieee80211_radiotap_cache cache;
+        ieee80211_radiotap_cache_init(&cache);
+
+        // TSFT and flags, followed by a word without namespace switch that holds fields 32 and up
+        const uint8_t header[] = {
+                0x00, 0x00, 0x19, 0x00, 0x03, 0x00, 0x00, 0x80,
+                0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+                0x10,
+        };
+
+        expect_equal(parse_iterator(header, sizeof(header)), parse_cached(&cache, header, sizeof(header)));
+        ASSERT_EQ(cache.fallbacks, 1u);
+        ASSERT_EQ(cache.count, 0u);
+    }
+
+    TEST(TestIeee80211, testRadiotapCachedFullCacheKeepsEntries) {
+        struct ieee80211_radiotap_cache cache;
+        ieee80211_radiotap_cache_init(&cache);
+
+        // Fill the cache with TSFT, flags and one of several single byte fields
+        const int extra_fields[IEEE80211_RADIOTAP_CACHE_SIZE] = {
+                IEEE80211_RADIOTAP_RATE, IEEE80211_RADIOTAP_DBM_ANTSIGNAL, IEEE80211_RADIOTAP_DBM_ANTNOISE,
+                IEEE80211_RADIOTAP_DBM_TX_POWER, IEEE80211_RADIOTAP_ANTENNA, IEEE80211_RADIOTAP_DB_ANTSIGNAL,
+                IEEE80211_RADIOTAP_DB_ANTNOISE, IEEE80211_RADIOTAP_RTS_RETRIES,
+        };
+        uint8_t headers[IEEE80211_RADIOTAP_CACHE_SIZE][18];
+        radiotap_fields expected[IEEE80211_RADIOTAP_CACHE_SIZE];
+        for (int i = 0; i < IEEE80211_RADIOTAP_CACHE_SIZE; i++) {
+            uint32_t present = 1u << IEEE80211_RADIOTAP_TSFT | 1u << IEEE80211_RADIOTAP_FLAGS | 1u << extra_fields[i];
+            const uint8_t header[sizeof(headers[i])] = {
+                    0x00, 0x00, sizeof(headers[i]), 0x00,
+                    (uint8_t)present, (uint8_t)(present >> 8), (uint8_t)(present >> 16), (uint8_t)(present >> 24),
+                    0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+                    0x10, 0xbf,
+            };
+            memcpy(headers[i], header, sizeof(header));
+            expected[i] = parse_iterator(headers[i], sizeof(headers[i]));
+            ASSERT_EQ(expected[i].result, RX_OK);
+            expect_equal(expected[i], parse_cached(&cache, headers[i], sizeof(headers[i])));
+        }
+        ASSERT_EQ(cache.count, (unsigned int)IEEE80211_RADIOTAP_CACHE_SIZE);
+        ASSERT_EQ(cache.misses, (uint64_t)IEEE80211_RADIOTAP_CACHE_SIZE);
+
+        // TSFT and flags, followed by a word without namespace switch, cannot be cached
+        const uint8_t uncacheable[] = {
+                0x00, 0x00, 0x19, 0x00, 0x03, 0x00, 0x00, 0x80,
+                0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+                0x10,
+        };
+        radiotap_fields uncached = parse_iterator(uncacheable, sizeof(uncacheable));
+        expect_equal(uncached, parse_cached(&cache, uncacheable, sizeof(uncacheable)));
+        expect_equal(uncached, parse_cached(&cache, uncacheable, sizeof(uncacheable)));
+        ASSERT_EQ(cache.fallbacks, 2u);
+
+        for (int i = 0; i < IEEE80211_RADIOTAP_CACHE_SIZE; i++)
+            expect_equal(expected[i], parse_cached(&cache, headers[i], sizeof(headers[i])));
+        ASSERT_EQ(cache.hits, (uint64_t)IEEE80211_RADIOTAP_CACHE_SIZE);
+        ASSERT_EQ(cache.misses, (uint64_t)IEEE80211_RADIOTAP_CACHE_SIZE);
+    }
+}
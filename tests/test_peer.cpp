@@ -0,0 +1,159 @@
+extern "C" {
+#include "peer.h"
+}
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    struct ether_addr make_address(int index) {
+        // Same vendor prefix, only the last bytes differ
+        struct ether_addr addr = {{0x02, 0x11, 0x22, 0x00, 0x00, 0x00}};
+        addr.ether_addr_octet[4] = (uint8_t)(index >> 8);
+        addr.ether_addr_octet[5] = (uint8_t)index;
+        return addr;
+    }
+
+    class TestPeer : public ::testing::Test {
+    protected:
+        struct nan_peer_state state;
+        struct ether_addr cluster_id = {{0x50, 0x6f, 0x9a, 0x01, 0x00, 0x00}};
+
+        void SetUp() override {
+            nan_peer_state_init(&state);
+        }
+    };
+
+    TEST_F(TestPeer, testAddReturnsPeer) {
+        struct ether_addr addr = make_address(1);
+        struct nan_peer *peer = NULL;
+
+        ASSERT_EQ(nan_peer_add(&state, &addr, &cluster_id, 100, &peer), PEER_ADD);
+        ASSERT_NE(peer, nullptr);
+        ASSERT_EQ(peer->last_update, 100u);
+
+        struct nan_peer *updated = NULL;
+        ASSERT_EQ(nan_peer_add(&state, &addr, &cluster_id, 200, &updated), PEER_UPDATE);
+        ASSERT_EQ(updated, peer);
+        ASSERT_EQ(peer->last_update, 200u);
+
+        struct nan_peer *found = NULL;
+        ASSERT_EQ(nan_peer_get(&state, &addr, &found), PEER_OK);
+        ASSERT_EQ(found, peer);
+
+        struct ether_addr other = make_address(2);
+        ASSERT_EQ(nan_peer_get(&state, &other, &found), PEER_MISSING);
+        ASSERT_EQ(found, nullptr);
+    }
+
+    TEST_F(TestPeer, testManyPeersKeepTheirAddress) {
+        const int count = 500;
+        struct nan_peer *peers[count];
+
+        for (int i = 0; i < count; i++) {
+            struct ether_addr addr = make_address(i);
+            ASSERT_EQ(nan_peer_add(&state, &addr, &cluster_id, 100, &peers[i]), PEER_ADD);
+        }
+        ASSERT_EQ(list_len(state.peers), count);
+        ASSERT_EQ(state.table.count, (size_t)count);
+
+        // Peers must not move when the table grows
+        for (int i = 0; i < count; i++) {
+            struct ether_addr addr = make_address(i);
+            struct nan_peer *peer = NULL;
+            ASSERT_EQ(nan_peer_get(&state, &addr, &peer), PEER_OK);
+            ASSERT_EQ(peer, peers[i]);
+        }
+    }
+
+    TEST_F(TestPeer, testRemoveKeepsOtherPeersReachable) {
+        const int count = 200;
+        for (int i = 0; i < count; i++) {
+            struct ether_addr addr = make_address(i);
+            nan_peer_add(&state, &addr, &cluster_id, i % 2 ? 100 : 1000000, NULL);
+        }
+
+        // Removes every other peer, which shifts entries in the probe sequences
+        nan_peers_clean(&state, 100 + state.timeout_usec + 1);
+        ASSERT_EQ(list_len(state.peers), count / 2);
+        ASSERT_EQ(state.table.count, (size_t)count / 2);
+
+        for (int i = 0; i < count; i++) {
+            struct ether_addr addr = make_address(i);
+            struct nan_peer *peer = NULL;
+            ASSERT_EQ(nan_peer_get(&state, &addr, &peer), i % 2 ? PEER_MISSING : PEER_OK);
+        }
+    }
+
+    TEST_F(TestPeer, testRefreshDelaysExpiry) {
+        struct ether_addr addr = make_address(1);
+        struct nan_peer *peer = NULL;
+        uint64_t start_usec = 3600000000;
+
+        nan_peer_add(&state, &addr, &cluster_id, start_usec, NULL);
+        nan_peer_add(&state, &addr, &cluster_id, start_usec + 3000000, NULL);
+
+        nan_peers_clean(&state, start_usec + state.timeout_usec + 1);
+        ASSERT_EQ(nan_peer_get(&state, &addr, &peer), PEER_OK);
+
+        nan_peers_clean(&state, start_usec + 3000000 + state.timeout_usec);
+        ASSERT_EQ(nan_peer_get(&state, &addr, &peer), PEER_OK);
+
+        nan_peers_clean(&state, start_usec + 3000000 + state.timeout_usec + 1);
+        ASSERT_EQ(nan_peer_get(&state, &addr, &peer), PEER_MISSING);
+        ASSERT_EQ(list_len(state.peers), 0);
+    }
+
+    TEST_F(TestPeer, testExpiryWithinOneCleanInterval) {
+        const int count = 100;
+        uint64_t start_usec = 3600000000;
+
+        for (int i = 0; i < count; i++) {
+            struct ether_addr addr = make_address(i);
+            nan_peer_add(&state, &addr, &cluster_id, start_usec + i * 100000, NULL);
+        }
+
+        // Clean once per interval and check that no peer outlives its timeout by more than that
+        for (uint64_t now_usec = start_usec; list_len(state.peers) > 0; now_usec += state.clean_interval_usec) {
+            nan_peers_clean(&state, now_usec);
+            for (int i = 0; i < count; i++) {
+                struct ether_addr addr = make_address(i);
+                struct nan_peer *peer = NULL;
+                uint64_t last_update = start_usec + i * 100000;
+                bool expired = last_update + state.timeout_usec < now_usec;
+                ASSERT_EQ(nan_peer_get(&state, &addr, &peer), expired ? PEER_MISSING : PEER_OK);
+            }
+        }
+    }
+
+    TEST_F(TestPeer, testPoolLimitAndReuse) {
+        nan_peer_set_max_peers(&state, 2);
+
+        struct ether_addr first = make_address(1);
+        struct ether_addr second = make_address(2);
+        struct ether_addr third = make_address(3);
+        struct nan_peer *peer = NULL;
+
+        ASSERT_EQ(nan_peer_add(&state, &first, &cluster_id, 100, &peer), PEER_ADD);
+        struct nan_peer *first_peer = peer;
+        ASSERT_EQ(nan_peer_add(&state, &second, &cluster_id, 100, NULL), PEER_ADD);
+        ASSERT_EQ(nan_peer_add(&state, &third, &cluster_id, 100, NULL), PEER_LIMIT);
+        ASSERT_EQ(state.pool.failed, 1u);
+
+        // The RSSI history is part of the record
+        nan_peer_set_beacon_information(first_peer, -50, 0);
+        nan_peer_set_beacon_information(first_peer, -60, 0);
+        ASSERT_EQ(first_peer->rssi_average, -55);
+
+        // A removed record is handed out again
+        nan_peer_remove(&state, first_peer);
+        ASSERT_EQ(nan_peer_add(&state, &third, &cluster_id, 100, &peer), PEER_ADD);
+        ASSERT_EQ(peer, first_peer);
+        ASSERT_EQ(peer->rssi_average, 0);
+
+        ASSERT_EQ(state.pool.used, 2u);
+        ASSERT_EQ(state.pool.high_water, 2u);
+        ASSERT_EQ(state.pool.capacity, 2u);
+    }
+
+}
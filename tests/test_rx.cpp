@@ -0,0 +1,264 @@
+extern "C" {
+#include "rx.h"
+#include "tx.h"
+#include "log.h"
+#include "state.h"
+#include "wire.h"
+#include "peer.h"
+#include "ieee80211.h"
+#include "attributes.h"
+#include "frame.h"
+}
+
+#include <cstdlib>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+}
+
+static bool count_allocations = false;
+static int allocations = 0;
+
+extern "C" {
+void *malloc(size_t size) {
+    if (count_allocations)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (count_allocations)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (count_allocations)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+}
+
+namespace {
+
+    const uint64_t NOW_USEC = 1000000;
+    // TSF of the receiver's interface, running ahead of the host clock
+    const uint64_t TSF_OFFSET_USEC = 5000;
+
+    uint64_t read_tsf(const void *data) {
+        return ((const struct nan_virtual_clock *)data)->now_usec + TSF_OFFSET_USEC;
+    }
+
+    class TestRx : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            log_set_quiet(1);
+
+            struct ether_addr receiver_address = {{0x50, 0x6f, 0x9a, 0x01, 0x01, 0x01}};
+            struct ether_addr sender_address = {{0x50, 0x6f, 0x9a, 0x02, 0x02, 0x02}};
+            init_nan_state(&receiver, "receiver", &receiver_address, 6, 0);
+            init_nan_state(&sender, "sender", &sender_address, 6, 0);
+
+            // Each beacon carries its own sequence number
+            for (int i = 0; i < BEACON_COUNT; i++) {
+                struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+                nan_build_beacon_frame(buf, &sender, NAN_DISCOVERY_BEACON, NOW_USEC);
+                beacon_length[i] = buf_position(buf);
+                memcpy(beacon[i], buf_data(buf), beacon_length[i]);
+                buf_free(buf);
+            }
+        }
+
+        int receive_beacon(int index) {
+            struct buf frame = buf_view(beacon[index], beacon_length[index]);
+            return nan_rx(&frame, &receiver, 0);
+        }
+
+        static const int BEACON_COUNT = 2;
+
+        struct nan_state receiver;
+        struct nan_state sender;
+        uint8_t beacon[BEACON_COUNT][BUF_MAX_LENGTH];
+        size_t beacon_length[BEACON_COUNT];
+    };
+
+    TEST_F(TestRx, testAttributeViews) {
+        const uint8_t attributes[] = {
+                0x00, 0x02, 0x00, 0x80, 0x42,
+                0x01, 0x00, 0x00,
+        };
+        struct buf frame = buf_view(attributes, sizeof(attributes));
+        struct nan_attribute_view attribute;
+
+        ASSERT_EQ(nan_attribute_next(&frame, &attribute), 5);
+        ASSERT_EQ(attribute.id, 0x00);
+        ASSERT_EQ(attribute.length, 2);
+        ASSERT_EQ(buf_rest(&attribute.data), 2);
+        ASSERT_EQ(buf_current(&attribute.data), attributes + 3);
+
+        ASSERT_EQ(nan_attribute_next(&frame, &attribute), 3);
+        ASSERT_EQ(attribute.id, 0x01);
+        ASSERT_EQ(attribute.length, 0);
+
+        ASSERT_EQ(nan_attribute_next(&frame, &attribute), 0);
+    }
+
+    TEST_F(TestRx, testAttributeViewTooShort) {
+        const uint8_t attributes[] = {0x00, 0x04, 0x00, 0x80};
+        struct buf frame = buf_view(attributes, sizeof(attributes));
+        struct nan_attribute_view attribute;
+
+        ASSERT_EQ(nan_attribute_next(&frame, &attribute), RX_TOO_SHORT);
+    }
+
+    TEST_F(TestRx, testBeaconWithoutAllocations) {
+        // The first beacon adds the sender as new peer, which is allowed to allocate
+        ASSERT_EQ(receive_beacon(0), RX_OK);
+        ASSERT_EQ(list_len(receiver.peers.peers), 1);
+
+        allocations = 0;
+        count_allocations = true;
+        int result = receive_beacon(1);
+        count_allocations = false;
+
+        ASSERT_EQ(result, RX_OK);
+        ASSERT_EQ(allocations, 0);
+    }
+
+    TEST_F(TestRx, testServiceDiscoveryWithoutAllocations) {
+        const char service_names[][16] = {"service_a", "service_b", "service_c", "service_d"};
+        const char info[] = "service specific info";
+
+        for (const char *service_name : service_names)
+            nan_publish(&sender.services, service_name, PUBLISH_UNSOLICITED, -1, info, sizeof(info));
+        nan_subscribe(&receiver.services, "service_b", SUBSCRIBE_PASSIVE, -1, NULL, 0);
+
+        list_t announced_services = list_init();
+        nan_get_services_to_announce(&sender.services, announced_services);
+
+        // Identical frames would be dropped as duplicates, so every frame gets its own sequence number
+        const int frame_count = 17;
+        struct buf *bufs[frame_count];
+        for (int i = 0; i < frame_count; i++) {
+            bufs[i] = buf_new_owned(BUF_MAX_LENGTH);
+            nan_build_service_discovery_frame(bufs[i], &sender, &receiver.self_address, announced_services);
+        }
+
+        // The first frame adds the sender as peer and grows the parse arena
+        struct buf frame = buf_view(buf_data(bufs[0]), buf_position(bufs[0]));
+        ASSERT_GE(nan_rx(&frame, &receiver, 0), RX_OK);
+
+        allocations = 0;
+        count_allocations = true;
+        for (int i = 1; i < frame_count; i++) {
+            frame = buf_view(buf_data(bufs[i]), buf_position(bufs[i]));
+            ASSERT_GE(nan_rx(&frame, &receiver, 0), RX_OK);
+        }
+        count_allocations = false;
+
+        ASSERT_EQ(allocations, 0);
+        ASSERT_GT(receiver.rx_arena.high_water, 4 * sizeof(struct nan_service_descriptor_attribute));
+        ASSERT_EQ(receiver.rx_duplicates, 0);
+
+        for (struct buf *buf : bufs)
+            buf_free(buf);
+        list_free(announced_services, false);
+    }
+
+    TEST_F(TestRx, testActionFrameWithMalformedAttributesAccepted) {
+        struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+        ieee80211_add_radiotap_header(buf, &sender.ieee80211);
+        ieee80211_add_nan_header(buf, &sender.interface_address, &receiver.interface_address,
+                                 &sender.cluster.cluster_id, &sender.ieee80211,
+                                 IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_ACTION);
+
+        struct nan_action_frame *action_frame = (struct nan_action_frame *)buf_current(buf);
+        action_frame->category = IEEE80211_PUBLIC_ACTION_FRAME;
+        action_frame->action = IEEE80211_PUBLIC_ACTION_FRAME_VENDOR_SPECIFIC;
+        action_frame->oui = NAN_OUI;
+        action_frame->oui_type = NAN_OUI_TYPE_ACTION;
+        action_frame->oui_subtype = 0;
+        buf_advance(buf, sizeof(struct nan_action_frame));
+
+        // An attribute claiming more data than the frame carries leaves trailing bytes
+        write_u8(buf, DEVICE_CAPABILITY_ATTRIBUTE);
+        write_le16(buf, 16);
+        write_u8(buf, 0);
+        ieee80211_add_fcs(buf);
+
+        struct buf frame = buf_view(buf_data(buf), buf_position(buf));
+        ASSERT_EQ(nan_rx(&frame, &receiver, 0), RX_OK);
+        ASSERT_EQ(list_len(receiver.peers.peers), 1);
+
+        buf_free(buf);
+    }
+
+    TEST_F(TestRx, testTsfFallbackAtCaptureTime) {
+        struct nan_virtual_clock virtual_clock;
+        nan_virtual_clock_init(&virtual_clock, NOW_USEC);
+        nan_clock_init_virtual(&receiver.clock, &virtual_clock);
+        nan_clock_set_tsf(&receiver.clock, read_tsf, &virtual_clock);
+
+        // Processed long after capture, the TSF read now must not be paired with the capture time
+        struct buf frame = buf_view(beacon[0], beacon_length[0]);
+        ASSERT_EQ(nan_rx(&frame, &receiver, NOW_USEC - 1000), RX_OK);
+        ASSERT_EQ(receiver.timestamp.sample.time_usec[TIMESTAMP_SOURCE_TSFT], NOW_USEC - 1000);
+
+        nan_virtual_clock_advance(&virtual_clock, 100);
+        frame = buf_view(beacon[1], beacon_length[1]);
+        ASSERT_EQ(nan_rx(&frame, &receiver, NOW_USEC + 100), RX_OK);
+        ASSERT_EQ(receiver.timestamp.sample.time_usec[TIMESTAMP_SOURCE_TSFT], NOW_USEC + 100);
+    }
+
+    TEST_F(TestRx, testPeerLimitCounted) {
+        struct ether_addr other_address = {{0x50, 0x6f, 0x9a, 0x03, 0x03, 0x03}};
+        struct nan_peer *peer = NULL;
+        nan_peer_set_max_peers(&receiver.peers, 1);
+        ASSERT_EQ(nan_peer_add(&receiver.peers, &other_address, &sender.cluster.cluster_id, NOW_USEC, &peer), PEER_ADD);
+
+        ASSERT_EQ(receive_beacon(0), RX_IGNORE);
+        ASSERT_EQ(receive_beacon(1), RX_IGNORE);
+        ASSERT_EQ(receiver.rx_peer_limit, 2u);
+        ASSERT_EQ(list_len(receiver.peers.peers), 1u);
+    }
+
+    TEST_F(TestRx, testDuplicateFrameIgnored) {
+        ASSERT_EQ(receive_beacon(0), RX_OK);
+        ASSERT_EQ(receive_beacon(0), RX_IGNORE_DUPLICATE);
+        ASSERT_EQ(receiver.rx_duplicates, 1);
+
+        // A retransmission only differs in the retry bit
+        uint16_t radiotap_length = beacon[0][2] | beacon[0][3] << 8;
+        struct ieee80211_hdr *header = (struct ieee80211_hdr *)(beacon[0] + radiotap_length);
+        header->frame_control |= htole16(IEEE80211_FCTL_RETRY);
+        ASSERT_EQ(receive_beacon(0), RX_IGNORE_DUPLICATE);
+        ASSERT_EQ(receiver.rx_duplicates, 2);
+
+        ASSERT_EQ(receive_beacon(1), RX_OK);
+        ASSERT_EQ(receiver.rx_duplicates, 2);
+    }
+
+    TEST_F(TestRx, testDuplicateWindowExpires) {
+        struct nan_peer peer = {};
+        nan_peer_add_recent_frame(&peer, 0x10, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON, 100, NOW_USEC);
+
+        ASSERT_TRUE(nan_peer_is_duplicate_frame(&peer, 0x10, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON,
+                                                100, NOW_USEC + PEER_DUPLICATE_WINDOW_USEC));
+        ASSERT_FALSE(nan_peer_is_duplicate_frame(&peer, 0x10, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON,
+                                                 100, NOW_USEC + PEER_DUPLICATE_WINDOW_USEC + 1));
+        ASSERT_FALSE(nan_peer_is_duplicate_frame(&peer, 0x10, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON,
+                                                 101, NOW_USEC));
+        ASSERT_FALSE(nan_peer_is_duplicate_frame(&peer, 0x20, IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_BEACON,
+                                                 100, NOW_USEC));
+    }
+}
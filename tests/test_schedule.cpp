@@ -0,0 +1,144 @@
+extern "C" {
+#include "schedule.h"
+#include "wire.h"
+#include "log.h"
+}
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    const uint64_t NOW_USEC = 1000000;
+    const uint64_t WINDOW_USEC = TU_TO_USEC(NAN_DW_LENGTH_TU);
+
+    class TestSchedule : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            log_set_quiet(1);
+            nan_tx_schedule_init(&schedule);
+        }
+
+        void TearDown() override {
+            nan_tx_schedule_free(&schedule);
+        }
+
+        struct buf *enqueue(enum nan_tx_priority priority, uint64_t airtime_usec, uint64_t deadline_usec) {
+            struct buf *buf = buf_new_owned(64);
+            if (nan_tx_schedule_enqueue(&schedule, priority, buf, airtime_usec, deadline_usec) < 0) {
+                buf_free(buf);
+                return nullptr;
+            }
+            return buf;
+        }
+
+        struct nan_tx_schedule schedule;
+    };
+
+    TEST_F(TestSchedule, testDeferToNextWindow) {
+        struct buf *first = enqueue(NAN_TX_FOLLOW_UP, 6000, NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+        struct buf *second = enqueue(NAN_TX_FOLLOW_UP, 6000, NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+        struct buf *third = enqueue(NAN_TX_FOLLOW_UP, 6000, NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+        ASSERT_EQ(nan_tx_schedule_length(&schedule, NAN_TX_FOLLOW_UP), 3);
+
+        nan_tx_window_open(&schedule, NOW_USEC, NOW_USEC + WINDOW_USEC);
+        ASSERT_TRUE(nan_tx_window_reserve(&schedule, 1000));
+
+        struct buf *buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC);
+        ASSERT_EQ(buf, first);
+        buf_free(buf);
+        buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC);
+        ASSERT_EQ(buf, second);
+        buf_free(buf);
+
+        // 13000 of 16384 us are used, neither the third frame nor a large reservation fit anymore
+        ASSERT_EQ(nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC), nullptr);
+        ASSERT_FALSE(nan_tx_window_reserve(&schedule, 4000));
+        ASSERT_TRUE(nan_tx_window_reserve(&schedule, 3000));
+        ASSERT_EQ(schedule.deferred, 2);
+
+        uint64_t next_window_usec = NOW_USEC + TU_TO_USEC(NAN_DW_INTERVAL_TU);
+        nan_tx_window_open(&schedule, next_window_usec, next_window_usec + WINDOW_USEC);
+        buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, next_window_usec);
+        ASSERT_EQ(buf, third);
+        buf_free(buf);
+
+        ASSERT_EQ(nan_tx_schedule_length(&schedule, NAN_TX_FOLLOW_UP), 0);
+        ASSERT_EQ(schedule.sent, 5);
+    }
+
+    TEST_F(TestSchedule, testPrioritiesAreSeparate) {
+        struct buf *discovery_beacon = enqueue(NAN_TX_DISCOVERY_BEACON, 1000, NOW_USEC + WINDOW_USEC);
+        struct buf *follow_up = enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + WINDOW_USEC);
+        ASSERT_NE(discovery_beacon, nullptr);
+
+        nan_tx_window_open(&schedule, NOW_USEC, NOW_USEC + WINDOW_USEC);
+        ASSERT_EQ(nan_tx_schedule_next(&schedule, NAN_TX_SERVICE_DISCOVERY, NOW_USEC), nullptr);
+
+        struct buf *buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC);
+        ASSERT_EQ(buf, follow_up);
+        buf_free(buf);
+        ASSERT_EQ(nan_tx_schedule_length(&schedule, NAN_TX_DISCOVERY_BEACON), 1);
+    }
+
+    TEST_F(TestSchedule, testExpiredFramesAreDropped) {
+        ASSERT_NE(enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + 100), nullptr);
+        struct buf *fresh = enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+
+        nan_tx_window_open(&schedule, NOW_USEC + 100, NOW_USEC + 100 + WINDOW_USEC);
+        struct buf *buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC + 100);
+        ASSERT_EQ(buf, fresh);
+        buf_free(buf);
+
+        ASSERT_EQ(schedule.expired, 1);
+        ASSERT_EQ(schedule.frames.used, 0);
+    }
+
+    TEST_F(TestSchedule, testRefusedFrames) {
+        for (int i = 0; i < NAN_TX_SCHEDULE_MAX_FRAMES; i++)
+            ASSERT_NE(enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + WINDOW_USEC), nullptr);
+        ASSERT_EQ(enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + WINDOW_USEC), nullptr);
+
+        ASSERT_EQ(schedule.dropped, 1);
+    }
+
+    TEST_F(TestSchedule, testOversizeFrameTakesRestOfWindow) {
+        struct buf *oversize = enqueue(NAN_TX_FOLLOW_UP, NAN_TX_MAX_AIRTIME_USEC + 1,
+                                       NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+        ASSERT_NE(oversize, nullptr);
+        struct buf *small = enqueue(NAN_TX_FOLLOW_UP, 1000, NOW_USEC + NAN_TX_FOLLOW_UP_LIFETIME_USEC);
+
+        // An empty window, e.g. to hold back discovery beacons within a DW, does not let it through
+        nan_tx_window_open(&schedule, NOW_USEC, NOW_USEC);
+        ASSERT_EQ(nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC), nullptr);
+
+        nan_tx_window_open(&schedule, NOW_USEC, NOW_USEC + WINDOW_USEC);
+        ASSERT_TRUE(nan_tx_window_reserve(&schedule, 1000));
+        struct buf *buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC);
+        ASSERT_EQ(buf, oversize);
+        buf_free(buf);
+
+        // Nothing fits after it, neither a queued frame nor another oversize one
+        ASSERT_EQ(nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, NOW_USEC), nullptr);
+        ASSERT_FALSE(nan_tx_window_reserve(&schedule, NAN_TX_MAX_AIRTIME_USEC + 1));
+        ASSERT_EQ(schedule.oversize, 1);
+
+        uint64_t next_window_usec = NOW_USEC + TU_TO_USEC(NAN_DW_INTERVAL_TU);
+        nan_tx_window_open(&schedule, next_window_usec, next_window_usec + WINDOW_USEC);
+        buf = nan_tx_schedule_next(&schedule, NAN_TX_FOLLOW_UP, next_window_usec);
+        ASSERT_EQ(buf, small);
+        buf_free(buf);
+        ASSERT_TRUE(nan_tx_window_reserve(&schedule, NAN_TX_MAX_AIRTIME_USEC + 1));
+        ASSERT_EQ(schedule.oversize, 2);
+        ASSERT_EQ(schedule.dropped, 0);
+    }
+
+    TEST_F(TestSchedule, testAirtime) {
+        // Radiotap header of 11 bytes followed by 89 bytes including the FCS, sent at 1 Mbps
+        uint8_t frame[100] = {0, 0, 11, 0};
+        uint64_t airtime_usec = nan_tx_airtime_usec(frame, sizeof(frame), true);
+        ASSERT_EQ(nan_tx_airtime_usec(frame, sizeof(frame) - 4, false), airtime_usec);
+        ASSERT_EQ(nan_tx_airtime_usec(frame, sizeof(frame) + 1, true), airtime_usec + 8);
+        ASSERT_GT(airtime_usec, 89 * 8);
+        ASSERT_LT(airtime_usec, 2000);
+    }
+}
@@ -0,0 +1,63 @@
+extern "C" {
+#include "timestamp.h"
+}
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    TEST(TestTimestamp, testFallback) {
+        struct nan_timestamp_state state;
+        nan_timestamp_state_init(&state, TIMESTAMP_SOURCE_TSFT);
+
+        ASSERT_EQ(nan_timestamp_frame(&state, 1000, 0, 0), 1000u);
+        ASSERT_EQ(nan_timestamp_frame(&state, 2000, 1900, 0), 1900u);
+
+        // A kernel timestamp from the future is not usable
+        ASSERT_EQ(nan_timestamp_frame(&state, 3000, 3100, 0), 3000u);
+    }
+
+    TEST(TestTimestamp, testTsftMinimalOffset) {
+        struct nan_timestamp_state state;
+        nan_timestamp_state_init(&state, TIMESTAMP_SOURCE_TSFT);
+
+        const uint64_t offset = 5000000;
+        const uint64_t delays[] = {300, 40, 120, 900, 60};
+
+        // The frame with the least queueing delay determines the offset
+        for (uint64_t i = 0; i < 5; i++) {
+            uint64_t tsft = 100000 + i * 10000;
+            nan_timestamp_frame(&state, tsft + offset + delays[i], 0, tsft);
+        }
+
+        uint64_t tsft = 200000;
+        ASSERT_EQ(nan_timestamp_frame(&state, tsft + offset + 500, 0, tsft), tsft + offset + 40);
+        ASSERT_EQ(state.delay[TIMESTAMP_SOURCE_TSFT].count, 6u);
+    }
+
+    TEST(TestTimestamp, testTsftReset) {
+        struct nan_timestamp_state state;
+        nan_timestamp_state_init(&state, TIMESTAMP_SOURCE_TSFT);
+
+        nan_timestamp_frame(&state, 10000000, 0, 9000000);
+        ASSERT_EQ(nan_timestamp_frame(&state, 10001000, 0, 10), 10001000u);
+    }
+
+    TEST(TestTimestamp, testJitter) {
+        struct nan_timestamp_state state;
+        struct nan_timestamp_peer peer = {};
+        nan_timestamp_state_init(&state, TIMESTAMP_SOURCE_KERNEL);
+
+        const uint64_t queueing[] = {100, 500, 200, 800};
+        for (uint64_t i = 0; i < 4; i++) {
+            uint64_t arrival = 1000000 + i * 100000;
+            nan_timestamp_frame(&state, arrival + queueing[i], arrival, 0);
+            nan_timestamp_beacon(&state, &peer, arrival - 20000);
+        }
+
+        ASSERT_EQ(state.jitter[TIMESTAMP_SOURCE_KERNEL].count, 3u);
+        ASSERT_DOUBLE_EQ(nan_timestamp_stats_stddev(&state.jitter[TIMESTAMP_SOURCE_KERNEL]), 0);
+        ASSERT_GT(nan_timestamp_stats_stddev(&state.jitter[TIMESTAMP_SOURCE_CLOCK]), 0);
+        ASSERT_DOUBLE_EQ(nan_timestamp_stats_mean(&state.delay[TIMESTAMP_SOURCE_KERNEL]), 400);
+    }
+}
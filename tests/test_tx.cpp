@@ -0,0 +1,178 @@
+extern "C" {
+#include "tx.h"
+#include "service.h"
+#include "log.h"
+#include "state.h"
+#include "buf_pool.h"
+#include "schedule.h"
+#include "crc32.h"
+}
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+    const uint64_t NOW_USEC = 1000000;
+
+    class TestTx : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            log_set_quiet(1);
+
+            struct ether_addr address = {{0x50, 0x6f, 0x9a, 0x01, 0x01, 0x01}};
+            init_nan_state(&patched, "patched", &address, 6, 0);
+            init_nan_state(&built, "built", &address, 6, 0);
+            built.cluster.cluster_id = patched.cluster.cluster_id;
+        }
+
+        // Compare a beacon patched from the template with one built from scratch
+        void expect_same_beacon(enum nan_beacon_type type, uint64_t now_usec) {
+            size_t length;
+            const uint8_t *frame = nan_get_beacon_frame(&patched, type, now_usec, &length);
+            ASSERT_NE(frame, nullptr);
+
+            struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+            nan_build_beacon_frame(buf, &built, type, now_usec);
+            ASSERT_EQ(length, buf_position(buf));
+            EXPECT_EQ(memcmp(frame, buf_data(buf), length), 0);
+            buf_free(buf);
+        }
+
+        struct nan_state patched;
+        struct nan_state built;
+    };
+
+    TEST_F(TestTx, testBeaconTemplate) {
+        for (int i = 0; i < 3; i++) {
+            expect_same_beacon(NAN_SYNC_BEACON, NOW_USEC + i * 512 * 1024);
+            expect_same_beacon(NAN_DISCOVERY_BEACON, NOW_USEC + i * 100 * 1024 + 7);
+        }
+        ASSERT_EQ(patched.beacon_templates.rebuilds, 2);
+        ASSERT_EQ(patched.ieee80211.sequence_number, built.ieee80211.sequence_number);
+    }
+
+    TEST_F(TestTx, testBeaconTemplateRebuild) {
+        expect_same_beacon(NAN_SYNC_BEACON, NOW_USEC);
+        ASSERT_EQ(patched.beacon_templates.rebuilds, 1);
+
+        patched.sync.hop_count = built.sync.hop_count = 2;
+        patched.sync.ambtt = built.sync.ambtt = 0x12345678;
+        expect_same_beacon(NAN_SYNC_BEACON, NOW_USEC + 1);
+        ASSERT_EQ(patched.beacon_templates.rebuilds, 2);
+
+        patched.ieee80211.fcs = built.ieee80211.fcs = false;
+        expect_same_beacon(NAN_SYNC_BEACON, NOW_USEC + 2);
+        ASSERT_EQ(patched.beacon_templates.rebuilds, 3);
+
+        expect_same_beacon(NAN_SYNC_BEACON, NOW_USEC + 3);
+        ASSERT_EQ(patched.beacon_templates.rebuilds, 3);
+    }
+
+    TEST_F(TestTx, testFollowUpBuffersAreRecycled) {
+        uint8_t instance_id = nan_publish(&patched.services, "service", PUBLISH_UNSOLICITED, -1, NULL, 0);
+        struct ether_addr destination = {{0x50, 0x6f, 0x9a, 0x02, 0x02, 0x02}};
+        const char info[] = "follow up";
+
+        struct buf *sent[2] = {nullptr, nullptr};
+        for (int round = 0; round < 2; round++) {
+            ASSERT_EQ(nan_transmit(&patched, &destination, instance_id, 1, info, sizeof(info)), 0);
+            ASSERT_EQ(buf_pool_in_use(&patched.tx_pool), 1);
+
+            uint64_t now_usec = nan_clock_now_usec(&patched.clock);
+            nan_tx_window_open(&patched.tx_schedule, now_usec, now_usec + TU_TO_USEC(NAN_DW_LENGTH_TU));
+            struct buf *buf = nan_tx_schedule_next(&patched.tx_schedule, NAN_TX_FOLLOW_UP, now_usec);
+            ASSERT_NE(buf, nullptr);
+            ASSERT_LE(buf_position(buf), buf_size(buf));
+            sent[round] = buf;
+            buf_free(buf);
+            ASSERT_EQ(buf_pool_in_use(&patched.tx_pool), 0);
+        }
+        ASSERT_EQ(sent[0], sent[1]);
+    }
+
+    TEST_F(TestTx, testFollowUpsToSamePeerAreCoalesced) {
+        uint8_t instance_id = nan_publish(&patched.services, "service", PUBLISH_UNSOLICITED, -1, NULL, 0);
+        struct ether_addr peer_a = {{0x50, 0x6f, 0x9a, 0x02, 0x02, 0x02}};
+        struct ether_addr peer_b = {{0x50, 0x6f, 0x9a, 0x03, 0x03, 0x03}};
+        const char info[] = "follow up";
+        char large_info[300] = {0};
+
+        ASSERT_EQ(nan_transmit(&patched, &peer_a, instance_id, 1, info, sizeof(info)), 0);
+        ASSERT_EQ(nan_transmit(&patched, &peer_b, instance_id, 2, info, sizeof(info)), 0);
+        ASSERT_EQ(nan_transmit(&patched, &peer_a, instance_id, 3, info, sizeof(info)), 0);
+        ASSERT_EQ(nan_transmit(&patched, &peer_a, instance_id, 4, info, sizeof(info)), 0);
+        // Carries an extension attribute and starts a frame of its own, which later ones are not appended to
+        ASSERT_EQ(nan_transmit(&patched, &peer_b, instance_id, 5, large_info, sizeof(large_info)), 0);
+        ASSERT_EQ(nan_transmit(&patched, &peer_b, instance_id, 6, info, sizeof(info)), 0);
+
+        ASSERT_EQ(nan_tx_schedule_length(&patched.tx_schedule, NAN_TX_FOLLOW_UP), 4);
+        ASSERT_EQ(patched.tx_schedule.coalesced, 2);
+
+        uint64_t now_usec = nan_clock_now_usec(&patched.clock);
+        nan_tx_window_open(&patched.tx_schedule, now_usec, now_usec + TU_TO_USEC(NAN_DW_LENGTH_TU));
+        const size_t expected_descriptors[] = {3, 1, 1, 1};
+        for (size_t expected : expected_descriptors) {
+            struct buf *buf = nan_tx_schedule_next(&patched.tx_schedule, NAN_TX_FOLLOW_UP, now_usec);
+            ASSERT_NE(buf, nullptr);
+
+            const uint8_t *data = buf_data(buf);
+            size_t length = buf_position(buf) - FCS_LEN;
+            uint32_t fcs;
+            memcpy(&fcs, data + length, sizeof(fcs));
+            EXPECT_EQ(crc32(data, length), le32toh(fcs));
+
+            size_t descriptors = 0;
+            size_t offset = data[2] + sizeof(struct ieee80211_hdr) + sizeof(struct nan_service_discovery_frame);
+            while (offset < length) {
+                const struct nan_attribute_header *attribute = (const struct nan_attribute_header *)(data + offset);
+                if (attribute->id == SERVICE_DESCRIPTOR_ATTRIBUTE)
+                    descriptors++;
+                offset += sizeof(struct nan_attribute_header) + le16toh(attribute->length);
+            }
+            EXPECT_EQ(offset, length);
+            EXPECT_EQ(descriptors, expected);
+            buf_free(buf);
+        }
+        ASSERT_EQ(buf_pool_in_use(&patched.tx_pool), 0);
+    }
+
+    TEST_F(TestTx, testServiceDiscoveryFrameCache) {
+        const char info[] = "service specific info";
+        struct ether_addr destination = {{0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00}};
+        list_t announced_services;
+        size_t length;
+        ASSERT_EQ(nan_get_service_discovery_frame(&patched, &destination, &announced_services, &length), nullptr);
+        ASSERT_EQ(list_len(announced_services), 0);
+
+        nan_publish(&patched.services, "service_a", PUBLISH_UNSOLICITED, -1, info, sizeof(info));
+        uint8_t limited = nan_publish(&patched.services, "service_b", PUBLISH_UNSOLICITED, 2, NULL, 0);
+        uint64_t rebuilds = patched.sdf_cache.rebuilds;
+
+        for (int round = 0; round < 3; round++) {
+            uint16_t sequence_number = patched.ieee80211.sequence_number;
+            const uint8_t *frame = nan_get_service_discovery_frame(&patched, &destination,
+                                                                   &announced_services, &length);
+            ASSERT_NE(frame, nullptr);
+
+            // Rewind the sequence number so that the freshly built frame matches
+            patched.ieee80211.sequence_number = sequence_number;
+            struct buf *buf = buf_new_owned(BUF_MAX_LENGTH);
+            nan_build_service_discovery_frame(buf, &patched, &destination, announced_services);
+            ASSERT_EQ(length, buf_position(buf));
+            EXPECT_EQ(memcmp(frame, buf_data(buf), length), 0);
+            buf_free(buf);
+
+            // The second service is only announced twice
+            ASSERT_EQ(list_len(announced_services), round < 2 ? 2 : 1);
+            nan_update_announced_services(&patched.services, announced_services);
+        }
+        // Rebuilt once for the new services and once after the second service expired
+        ASSERT_EQ(patched.sdf_cache.rebuilds, rebuilds + 2);
+
+        nan_cancel_publish(&patched.services, limited);
+        nan_get_service_discovery_frame(&patched, &destination, &announced_services, &length);
+        ASSERT_EQ(patched.sdf_cache.rebuilds, rebuilds + 3);
+    }
+}